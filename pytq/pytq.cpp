@@ -12,7 +12,12 @@ tq::Value python_to_value(py::object obj) {
     } else if (py::isinstance<py::bool_>(obj)) {
         return tq::Value(obj.cast<bool>());
     } else if (py::isinstance<py::int_>(obj)) {
-        return tq::Value(obj.cast<int>());
+        try {
+            return tq::Value(obj.cast<int64_t>());
+        } catch (const py::cast_error&) {
+            // Beyond int64: keep the magnitude as a double
+            return tq::Value(obj.cast<double>());
+        }
     } else if (py::isinstance<py::float_>(obj)) {
         return tq::Value(obj.cast<double>());
     } else if (py::isinstance<py::str>(obj)) {
@@ -43,6 +48,8 @@ py::object value_to_python(const tq::Value& val) {
         return py::none();
     } else if (val.is_boolean()) {
         return py::bool_(val.as_boolean());
+    } else if (val.is_integer()) {
+        return py::int_(val.as_integer());
     } else if (val.is_number()) {
         double num = val.as_number();
         // Return int if it's a whole number
@@ -61,7 +68,7 @@ py::object value_to_python(const tq::Value& val) {
     } else if (val.is_object()) {
         py::dict dct;
         for (const auto& [key, value] : val.as_object()) {
-            dct[py::str(key)] = value_to_python(value);
+            dct[py::str(key.str())] = value_to_python(value);
         }
         return dct;
     }
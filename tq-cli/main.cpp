@@ -8,22 +8,26 @@
 
 void print_usage(const char* prog_name) {
     std::cerr << "Usage: " << prog_name << " [OPTIONS] <expression> [file]\n"
+              << "       " << prog_name << " --compile-data <in.toon> <out.tqb>\n"
               << "\n"
               << "Query TOON data with jq-style expressions\n"
               << "\n"
               << "Arguments:\n"
               << "  <expression>    TQ query expression (e.g., '.users[].email')\n"
-              << "  [file]          Input file (TOON format). Use '-' or omit for stdin\n"
+              << "  [file]          Input file (TOON format). Use '-' or omit for stdin.\n"
+              << "                  A .tqb snapshot is mapped and queried without parsing\n"
               << "\n"
               << "Options:\n"
               << "  -b, --benchmark Benchmark mode: show execution time\n"
+              << "  --compile-data  Parse a TOON file once into a .tqb snapshot\n"
               << "  -h, --help      Show this help message\n"
               << "\n"
               << "Examples:\n"
               << "  tq '.name' data.toon\n"
               << "  tq '.users[].email' data.toon\n"
               << "  cat data.toon | tq '.items[].price'\n"
-              << "  tq '.data' input.toon\n";
+              << "  tq '.data' input.toon\n"
+              << "  tq --compile-data export.toon export.tqb && tq '.rows[0]' export.tqb\n";
 }
 
 std::string read_file(const std::string& filename) {
@@ -37,10 +41,8 @@ std::string read_file(const std::string& filename) {
     return oss.str();
 }
 
-std::string read_stdin() {
-    std::ostringstream oss;
-    oss << std::cin.rdbuf();
-    return oss.str();
+bool is_snapshot(const std::string& filename) {
+    return filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".tqb") == 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -62,6 +64,13 @@ int main(int argc, char* argv[]) {
             if (arg == "-h" || arg == "--help") {
                 print_usage(argv[0]);
                 return 0;
+            } else if (arg == "--compile-data") {
+                if (arg_idx + 2 >= argc) {
+                    std::cerr << "Error: --compile-data needs an input and an output file\n";
+                    return 1;
+                }
+                tq::ToonParser::parse_tape(read_file(argv[arg_idx + 1])).save(argv[arg_idx + 2]);
+                return 0;
             } else if (arg == "-b" || arg == "--benchmark") {
                 benchmark = true;
                 ++arg_idx;
@@ -84,23 +93,54 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
-        // Read input data (TOON format)
-        std::string data;
-        if (input_file.empty() || input_file == "-") {
-            data = read_stdin();
-        } else {
-            data = read_file(input_file);
-        }
-        
-        if (data.empty()) {
-            std::cerr << "Error: Empty input\n";
-            return 1;
-        }
-        
         // Execute query
         auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::string> results;
+        size_t result_count = 0;
         
-        std::vector<std::string> results = tq::query(expression, data);
+        if (is_snapshot(input_file)) {
+            // Snapshots are mapped and queried in place
+            tq::Tape tape = tq::Tape::load(input_file);
+            results = tq::query(expression, tape);
+        } else {
+            std::ifstream file;
+            bool from_stdin = input_file.empty() || input_file == "-";
+            if (!from_stdin) {
+                file.open(input_file);
+                if (!file.is_open()) {
+                    throw std::runtime_error("Failed to open file: " + input_file);
+                }
+            }
+            std::istream& in = from_stdin ? std::cin : file;
+            if (in.peek() == std::char_traits<char>::eof()) {
+                std::cerr << "Error: Empty input\n";
+                return 1;
+            }
+            
+            // `.path[] | ...` runs one array element at a time, printing
+            // results as they are produced
+            bool streamed = tq::query_stream(expression, in, [&](const tq::Value& result) {
+                std::cout << result.to_toon() << "\n";
+                ++result_count;
+            });
+            
+            if (!streamed) {
+                std::ostringstream oss;
+                oss << in.rdbuf();
+                std::string data = oss.str();
+                
+                start = std::chrono::high_resolution_clock::now();
+                
+                // One document per run: allocate it from an arena and drop it
+                // in one go. Only the parts the query reaches are decoded,
+                // and of those only the fields it can read. The run has the
+                // machine to itself, so large arrays use every core.
+                tq::Arena arena;
+                auto projection = tq::Projection::of(tq::Document::compile(expression));
+                tq::LazyDocument document(std::move(data), &arena, 0, projection);
+                results = tq::query(expression, document);
+            }
+        }
         
         auto end = std::chrono::high_resolution_clock::now();
         
@@ -108,12 +148,13 @@ int main(int argc, char* argv[]) {
         for (const auto& result : results) {
             std::cout << result << "\n";
         }
+        result_count += results.size();
         
         // Benchmark output
         if (benchmark) {
             auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
             std::cerr << "\nExecution time: " << duration.count() / 1000.0 << " ms\n";
-            std::cerr << "Results: " << results.size() << "\n";
+            std::cerr << "Results: " << result_count << "\n";
         }
         
         return 0;
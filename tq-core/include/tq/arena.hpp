@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace tq {
+
+// Monotonic allocation region for parsed documents. Nodes and object
+// storage built with an arena are carved out of large blocks and never
+// freed one by one; everything is returned at once when the arena is
+// destroyed. Every Value that refers to arena memory, including copies and
+// query results taken from it, must be gone before the arena is.
+class Arena : public std::pmr::memory_resource {
+public:
+    explicit Arena(size_t initial_size = 64 * 1024);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Bytes handed out so far, forks included
+    size_t bytes_used() const;
+
+    // A further arena for another thread to allocate from while this one
+    // is in use; its memory lives and dies with this arena. Forking itself
+    // is not thread-safe: fork on the owning thread, then hand it out.
+    Arena* fork();
+
+private:
+    std::pmr::monotonic_buffer_resource resource_;
+    size_t bytes_used_ = 0;
+    std::vector<std::unique_ptr<Arena>> forks_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+} // namespace tq
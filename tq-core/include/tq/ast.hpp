@@ -28,6 +28,7 @@ enum class ExprType {
     Field,              // .foo
     OptionalField,      // .foo?
     Index,              // .[0]
+    DynamicIndex,       // .[$k]: left indexed by operand, both run on the input
     Slice,              // .[1:5]
     Iterator,           // .[]
     RecursiveDescent,   // ..
@@ -67,16 +68,20 @@ struct Expr {
     // Literal values
     bool bool_val = false;
     double num_val = 0.0;
+    int64_t int_val = 0;      // exact value when the literal is an integer
+    bool is_integer = false;
     std::string str_val;
     std::vector<ExprPtr> array_elements;
-    std::vector<std::pair<std::string, ExprPtr>> object_fields;
+    std::vector<std::pair<Key, ExprPtr>> object_fields;  // keys interned at parse time
     
     // Path operations
     std::string field_name;
+    Key field_key;  // field_name resolved to an atom once, when the query is compiled
+    FieldCache field_cache;  // slot of field_key in the last object shape seen here
     bool optional = false;
-    int index_val = 0;
-    int slice_start = 0;
-    int slice_end = 0;
+    int64_t index_val = 0;
+    int64_t slice_start = 0;
+    int64_t slice_end = 0;
     bool has_slice_end = false;
     
     // Binary/Unary operations
@@ -123,6 +128,13 @@ struct Expr {
         e->num_val = val;
         return e;
     }
+    static ExprPtr integer_expr(int64_t val) {
+        auto e = std::make_shared<Expr>(ExprType::Number);
+        e->num_val = static_cast<double>(val);
+        e->int_val = val;
+        e->is_integer = true;
+        return e;
+    }
     static ExprPtr string_expr(std::string val) {
         auto e = std::make_shared<Expr>(ExprType::String);
         e->str_val = std::move(val);
@@ -133,6 +145,7 @@ struct Expr {
     }
     static ExprPtr field_expr(std::string name, bool opt = false) {
         auto e = std::make_shared<Expr>(opt ? ExprType::OptionalField : ExprType::Field);
+        e->field_key = Key(name);
         e->field_name = std::move(name);
         return e;
     }
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace tq {
+
+// Interned string id. Every distinct key name is stored once in a
+// process-wide table and identified by a 32-bit atom from then on. The
+// table never shrinks, so it is capped: past the cap, names are no longer
+// interned and keys carry their own text instead (see Key).
+using Atom = uint32_t;
+
+class AtomTable {
+public:
+    static constexpr Atom kNoAtom = UINT32_MAX;
+    static constexpr size_t kMaxCapacity = size_t{1} << 24;  // 16M distinct names
+
+    // Returns the atom for name, adding it to the table if needed, or
+    // kNoAtom if name is new and the table is full
+    static Atom intern(std::string_view name);
+
+    // Returns the atom for name, or kNoAtom if it was never interned
+    static Atom lookup(std::string_view name);
+
+    // Name of an interned atom; the reference stays valid for the process lifetime
+    static const std::string& name(Atom atom);
+
+    // Number of atoms interned so far
+    static size_t size();
+
+    // Lowers the cap to names distinct names (never below those already
+    // interned), bounding the memory a long-running process spends on keys.
+    // The cap can only go down, so a name left out is never interned later.
+    static void set_capacity(size_t names);
+
+    // Whether some name has been left out of the table
+    static bool overflowed();
+};
+
+// Object key: an atom with string-like convenience accessors. Keys compare
+// as integers; the name is only touched for output. A name the table has
+// no room for is kept by the key itself, shared between its copies, and
+// compared by text; objects holding such keys use dictionary mode.
+class Key {
+public:
+    Key() = default;
+    explicit Key(Atom atom) : atom_(atom) {}
+    explicit Key(std::string_view name) : atom_(AtomTable::intern(name)) {
+        if (atom_ == AtomTable::kNoAtom) {
+            name_ = std::make_shared<const std::string>(name);
+        }
+    }
+
+    // The key for name, without adding it to the table: absent (false)
+    // when no key by that name can exist
+    static Key find(std::string_view name) {
+        Atom atom = AtomTable::lookup(name);
+        if (atom != AtomTable::kNoAtom) {
+            return Key(atom);
+        }
+        Key key;
+        if (AtomTable::overflowed()) {
+            key.name_ = std::make_shared<const std::string>(name);
+        }
+        return key;
+    }
+
+    explicit operator bool() const { return atom_ != AtomTable::kNoAtom || name_; }
+    bool interned() const { return atom_ != AtomTable::kNoAtom; }
+    Atom atom() const { return atom_; }  // kNoAtom if not interned
+    const std::string& str() const { return name_ ? *name_ : AtomTable::name(atom_); }
+    operator const std::string&() const { return str(); }
+
+    bool operator==(const Key& other) const {
+        return atom_ == other.atom_ && (atom_ != AtomTable::kNoAtom || same_name(other));
+    }
+    bool operator!=(const Key& other) const { return !(*this == other); }
+    bool operator==(std::string_view name) const { return str() == name; }
+    bool operator!=(std::string_view name) const { return str() != name; }
+
+    // An arbitrary but fixed order, for sorting and deduplicating keys
+    bool operator<(const Key& other) const {
+        if (atom_ != other.atom_) {
+            return atom_ < other.atom_;
+        }
+        return atom_ == AtomTable::kNoAtom && name_ && other.name_ && *name_ < *other.name_;
+    }
+
+    // Fibonacci hashing spreads sequential atom ids; names are hashed as text
+    size_t hash() const {
+        if (name_) {
+            return std::hash<std::string_view>{}(*name_);
+        }
+        return static_cast<size_t>(atom_ * 0x9E3779B97F4A7C15ull >> 32);
+    }
+
+private:
+    Atom atom_ = AtomTable::kNoAtom;
+    std::shared_ptr<const std::string> name_;  // only when not interned
+
+    bool same_name(const Key& other) const {
+        if (!name_ || !other.name_) {
+            return !name_ && !other.name_;
+        }
+        return name_ == other.name_ || *name_ == *other.name_;
+    }
+};
+
+} // namespace tq
+
+template <>
+struct std::hash<tq::Key> {
+    size_t operator()(const tq::Key& key) const { return key.hash(); }
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace tq {
+
+// Exact int64 arithmetic: each returns true if the result overflows, and
+// otherwise stores it in out. GCC and Clang use their overflow builtins;
+// other compilers (MSVC) the portable versions below.
+namespace checked {
+
+constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
+
+constexpr bool portable_add(int64_t a, int64_t b, int64_t& out) {
+    if ((b > 0 && a > kMax - b) || (b < 0 && a < kMin - b)) {
+        return true;
+    }
+    out = a + b;
+    return false;
+}
+
+constexpr bool portable_sub(int64_t a, int64_t b, int64_t& out) {
+    if ((b < 0 && a > kMax + b) || (b > 0 && a < kMin + b)) {
+        return true;
+    }
+    out = a - b;
+    return false;
+}
+
+constexpr bool portable_mul(int64_t a, int64_t b, int64_t& out) {
+    if (a == 0 || b == 0) {
+        out = 0;
+        return false;
+    }
+    // Compare magnitudes by division, which cannot overflow once -1 is out
+    // of the way
+    if (a == -1 || b == -1) {
+        int64_t other = a == -1 ? b : a;
+        if (other == kMin) {
+            return true;
+        }
+        out = -other;
+        return false;
+    }
+    bool overflows = a > 0 ? (b > 0 ? a > kMax / b : b < kMin / a)
+                           : (b > 0 ? a < kMin / b : a < kMax / b);
+    if (overflows) {
+        return true;
+    }
+    out = a * b;
+    return false;
+}
+
+inline bool add(int64_t a, int64_t b, int64_t& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_add_overflow(a, b, &out);
+#else
+    return portable_add(a, b, out);
+#endif
+}
+
+inline bool sub(int64_t a, int64_t b, int64_t& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_sub_overflow(a, b, &out);
+#else
+    return portable_sub(a, b, out);
+#endif
+}
+
+inline bool mul(int64_t a, int64_t b, int64_t& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_mul_overflow(a, b, &out);
+#else
+    return portable_mul(a, b, out);
+#endif
+}
+
+} // namespace checked
+
+} // namespace tq
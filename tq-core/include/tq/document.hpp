@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ast.hpp"
+#include "value.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tq {
+
+// Parsed document that any number of threads may query at the same time.
+//
+// The tree is built once and never modified afterwards. Queries only read
+// it through const access; anything they change is a copy-on-write clone
+// (see Value), and the caches filled on the way (table rows, hashes, field
+// slots, atoms, shapes) are published atomically. Copies of a Document
+// share one tree, and query results hold their own references, so results
+// stay valid after the last Document copy is gone.
+class Document {
+public:
+    // Parses TOON text
+    explicit Document(std::string text);
+
+    // Wraps an existing tree; later changes to root through other Values do
+    // not reach the document
+    explicit Document(Value root);
+
+    const Value& root() const { return *root_; }
+
+    // Runs a query with a fresh Evaluator. A compiled Query can be shared by
+    // threads as well.
+    std::vector<Value> query(const std::string& expression) const;
+    std::vector<Value> query(const Query& compiled) const;
+
+    // Parses expression once for repeated use with query()
+    static Query compile(const std::string& expression);
+
+private:
+    std::shared_ptr<const Value> root_;
+};
+
+} // namespace tq
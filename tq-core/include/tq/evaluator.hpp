@@ -1,6 +1,8 @@
 #pragma once
 
 #include "ast.hpp"
+#include "lazy_document.hpp"
+#include "tape.hpp"
 #include "value.hpp"
 #include <vector>
 #include <map>
@@ -27,6 +29,20 @@ public:
     // Evaluate expression against data, returning multiple results (jq stream semantics)
     std::vector<Value> eval(const ExprPtr& expr, const Value& data);
     
+    // Same results as eval(), but navigation (.a.b, .[i], .[], .., pipes and
+    // commas of those) borrows from data instead of copying. Only computed
+    // values and table rows are owned.
+    std::vector<ValueRef> eval_refs(const ExprPtr& expr, const Value& data);
+    
+    // Evaluates against a tape. Navigation walks the tape itself; only the
+    // results, and the input of any other kind of expression, are
+    // materialized as Values.
+    std::vector<Value> eval(const ExprPtr& expr, const Tape& tape);
+    
+    // Evaluates against a lazy document the same way: navigation decodes
+    // only the fields it passes through
+    std::vector<Value> eval(const ExprPtr& expr, const LazyDocument& doc);
+    
 private:
     // Built-in functions registry
     std::map<std::string, BuiltinFunc> builtins_;
@@ -44,10 +60,17 @@ private:
     void register_builtins();
     
     // Expression evaluation
+    void collect_refs(const ExprPtr& expr, const Value& data, std::vector<ValueRef>& out);
+    // Navigation over a TapeRef or LazyRef cursor
+    template <typename Cursor>
+    void eval_cursor(const ExprPtr& expr, const Cursor& data, std::vector<Value>& out);
+    template <typename Cursor>
+    void collect_cursor(const ExprPtr& expr, const Cursor& data, std::vector<Cursor>& out);
     std::vector<Value> eval_identity(const Value& data);
     std::vector<Value> eval_field(const ExprPtr& expr, const Value& data);
     std::vector<Value> eval_index(const ExprPtr& expr, const Value& data);
     std::vector<Value> eval_slice(const ExprPtr& expr, const Value& data);
+    std::vector<Value> eval_dynamic_index(const ExprPtr& expr, const Value& data);
     std::vector<Value> eval_iterator(const Value& data);
     std::vector<Value> eval_recursive_descent(const Value& data);
     std::vector<Value> eval_pipe(const ExprPtr& expr, const Value& data);
@@ -58,9 +81,28 @@ private:
     std::vector<Value> eval_try(const ExprPtr& expr, const Value& data);
     std::vector<Value> eval_function_call(const ExprPtr& expr, const Value& data);
     std::vector<Value> eval_array_literal(const ExprPtr& expr, const Value& data);
+    std::vector<Value> eval_generator_call(const ExprPtr& expr, const Value& data);
+    // If expr is range(...) over integers, sets out to the lazy array of its outputs
+    bool eval_range(const ExprPtr& expr, const Value& data, Value& out);
     std::vector<Value> eval_object_literal(const ExprPtr& expr, const Value& data);
     std::vector<Value> eval_reduce(const ExprPtr& expr, const Value& data);
     std::vector<Value> eval_foreach(const ExprPtr& expr, const Value& data);
+    std::vector<Value> eval_variable(const ExprPtr& expr);
+    // Takes data by value: a caller that hands over its only reference
+    // (reduce, foreach) has the paths updated in place
+    std::vector<Value> eval_assignment(const ExprPtr& expr, Value data);
+    // setpath, delpaths and del called on data, taken by value in the same way
+    std::vector<Value> eval_path_update(const ExprPtr& expr, Value data);
+    
+    // Paths expr navigates to from data, in output order, each with the
+    // value found there (null where the path does not exist yet). Throws
+    // for expressions that compute rather than navigate.
+    using PathEntry = std::pair<std::vector<Value>, Value>;
+    void collect_paths(const ExprPtr& expr, const Value& data, std::vector<Value>& prefix,
+                       std::vector<PathEntry>& out);
+    
+    // One reduce/foreach update of acc, which the caller owns outright
+    Value reduce_step(const ExprPtr& update, Value acc);
     
     // Helpers
     bool is_truthy(const Value& val);
@@ -128,6 +170,11 @@ private:
     std::vector<Value> builtin_not(const std::vector<std::vector<Value>>& args);
     std::vector<Value> builtin_paths(const std::vector<std::vector<Value>>& args);
     std::vector<Value> builtin_leaf_paths(const std::vector<std::vector<Value>>& args);
+    std::vector<Value> builtin_getpath(const std::vector<std::vector<Value>>& args);
+    std::vector<Value> builtin_setpath(const std::vector<std::vector<Value>>& args);
+    std::vector<Value> builtin_delpaths(const std::vector<std::vector<Value>>& args);
+    std::vector<Value> builtin_path(const ExprPtr& expr, const Value& data);
+    std::vector<Value> builtin_del(const ExprPtr& expr, const Value& data);
     std::vector<Value> builtin_keys_unsorted(const std::vector<std::vector<Value>>& args);
     std::vector<Value> builtin_min_by_value(const std::vector<std::vector<Value>>& args);
     std::vector<Value> builtin_max_by_value(const std::vector<std::vector<Value>>& args);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "arena.hpp"
+#include "atom.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tq {
+
+class LazyRef;
+class Projection;
+
+// TOON document decoded on demand. Construction only indexes the lines of
+// the input. The first time a query looks into an object, its fields are
+// located: one key and one line number each, with every nested block
+// skipped by its indentation. The first time a query reaches a field, its
+// value is decoded by the same code as ToonParser::parse; nested objects
+// stay lazy in turn. A lookup like `.metadata.count` thus decodes the few
+// lines of metadata and nothing of the arrays beside it.
+//
+// On well-formed input every value is the one ToonParser::parse builds.
+// Where that parser ends an object at the first line it cannot place, this
+// one skips the line by its indentation and goes on with the next field.
+//
+// Decoding is serialized by a mutex, so any number of threads may query one
+// LazyDocument at the same time.
+//
+// Given the Projection of the queries it will answer, a LazyDocument leaves
+// out what they never read whenever it decodes a value.
+class LazyDocument {
+public:
+    // As ToonParser::parse: plain strings borrow from content, containers
+    // come from arena when one is given, large arrays use up to threads
+    // threads (0: one per core; one by default), and fields projection
+    // never reads are skipped
+    explicit LazyDocument(std::string content, Arena* arena = nullptr, unsigned threads = 1,
+                          std::shared_ptr<const Projection> projection = nullptr);
+    LazyDocument(LazyDocument&&) noexcept;
+    LazyDocument& operator=(LazyDocument&&) noexcept;
+    ~LazyDocument();
+
+    LazyRef root() const;
+
+    // Decodes whatever is left of the document
+    Value to_value() const;
+
+    // Lines read so far, by field lookups and decoding together
+    size_t lines_decoded() const;
+
+private:
+    friend class LazyRef;
+    struct Node;
+    struct State;
+
+    std::unique_ptr<State> state_;
+
+    // Each of these runs with the state's mutex held
+    void scan(Node& node) const;
+    LazyRef field(Node& node, size_t i) const;
+    Value decode(Node& node) const;
+};
+
+// Position in a LazyDocument: a value already decoded, or an object whose
+// fields are still only text. Valid while the document is alive. A
+// default-constructed ref is absent, as are failed lookups.
+class LazyRef {
+public:
+    LazyRef() = default;
+    explicit LazyRef(Value value) : value_(std::move(value)), present_(true) {}
+
+    explicit operator bool() const { return present_; }
+    Value::Type type() const { return node_ ? Value::Type::Object : value_.type(); }
+    bool is_array() const { return type() == Value::Type::Array; }
+    bool is_object() const { return type() == Value::Type::Object; }
+
+    // Elements of an array, fields of an object, 0 otherwise
+    size_t size() const;
+    // Field of an object by key; absent if missing or not an object
+    LazyRef get(Key key) const;
+    // Element of an array; absent if out of range or not an array
+    LazyRef get(size_t index) const;
+    // Appends the elements of an array or the field values of an object
+    void children(std::vector<LazyRef>& out) const;
+    // Appends this value and everything nested in it, in document order
+    void descendants(std::vector<LazyRef>& out) const;
+    // Decodes what is left of this value
+    Value to_value() const;
+
+private:
+    friend class LazyDocument;
+    LazyRef(const LazyDocument* doc, LazyDocument::Node* node) : doc_(doc), node_(node), present_(true) {}
+
+    const LazyDocument* doc_ = nullptr;
+    LazyDocument::Node* node_ = nullptr;  // an object not decoded as a whole
+    Value value_;                         // otherwise, the value itself
+    bool present_ = false;
+};
+
+} // namespace tq
@@ -80,6 +80,9 @@ enum class TokenType {
     // Format functions
     Format,        // @base64, @uri, @csv, etc.
     
+    // Variables
+    Variable,      // $name
+    
     // Function names (built-ins)
     Select,        // select
     Map,           // map
@@ -91,7 +94,7 @@ enum class TokenType {
 
 struct Token {
     TokenType type;
-    std::string value;  // only used for Identifier
+    std::string value;  // Identifier, Variable and literal text
     size_t position;
     
     Token(TokenType t, std::string v = "", size_t pos = 0)
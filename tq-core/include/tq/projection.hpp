@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ast.hpp"
+#include "atom.hpp"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace tq {
+
+// The parts of its input a query can read: the keys it can reach at each
+// level of objects, and below them what it reads of each. An array is read
+// through its elements, so a projection applies to every element alike.
+//
+//   .users[] | select(.age > 30) | {name: .name}   users: { age, name }
+//   .meta.count, .meta.owner                         meta: { count, owner }
+//
+// A parser given a projection skips every field it does not list, without
+// decoding the field's value. Anything a query may read as a whole (a
+// result, a value it compares or passes to a builtin, `..`, `keys`) is kept
+// whole.
+class Projection {
+public:
+    // What query can read of its input, or nullptr if that may be all of it
+    static std::shared_ptr<const Projection> of(const Query& query);
+
+    // For parsers, where nullptr stands for the whole value: whether a field
+    // of p is never read, and what is read of a field or of array elements
+    static bool skips(const Projection* p, Key key) {
+        return p && !p->whole_ && !p->field(key);
+    }
+    static const Projection* field(const Projection* p, Key key) {
+        return p && !p->whole_ ? p->field(key) : nullptr;
+    }
+    static const Projection* elements(const Projection* p);
+
+private:
+    using Positions = std::vector<Projection*>;
+
+    bool whole_ = false;
+    std::vector<std::pair<Key, std::unique_ptr<Projection>>> fields_;
+    std::unique_ptr<Projection> values_;    // of every field, after .[] on an object
+    std::unique_ptr<Projection> elements_;  // of every element, after .[] or .[i] on an array
+
+    const Projection* field(Key key) const;
+
+    // The analysis: out receives the positions in the input that the
+    // results of expr can be, for input at the positions in
+    static void analyze(const ExprPtr& expr, const Positions& in, Positions& out);
+    static void read_whole(const Positions& at);
+    Projection* child(Key key);
+    Projection* values();
+    Projection* elements();
+
+    void merge(const Projection& other);
+    void settle();  // folds values_ into every listed field
+};
+
+} // namespace tq
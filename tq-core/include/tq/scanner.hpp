@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tq {
+
+// Bytes the TOON parser cares about in one 64-byte block of input, one bit
+// per byte (bit i is byte i of the block). Bytes past the end of the input
+// never match.
+struct ScanBlock {
+    uint64_t newline;
+    uint64_t colon;
+    uint64_t quote;
+    uint64_t escape;     // backslash
+    uint64_t delimiter;  // ',', '|' or '\t': any of the delimiters an array header can choose
+};
+
+// Implementations of the scan, fastest last. Vector backends exist on x86
+// builds with GCC or Clang and are used only where the CPU supports them.
+enum class ScanBackend {
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512,
+};
+
+// Vectorized pre-pass over TOON input. The backend is chosen once, from
+// the CPU, the first time it is needed; force() overrides the choice so
+// tests and benchmarks can run every backend on the same input.
+class StructuralScanner {
+public:
+    // Fills out[0, count) for blocks first, first + 1, ... of text
+    static void scan(std::string_view text, size_t first, size_t count, ScanBlock* out);
+
+    static ScanBackend backend();
+    static bool supported(ScanBackend backend);
+    static const char* name(ScanBackend backend);
+
+    // Throws std::invalid_argument if this CPU or build lacks the backend
+    static void force(ScanBackend backend);
+    // Back to the best backend for this CPU
+    static void reset();
+};
+
+} // namespace tq
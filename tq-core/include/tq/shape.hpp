@@ -0,0 +1,79 @@
+#pragma once
+
+#include "atom.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace tq {
+
+// Hidden class of an object: its ordered key list, mapping each key to a
+// slot index. Objects built by inserting the same keys in the same order
+// share one Shape, found through the transition from the previous shape.
+// Shapes are process-wide and immutable once published, like atoms.
+class Shape {
+public:
+    static constexpr uint32_t kMaxKeys = 64;          // larger objects use their own index
+    static constexpr size_t kIndexThreshold = 12;     // shapes this large hash their keys
+
+    // The shape with no keys
+    static const Shape* empty();
+
+    // Shape with key appended, or nullptr when the shape would exceed
+    // kMaxKeys, the shape table is full or key is not interned
+    const Shape* with(Key key) const;
+
+    // Shape for a whole key list, or nullptr if one cannot be made
+    static const Shape* of(const std::vector<Key>& keys);
+
+    // Slot of key, or -1
+    long slot(Key key) const;
+
+    uint32_t id() const { return id_; }
+    size_t size() const { return keys_.size(); }
+    Key key(size_t slot) const { return keys_[slot]; }
+    const std::vector<Key>& keys() const { return keys_; }
+
+private:
+    Shape(uint32_t id, std::vector<Key> keys);
+
+    uint32_t id_;
+    std::vector<Key> keys_;
+    std::vector<uint32_t> index_;  // open-addressed slots: slot + 1, 0 = empty
+
+    // Transitions to child shapes; the last one taken is cached lock-free
+    mutable std::mutex mutex_;
+    mutable std::vector<const Shape*> children_;
+    mutable std::atomic<const Shape*> last_child_{nullptr};
+};
+
+// Monomorphic inline cache for one key: remembers the last shape a lookup
+// saw and the key's slot in it, so lookups on uniform data skip the search.
+// Shared AST nodes may be evaluated concurrently, so the entry is one atomic
+// word. Copies start cold.
+class FieldCache {
+public:
+    FieldCache() = default;
+    FieldCache(const FieldCache&) {}
+    FieldCache& operator=(const FieldCache&) { return *this; }
+
+    // Slot of the key in shape, if this cache last saw that shape
+    bool lookup(const Shape* shape, uint32_t& slot) const {
+        uint64_t entry = entry_.load(std::memory_order_relaxed);
+        if (static_cast<uint32_t>(entry >> 32) != shape->id() + 1) {
+            return false;
+        }
+        slot = static_cast<uint32_t>(entry);
+        return true;
+    }
+
+    void update(const Shape* shape, uint32_t slot) const {
+        entry_.store((static_cast<uint64_t>(shape->id() + 1) << 32) | slot, std::memory_order_relaxed);
+    }
+
+private:
+    mutable std::atomic<uint64_t> entry_{0};
+};
+
+} // namespace tq
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "atom.hpp"
+#include "value.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tq {
+
+class TapeRef;
+
+// Read-only document laid out flat instead of as a tree of nodes. One
+// contiguous array of 64-bit words holds every value in document order; the
+// top byte of a word is its tag, the low 56 bits its payload:
+//
+//   n t f   null, true, false
+//   l d     int64, double: the raw bits follow in the next word
+//   s       string: offset into the string buffer; the length follows
+//   [ {     array, object start: low 32 bits index just past the matching
+//           end, bits 32-54 the element or field count, bit 55 set on an
+//           array whose elements all share one header's keys
+//   ] }     array, object end: index of the matching start
+//   k       object key: index into the tape's key table; the value follows
+//   x       key whose field was overwritten later in the same object
+//
+// Strings are stored unescaped in one side buffer. Reading children is a
+// forward scan, skipping a container is one jump, and freeing the document
+// frees the word array and the string buffer.
+//
+// Nothing on the tape depends on the process that wrote it: keys are
+// numbered per tape, and their names are kept in the key table. save()
+// writes the tape as a binary snapshot (.tqb) that load() maps back into
+// memory and queries in place.
+class Tape {
+public:
+    class Builder;
+
+    Tape(Tape&&) noexcept;
+    Tape& operator=(Tape&&) noexcept;
+    ~Tape();
+
+    TapeRef root() const;
+    size_t word_count() const { return word_count_; }
+
+    // Materializes the whole document as a Value tree
+    Value to_value() const;
+
+    // Writes a snapshot; throws std::runtime_error if the file cannot be written
+    void save(const std::string& path) const;
+
+    // Maps a snapshot written by save(). Only the header and the key names
+    // are read up front; pages are read as queries touch them. Throws
+    // std::runtime_error if the file is missing, truncated, or not a
+    // snapshot of this format and byte order. Damage further in is found
+    // when a query reads it: TapeRef then throws "Corrupt snapshot" rather
+    // than reading outside the file.
+    static Tape load(const std::string& path);
+
+private:
+    friend class TapeRef;
+    struct Mapping;
+
+    Tape(std::vector<uint64_t> words, std::string strings, std::vector<Key> keys);
+    explicit Tape(std::unique_ptr<Mapping> mapping);
+
+    const uint64_t* words_ = nullptr;
+    size_t word_count_ = 0;
+    std::string_view strings_;
+    std::vector<Key> keys_;           // key table, by key index
+    std::vector<uint32_t> key_ids_;   // atom -> key index + 1, 0 if not on this tape
+
+    // Storage: built in memory, or mapped from a snapshot
+    std::vector<uint64_t> owned_words_;
+    std::optional<InputBuffer> owned_strings_;  // string Values borrow from it
+    std::unique_ptr<Mapping> mapping_;
+
+    void index_keys();
+    uint32_t key_id(Key key) const;
+};
+
+// Appends values to a tape in document order. Containers are opened and
+// closed around their contents; inside an object every value is preceded by
+// key(). Counts and end indices are filled in when a container closes.
+class Tape::Builder {
+public:
+    void null();
+    void boolean(bool b);
+    void integer(int64_t i);
+    void number(double d);
+    void string(std::string_view s);
+
+    void begin_array();
+    void end_array(bool table = false);  // table: elements are rows of one header
+    void begin_object();
+    void key(Key key);  // a repeated key replaces the earlier field
+    void end_object();
+
+    void reserve(size_t words, size_t string_bytes);
+    Tape finish();
+
+private:
+    struct Frame {
+        size_t start;
+        size_t count = 0;
+        size_t keys = 0;  // where this object's keys begin in open_keys_
+        bool repeated = false;  // a key of this object came twice
+    };
+
+    std::vector<uint64_t> words_;
+    std::string strings_;
+    std::vector<Frame> frames_;
+    std::vector<Key> keys_;           // key table, by key index
+    std::vector<uint32_t> key_ids_;   // atom -> key index + 1
+    std::vector<std::pair<uint32_t, size_t>> open_keys_;  // keys of open objects and their word index
+
+    void push(char tag, uint64_t payload = 0);
+    void element();  // counts one more value in an open array
+    void close(char tag);
+    void merge_repeated(size_t start);
+};
+
+// Position of one value in a tape; valid while the tape is alive. A
+// default-constructed ref is absent, as are failed lookups.
+class TapeRef {
+public:
+    TapeRef() = default;
+    TapeRef(const Tape* tape, size_t index) : tape_(tape), index_(index) {}
+
+    explicit operator bool() const { return tape_ != nullptr; }
+
+    Value::Type type() const;
+    bool is_array() const { return type() == Value::Type::Array; }
+    bool is_object() const { return type() == Value::Type::Object; }
+
+    // Elements of an array, fields of an object, 0 otherwise
+    size_t size() const;
+
+    // Field of an object by key; absent if missing or not an object
+    TapeRef get(Key key) const;
+
+    // Element of an array; absent if out of range or not an array
+    TapeRef get(size_t index) const;
+
+    // Appends the elements of an array or the field values of an object
+    void children(std::vector<TapeRef>& out) const;
+
+    // Appends this value and everything nested in it, in document order
+    void descendants(std::vector<TapeRef>& out) const;
+
+    // Materializes this value. Strings borrow from the tape's string buffer;
+    // arrays of header rows become tables, as ToonParser::parse builds them.
+    Value to_value() const;
+
+private:
+    friend class Tape;
+
+    const Tape* tape_ = nullptr;
+    size_t index_ = 0;
+
+    uint64_t word() const { return tape_->words_[index_]; }
+    Key key_at(size_t index) const;  // key of the 'k' word at index
+    size_t end() const;  // index just past this value
+    // Index past the member at i of this array or object: an element, or a
+    // key and its value; close is the index of the closing word
+    size_t member_end(size_t i, size_t close) const;
+};
+
+inline TapeRef Tape::root() const { return TapeRef(this, 0); }
+
+} // namespace tq
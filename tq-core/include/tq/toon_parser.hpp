@@ -1,21 +1,103 @@
 #pragma once
 
+#include "tape.hpp"
 #include "value.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace tq {
 
+class Projection;
+
 class ToonParser {
 public:
-    static Value parse(const std::string& content);
+    // The document is kept in an InputBuffer; plain string values borrow from it.
+    // With an arena, containers are allocated from it (see Arena for lifetime).
+    // Large tabular and list arrays are split into line ranges and decoded
+    // on up to threads threads (0: one per core), with results in order;
+    // one unless the caller opts in, as a library should not fill the
+    // machine. With a projection, fields it never reads are skipped undecoded.
+    static Value parse(std::string content, Arena* arena = nullptr, unsigned threads = 1, const Projection* projection = nullptr);
+    
+    // Same document as a flat Tape, for read-only use. Nothing of content
+    // is kept; strings are copied into the tape.
+    static Tape parse_tape(std::string content);
     
 private:
+    friend class ToonReader;    // streams the same grammar line by line
+    friend class LazyDocument;  // decodes the same grammar one field at a time
+    
+    // One entry per input line, built in a single pass before parsing, plus
+    // a final entry that only marks where the last line ends
+    struct Line {
+        uint64_t start : 40;   // offset of the line in the buffer
+        uint64_t indent : 24;  // leading spaces
+    };
+    
+    // Line index and structural bitmaps of a document
+    struct Index {
+        std::vector<Line> lines;  // line_count entries and the end marker
+        std::vector<uint64_t> structural;  // per 64-byte block: quotes, backslashes, colons and delimiters
+    };
+    
     // Context for parsing state
     struct Context {
-        std::vector<std::string> lines;
+        InputBuffer buffer;
+        std::shared_ptr<const Index> index;
+        const Line* lines;  // index->lines
+        size_t line_count;
         size_t current_line;
         int indent_size;
+        Arena* arena;  // nullptr: heap
+        unsigned threads;  // for large arrays; 1 in the workers themselves
+        mutable uint32_t reserved = 0;  // buffer references for slice()
+        
+        // Keys seen recently, by their text in the document. The same few
+        // keys repeat on every row or item; a hit here skips parse_key and
+        // the shared atom table.
+        struct KeySlot {
+            std::string_view text;
+            Key key;
+        };
+        KeySlot keys[64];
+        
+        // Indexes content
+        Context(std::string content, Arena* arena, unsigned threads);
+        // A worker's context over parent's document, on its own thread
+        Context(const Context& parent, Arena* arena);
+        Context(const Context&) = delete;
+        Context& operator=(const Context&) = delete;
+        ~Context() { buffer.unreserve(reserved); }
+        
+        // Line without its indentation or trailing '\r'; a view into buffer
+        std::string_view content(size_t line) const {
+            const char* data = buffer.view().data();
+            size_t first = lines[line].start + lines[line].indent;
+            size_t last = lines[line + 1].start - 1;
+            if (last > first && data[last - 1] == '\r') {
+                last--;
+            }
+            return std::string_view(data + first, last - first);
+        }
+        int depth(size_t line) const { return static_cast<int>(lines[line].indent) / indent_size; }
+        // Items an array header announces, capped by the lines left to hold them
+        size_t rows_left(int announced) const {
+            return announced <= 0 ? 0 : std::min(static_cast<size_t>(announced), line_count - current_line);
+        }
+        Key key(std::string_view text);
+        // String value borrowing part of buffer
+        Value slice(std::string_view part) const { return buffer.slice(part, reserved); }
+        
+        // Scans of text inside buffer, driven by the structural bitmaps:
+        // the first ':' outside quotes, and the parts between delimiters
+        // outside quotes
+        size_t find_colon(std::string_view s) const;
+        void split(std::string_view s, char delimiter, std::vector<std::string_view>& out) const;
     };
     
     // Array header information
@@ -24,32 +106,94 @@ private:
         int length;
         char delimiter;
         std::vector<std::string> fields;
+        std::vector<Key> field_keys;  // fields interned once per header, shared by every row
+    };
+    
+    // Items of a list array as they are read. While every item is an object
+    // with the same keys in the same order, the items are kept as the rows
+    // of a table, column-wise like a tabular array; the first item that
+    // differs turns the rows so far into objects.
+    struct ListItems {
+        std::vector<Value> items;  // once the items are not rows
+        std::vector<Key> keys;     // of every row
+        std::vector<std::vector<Value>> columns;
+        size_t rows = 0;
+        size_t expected = 0;   // rows to reserve columns for
+        bool columnar = true;  // no item so far stopped the rows
+        // Shapes of the last few object items, latest first, for items that
+        // repeat their keys (a list often alternates between a few)
+        std::array<const Shape*, 4> shapes{};
+        std::vector<std::pair<Key, Value>> fields;  // the object item being read
+        
+        size_t size() const { return items.size() + rows; }
+        void add(Value item);  // an item other than an object of fields
+        void add_fields(Arena* arena);  // the object made of fields
+        void append(ListItems&& other);  // the items of the next range
+        Value finish(Arena* arena);
+        
+    private:
+        bool fields_match(const std::vector<Key>& keys) const;
+        void to_objects();
     };
     
-    // Main parsing functions
-    static Value parse_object_fields(Context& ctx, int base_depth);
-    static Value parse_root_array(Context& ctx);
-    static Value parse_inline_array(const std::string& values_str, int expected_length, char delimiter);
-    static Value parse_tabular_array(Context& ctx, int item_depth, const ArrayHeader& header);
-    static Value parse_list_array(Context& ctx, int item_depth, int expected_length);
-    static Value parse_primitive(const std::string& str);
+    // Arrays with at least kParallelRows rows or items are decoded in
+    // ranges of kRangeRows, handed out in order to the threads as they free up
+    static constexpr size_t kParallelRows = 16384;
+    static constexpr size_t kRangeRows = 4096;
+    
+    // Calls work(context, begin, end) for ranges covering [0, count): on
+    // ctx itself for small counts or one thread, otherwise on worker
+    // contexts across up to ctx.threads threads, as many as the system
+    // will start. The first exception a range
+    // throws is rethrown once every thread has stopped.
+    template <typename Work>
+    static void for_each_range(Context& ctx, size_t count, Work work);
+    
+    // Main parsing functions. p is what is read of the value being built
+    // (nullptr: all of it); see Projection.
+    static Value parse_object_fields(Context& ctx, int base_depth, const Projection* p);
+    static Value parse_root_array(Context& ctx, const Projection* p);
+    static Value parse_inline_array(const Context& ctx, std::string_view values_str, int expected_length, char delimiter);
+    static Value parse_tabular_array(Context& ctx, int item_depth, const ArrayHeader& header, const Projection* p);
+    static Value parse_list_array(Context& ctx, int item_depth, int expected_length, const Projection* p);
+    static void parse_list_items(Context& ctx, int item_depth, size_t count, ListItems& items, const Projection* p);
+    static Value parse_primitive(const Context& ctx, std::string_view str);
+    
+    // Tape output, following the same grammar as the functions above
+    static void tape_object_fields(Context& ctx, Tape::Builder& out, int base_depth);
+    static void tape_root_array(Context& ctx, Tape::Builder& out);
+    static void tape_inline_array(const Context& ctx, Tape::Builder& out, std::string_view values_str, char delimiter);
+    static void tape_tabular_array(Context& ctx, Tape::Builder& out, int item_depth, const ArrayHeader& header);
+    static void tape_list_array(Context& ctx, Tape::Builder& out, int item_depth, int expected_length);
+    static void tape_primitive(Tape::Builder& out, std::string_view str);
     
     // Helper functions
-    static std::vector<std::string> split_lines(const std::string& content);
-    static int get_line_depth(const std::string& line, int indent_size);
-    static std::string get_line_content(const std::string& line);
-    static void trim(std::string& s);
+    // Line index and structural bitmaps, from one vectorized pass
+    static std::vector<Line> index_lines(std::string_view content, std::vector<uint64_t>& structural);
+    // Without the whitespace around it, std::isspace in the C locale. Inline:
+    // every field of every line goes through it.
+    static std::string_view trim(std::string_view s) {
+        auto is_space = [](char c) { return c == ' ' || (c >= '\t' && c <= '\r'); };
+        size_t start = 0;
+        while (start < s.size() && is_space(s[start])) {
+            start++;
+        }
+        size_t end = s.size();
+        while (end > start && is_space(s[end - 1])) {
+            end--;
+        }
+        return s.substr(start, end - start);
+    }
     
     // Array header parsing
-    static bool is_array_header(const std::string& content);
-    static ArrayHeader parse_array_header(const std::string& content);
+    static bool is_array_header(std::string_view content);
+    static ArrayHeader parse_array_header(std::string_view content);
     
     // String utilities
-    static std::string parse_key(const std::string& key_str);
-    static size_t find_unquoted_colon(const std::string& str);
-    static std::vector<std::string> split_delimited(const std::string& str, char delimiter);
-    static bool is_numeric(const std::string& str);
-    static std::string unescape_string(const std::string& str);
+    static Key parse_key(std::string_view key_str);
+    static std::vector<std::string_view> split_delimited(std::string_view str, char delimiter);
+    static void split_delimited(std::string_view str, char delimiter, std::vector<std::string_view>& result);
+    static std::string unescape_string(std::string_view str);
 };
 
 } // namespace tq
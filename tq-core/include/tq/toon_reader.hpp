@@ -0,0 +1,131 @@
+#pragma once
+
+#include "shape.hpp"
+#include "toon_parser.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tq {
+
+// Pull parser for TOON input of any size. Input is read in chunks from a
+// stream or file descriptor, and next() reports the document as structural
+// events in document order:
+//
+//   users[2]{id,name}:   BeginObject Key(users) BeginArray(2)
+//     1,Ada                BeginObject Key(id) Scalar(1) Key(name) Scalar(Ada) EndObject
+//     2,Bob                BeginObject ... EndObject
+//                          EndArray
+//                        EndObject End
+//
+// Only the current line and one frame per open container are kept, so
+// memory grows with the longest line and the nesting depth, never with the
+// size of the document. The events describe exactly the tree
+// ToonParser::parse builds, except that a key repeated in one object is
+// reported each time it appears where the tree keeps its last value.
+class ToonReader {
+public:
+    enum class Event {
+        BeginObject,
+        EndObject,
+        BeginArray,  // length() is the count the header declares
+        EndArray,
+        Key,         // key() is the decoded name
+        Scalar,      // text() is the token, value() what it stands for
+        End,         // end of the document; next() keeps returning it
+    };
+
+    static constexpr size_t kDefaultChunk = 64 * 1024;
+
+    explicit ToonReader(std::istream& in, size_t chunk_size = kDefaultChunk);
+    // Reads fd until end of file; fd stays open and belongs to the caller
+    explicit ToonReader(int fd, size_t chunk_size = kDefaultChunk);
+
+    // Throws std::runtime_error on read errors, and what ToonParser throws
+    // for malformed array headers
+    Event next();
+
+    // About the event next() last returned; views are valid until the next
+    // call to next()
+    Event event() const { return current_.event; }
+    std::string_view key() const;
+    std::string_view text() const { return current_.text; }
+    Value value() const;  // throws std::runtime_error unless at a Scalar
+    int64_t length() const { return current_.length; }
+    size_t depth() const { return frames_.size(); }  // containers open
+
+    // The whole value that starts at the event next() last returned, built
+    // as ToonParser::parse would build it; next() goes on after its end
+    Value read_value();
+    // Same, without building anything
+    void skip_value();
+
+private:
+    struct Entry {
+        Event event;
+        std::string_view text;  // into buffer_, a frame, or header_key_
+        int64_t length = 0;
+        bool raw_key = false;   // text still needs unquoting as a key
+        const Shape* shape = nullptr;  // BeginObject of a full table row: the header's fields
+    };
+
+    enum class Kind { Object, List, ItemFields, Table };
+    struct Frame {
+        Kind kind;
+        int depth;               // of the lines this frame reads
+        int64_t remaining = -1;  // List and Table: items still announced; negative: no limit
+        char delimiter = ',';
+        std::vector<std::string> fields = {};  // Table
+        const Shape* shape = nullptr;          // Table: of fields, when they are distinct
+    };
+
+    struct Line {
+        int depth;
+        std::string_view content;  // without indentation or trailing '\r'
+    };
+
+    // Input
+    std::istream* in_ = nullptr;
+    int fd_ = -1;
+    size_t chunk_size_;
+    std::string buffer_;   // starts at the current line; older lines are dropped on refill
+    size_t line_start_ = 0;
+    size_t line_end_ = 0;  // of the line read_line last returned
+    bool eof_ = false;
+
+    // Parse state
+    bool started_ = false;
+    bool done_ = false;
+    std::vector<Frame> frames_;
+    std::vector<Entry> queue_;  // events of the line just read
+    size_t queued_ = 0;         // next entry of queue_ to return
+    Entry current_{Event::End, {}, 0, false};
+    std::string header_key_;
+    std::vector<std::string_view> parts_;
+    mutable std::string key_storage_;
+
+    bool fill();
+    bool has_line(size_t& end);
+    bool read_line(Line& line);
+    bool last_line();
+    void advance() { line_start_ = line_end_ + 1; }
+
+    void step();
+    void start();
+    void step_object(Frame& frame);
+    void step_list(Frame& frame);
+    void step_item_fields(Frame& frame);
+    void step_table(Frame& frame);
+    void open_array(ToonParser::ArrayHeader header, std::string_view values, int item_depth);
+    void close();
+
+    void emit(Event event, std::string_view text = {}, int64_t length = 0, bool raw_key = false) {
+        queue_.push_back({event, text, length, raw_key, nullptr});
+    }
+};
+
+} // namespace tq
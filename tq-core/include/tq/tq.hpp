@@ -1,21 +1,53 @@
 #pragma once
 
+#include "arena.hpp"
+#include "atom.hpp"
+#include "document.hpp"
+#include "lazy_document.hpp"
+#include "tape.hpp"
 #include "value.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "projection.hpp"
 #include "evaluator.hpp"
 #include "toon_parser.hpp"
+#include "toon_reader.hpp"
+#include "scanner.hpp"
 
+#include <functional>
+#include <iosfwd>
 #include <string>
 #include <vector>
 
 namespace tq {
 
 // High-level API: query TOON data with TQ expression
-// Returns results as TOON strings
-std::vector<std::string> query(const std::string& expression, const std::string& data);
+// Returns results as TOON strings. The parsed document is allocated from
+// arena when one is given and released with it.
+std::vector<std::string> query(const std::string& expression, const std::string& data, Arena* arena = nullptr);
+
+// Same, over a parsed tape or a snapshot loaded with Tape::load()
+std::vector<std::string> query(const std::string& expression, const Tape& data);
+
+// Same, over a document that is decoded only as far as the query reaches
+std::vector<std::string> query(const std::string& expression, const LazyDocument& data);
 
 // Returns results as Value objects
 std::vector<Value> query_values(const std::string& expression, const Value& data);
 
+// Returns results that borrow from data where the query only navigates it;
+// borrowed results are valid while data is alive and unchanged
+std::vector<ValueRef> query_refs(const std::string& expression, const Value& data);
+
+// Runs a query of the form `.path[] | rest` while the data is read from in:
+// each element of the array at .path is decoded on its own, and its results
+// go to emit before the next element is read. Memory holds one element at a
+// time, and results arrive while the input is still being read. Unlike
+// query(), results before an error have already been emitted. The objects
+// on .path are read to their end: a key of .path repeated in one of them
+// takes its last value, as in query(), unless results from its first value
+// went out already, which throws std::runtime_error. Returns false, having
+// read nothing, for queries of any other form.
+bool query_stream(const std::string& expression, std::istream& in, const std::function<void(const Value&)>& emit);
+
 } // namespace tq
@@ -1,17 +1,36 @@
 #pragma once
 
+#include "arena.hpp"
+#include "atom.hpp"
+#include "shape.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <utility>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
-#include <variant>
+#include <memory_resource>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
 #include <stdexcept>
 
 namespace tq {
 
+namespace detail {
+struct Node;
+}
+
+class Object;
+class InputBuffer;
+class Column;
+
 class Value {
 public:
-    enum class Type {
+    enum class Type : uint8_t {
         Null,
         Boolean,
         Number,
@@ -21,70 +40,413 @@ public:
     };
 
     // Constructors
-    Value();  // null
-    explicit Value(bool b);
-    explicit Value(double d);
-    explicit Value(int i);
+    Value() { payload_.node = nullptr; }  // null
+    explicit Value(bool b) : type_(Type::Boolean) { payload_.boolean = b; }
+    explicit Value(double d) : type_(Type::Number) { payload_.number = d; }
+    explicit Value(int64_t i) : type_(Type::Number), subtype_(kInteger) { payload_.integer = i; }
+    explicit Value(int i) : Value(static_cast<int64_t>(i)) {}
     explicit Value(const std::string& s);
     explicit Value(std::string&& s);
     explicit Value(const char* s);
     
-    // Array constructor
-    explicit Value(std::vector<Value>&& arr);
+    // Array constructor; with an arena the node is placed in it
+    explicit Value(std::vector<Value>&& arr, Arena* arena = nullptr);
     explicit Value(const std::vector<Value>& arr);
     
-    // Object constructor
-    explicit Value(std::map<std::string, Value>&& obj);
+    // Object constructor (std::map input is stored in key order)
+    explicit Value(Object&& obj, Arena* arena = nullptr);
+    explicit Value(const Object& obj);
     explicit Value(const std::map<std::string, Value>& obj);
 
-    // Rule of 5
+    // Tabular array stored column-wise: one column per key, all of equal
+    // length. Rows are materialized into objects only when a caller needs
+    // the whole element vector or a whole row object. Low-cardinality string
+    // columns are dictionary encoded (see Column).
+    static Value table(std::vector<Key> keys, std::vector<std::vector<Value>> columns, Arena* arena = nullptr);
+
+    // Virtual arrays: elements are computed from their index, so size and
+    // element access are O(1). The element vector is only built for callers
+    // that ask for all of it (as_array(), serialization) or mutate the array.
+    // range: from, from + step, ... up to but excluding to; step must not be 0.
+    static Value range(int64_t from, int64_t to, int64_t step = 1);
+    // count copies of item
+    static Value repeat(Value item, size_t count);
+
+    // Read-only view of the elements an array has now. A snapshot does not
+    // count as sharing for append(), so the array can keep growing in place
+    // while each snapshot goes on seeing its own prefix. Anything other than
+    // a plain array is returned as is.
+    Value snapshot() const;
+    // Appends to an array, in place when nothing but snapshots shares it;
+    // otherwise the array is copied first, like any other mutation
+    void append(const std::vector<Value>& items);
+
+    // Rule of 5. Moves and scalars never touch a node, so they stay inline.
     Value(const Value& other);
-    Value(Value&& other) noexcept;
+    Value(Value&& other) noexcept {
+        copy_bits(other);
+        other.type_ = Type::Null;
+        other.payload_.node = nullptr;
+    }
     Value& operator=(const Value& other);
-    Value& operator=(Value&& other) noexcept;
-    ~Value();
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            if (holds_node()) {
+                release();
+            }
+            copy_bits(other);
+            other.type_ = Type::Null;
+            other.payload_.node = nullptr;
+        }
+        return *this;
+    }
+    ~Value() {
+        if (holds_node()) {
+            release();
+        }
+    }
 
     // Type checking
     Type type() const { return type_; }
     bool is_null() const { return type_ == Type::Null; }
     bool is_boolean() const { return type_ == Type::Boolean; }
     bool is_number() const { return type_ == Type::Number; }
+    bool is_integer() const { return type_ == Type::Number && subtype_ == kInteger; }
+    bool is_borrowed() const { return type_ == Type::String && subtype_ == kBorrowed; }
+    bool is_table() const { return type_ == Type::Array && subtype_ == kTable; }
+    bool is_row() const { return type_ == Type::Object && subtype_ == kRow; }
+    bool is_sequence() const { return type_ == Type::Array && subtype_ == kSequence; }
+    bool is_snapshot() const { return type_ == Type::Array && subtype_ == kSnapshot; }
     bool is_string() const { return type_ == Type::String; }
     bool is_array() const { return type_ == Type::Array; }
     bool is_object() const { return type_ == Type::Object; }
 
     // Getters (throw if wrong type)
+    // Mutable container accessors copy shared storage first (copy-on-write)
     bool as_boolean() const;
-    double as_number() const;
-    const std::string& as_string() const;
+    double as_number() const;   // integers convert to the nearest double
+    int64_t as_integer() const; // exact; throws unless is_integer()
+    std::string as_string() const;            // copies; prefer as_string_view()
+    std::string_view as_string_view() const;  // valid while this Value is alive
     const std::vector<Value>& as_array() const;
     std::vector<Value>& as_array();
-    const std::map<std::string, Value>& as_object() const;
-    std::map<std::string, Value>& as_object();
+    const Object& as_object() const;
+    Object& as_object();
 
     // Safe access for objects
     const Value* get(const std::string& key) const;
     Value* get(const std::string& key);
+    const Value* get(Key key) const;
+    Value* get(Key key);
+    const Value* get(Key key, const FieldCache& cache) const;  // cached by shape
     
     // Safe access for arrays
     const Value* get(size_t index) const;
     Value* get(size_t index);
 
+    // Array access that never materializes a table or sequence: an element of
+    // a table is a row reference whose fields are read straight from the columns
+    size_t array_size() const;
+    Value element(size_t index) const;
+
+    // Column of a table by key; nullptr if this is not a table or has no such key
+    const Column* column(Key key) const;
+
+    // Fields of an object in insertion order; a table row reads its columns
+    // instead of materializing the row object
+    size_t field_count() const;
+    Key field_key(size_t i) const;
+    const Value& field_value(size_t i) const;
+
+    // Deep ordering in jq order: null < false < true < numbers < strings <
+    // arrays < objects. Numbers compare exactly across int64 and double, NaN
+    // below every other number. Arrays compare element by element; objects
+    // compare their sorted key lists, then their values key by key.
+    int compare(const Value& other) const;
+
+    // Same as compare() == 0, but stops at the first difference in size,
+    // cached hash or field, and never sorts keys
+    bool equals(const Value& other) const;
+    bool operator==(const Value& other) const { return equals(other); }
+    bool operator!=(const Value& other) const { return !equals(other); }
+
+    // Structural hash consistent with equals(): 1 and 1.0 hash alike, as do
+    // objects with the same fields in any order and table rows and the plain
+    // objects they stand for. Arrays, objects and tables compute it once and
+    // cache it in their node until mutable access is next handed out.
+    size_t hash() const;
+
+    // Parse a numeric literal: integers that fit in int64 stay exact, anything
+    // else becomes a double. Throws std::invalid_argument on malformed text.
+    static Value parse_number(std::string_view text);
+    // Same grammar and conversion in one pass, without exceptions: false
+    // (out untouched) when text is not a number
+    static bool try_parse_number(std::string_view text, Value& out) noexcept;
+
     // Serialize to TOON string
     std::string to_toon(int indent_size = 2, int current_depth = 0) const;
 
 private:
-    Type type_;
+    friend class InputBuffer;
+
+    // Compact tagged representation (16 bytes): scalars live inline in the
+    // payload, strings and containers behind one pointer to a reference-counted
+    // node. Copying a Value never copies the node it points to. A borrowed
+    // string points at the node of a whole input document and records its
+    // slice in the spare bytes after the tag.
+    union Payload {
+        bool boolean;
+        double number;
+        int64_t integer;
+        detail::Node* node;
+    };
+
+    enum Subtype : uint8_t {
+        kPlain = 0,
+        kInteger = 1,   // Number: payload_ holds an int64
+        kBorrowed = 2,  // String: slice [offset_, offset_ + length_) of the node's text
+        kTable = 3,     // Array: node is a column-wise table
+        kRow = 4,       // Object: row offset_ of the table node
+        kSequence = 5,  // Array: node computes elements from their index
+        kSnapshot = 6   // Array: prefix of a plain array node (see snapshot())
+    };
+
+    Payload payload_;
+    Type type_ = Type::Null;
+    Subtype subtype_ = kPlain;
+    uint16_t length_ = 0;
+    uint32_t offset_ = 0;
+
+    static constexpr size_t kMaxBorrowedLength = UINT16_MAX;
+    static constexpr size_t kMaxBorrowedOffset = UINT32_MAX;
+
+    void copy_bits(const Value& other) {
+        payload_ = other.payload_;
+        type_ = other.type_;
+        subtype_ = other.subtype_;
+        length_ = other.length_;
+        offset_ = other.offset_;
+    }
+
+    bool holds_node() const { return type_ >= Type::String; }
+    bool same_node(const Value& other) const {
+        return payload_.node == other.payload_.node && subtype_ == other.subtype_ && offset_ == other.offset_;
+    }
+    void retain() const;
+    void release();
+
+    // Give this Value sole ownership of its container before mutation
+    void detach();
+
+    // Cached hash of a container node, 0 if not computed yet
+    std::atomic<size_t>* hash_slot() const;
+
+};
+
+// One column of a table. A string column with few distinct values is stored
+// as a dictionary of those values, sorted, plus a one-byte code per row; rows
+// with equal strings then share one dictionary Value, and equal codes mean
+// equal strings.
+class Column {
+public:
+    static constexpr size_t kMaxDictionary = 256;   // codes fit in one byte
+    static constexpr size_t kMinEncodedRows = 32;    // smaller columns stay plain
+
+    // Encodes values when they are all strings of low enough cardinality
+    explicit Column(std::vector<Value> values);
+
+    size_t size() const { return encoded() ? codes_.size() : values_.size(); }
+    const Value& operator[](size_t row) const { return encoded() ? dictionary_[codes_[row]] : values_[row]; }
+
+    bool encoded() const { return !dictionary_.empty(); }
+    const std::vector<Value>& dictionary() const { return dictionary_; }
+    const std::vector<uint8_t>& codes() const { return codes_; }
+
+    // Code of str in the dictionary, or -1 if no row holds it
+    int code_of(std::string_view str) const;
+
+    // Every row's value, in order
+    std::vector<Value> values() const;
+
+private:
+    std::vector<Value> values_;      // plain storage
+    std::vector<Value> dictionary_;  // encoded storage: distinct values, sorted
+    std::vector<uint8_t> codes_;
+};
+
+// One result of a navigation query. A borrowed ref points into the queried
+// document and is valid while that document is alive and unchanged; an
+// owned ref holds a computed value (or a table row reference) by itself.
+class ValueRef {
+public:
+    static ValueRef borrow(const Value& value) { return ValueRef(&value); }
+    static ValueRef own(Value value) { return ValueRef(std::move(value)); }
+
+    bool borrowed() const { return borrowed_ != nullptr; }
+    const Value& get() const { return borrowed_ ? *borrowed_ : owned_; }
+    const Value& operator*() const { return get(); }
+    const Value* operator->() const { return &get(); }
+
+private:
+    explicit ValueRef(const Value* value) : borrowed_(value) {}
+    explicit ValueRef(Value value) : owned_(std::move(value)) {}
+
+    const Value* borrowed_ = nullptr;
+    Value owned_;
+};
+
+// Reference-counted, immutable copy of an input document. String Values made
+// by slice() borrow their characters from it instead of owning a copy, and
+// keep the buffer alive for as long as they exist.
+class InputBuffer {
+public:
+    explicit InputBuffer(std::string text) : text_(std::move(text)), view_(text_.as_string_view()) {}
+
+    std::string_view view() const { return view_; }
+
+    // String Value for part, which must lie inside view(). Slices too long or
+    // too far into the buffer for the compact encoding are copied instead.
+    Value slice(std::string_view part) const;
     
-    // Use variant for efficient storage
-    std::variant<
-        std::monostate,  // null
-        bool,            // boolean
-        double,          // number
-        std::string,     // string
-        std::vector<Value>,  // array
-        std::map<std::string, Value>  // object
-    > data_;
+    // Same, but the slice's reference to the buffer comes out of reserved,
+    // which is topped up from the buffer in batches. Threads slicing one
+    // buffer this way each keep their own reserved count instead of all
+    // updating the buffer's; unreserve hands back what is left.
+    Value slice(std::string_view part, uint32_t& reserved) const;
+    void unreserve(uint32_t& reserved) const;
+
+private:
+    Value text_;
+    std::string_view view_;  // of text_, asked for on every line parsed
 };
 
+// Insertion-ordered object storage. Keys are usually interned atoms. Up to
+// Shape::kMaxKeys fields the key list lives in a shared Shape and the object
+// itself stores only its values, in slot order: objects with the same keys
+// share one key list, and lookups can be cached per shape (see FieldCache).
+// Larger objects switch to dictionary mode with their own keys and hash index.
+// Iteration follows insertion order so documents round-trip unchanged;
+// callers sort keys when needed.
+class Object {
+    template <bool Const> class Iter;
+
+public:
+    // Iteration yields (key, value) views: the key itself lives in the shape
+    struct Entry { Key first; Value& second; };
+    struct ConstEntry { Key first; const Value& second; };
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    Object() = default;
+    explicit Object(Arena* arena) : values_(arena ? arena : std::pmr::get_default_resource()) {}
+    Object(std::initializer_list<std::pair<std::string_view, Value>> init);
+
+    // Object with a known shape; values are given in slot order
+    Object(const Shape* shape, std::vector<Value> values, Arena* arena = nullptr);
+
+    Object(const Object& other);
+    Object(Object&& other) noexcept;  // leaves other empty
+    Object& operator=(const Object& other);
+    Object& operator=(Object&& other);  // moves element-wise across arenas
+    ~Object() = default;
+
+    size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+    void reserve(size_t n) { values_.reserve(n); }
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Shared shape, or nullptr in dictionary mode
+    const Shape* shape() const { return shape_; }
+    Key key_at(size_t slot) const { return shape_ ? shape_->key(slot) : dict_->keys[slot]; }
+    const Value& value_at(size_t slot) const { return values_[slot]; }
+
+    // Lookup by atom, or by name (names that were never interned are absent)
+    iterator find(Key key);
+    const_iterator find(Key key) const;
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    bool contains(Key key) const { return find_position(key) >= 0; }
+    bool contains(std::string_view key) const {
+        Key found = Key::find(key);
+        return found && contains(found);
+    }
+    size_t count(std::string_view key) const { return contains(key) ? 1 : 0; }
+    const Value& at(std::string_view key) const;
+    Value& at(std::string_view key);
+
+    // Insert null if missing, like std::map
+    Value& operator[](Key key);
+    Value& operator[](std::string_view key) { return (*this)[Key(key)]; }
+
+    // Overwrites in place, keeping the key's original position
+    void insert_or_assign(Key key, Value value);
+    void insert_or_assign(std::string_view key, Value value) { insert_or_assign(Key(key), std::move(value)); }
+
+    // Removes a key, preserving the order of the remaining entries
+    size_t erase(std::string_view key);
+
+private:
+    // Keys and hash index of an object too large to share a shape
+    struct Dict {
+        std::vector<Key> keys;
+        std::vector<uint32_t> index;  // open-addressed slots: position + 1, 0 = empty
+    };
+
+    const Shape* shape_ = Shape::empty();
+    std::pmr::vector<Value> values_;  // copies always land on the heap
+    std::unique_ptr<Dict> dict_;
+
+    long find_position(Key key) const;
+    Value& append(Key key, Value value);
+    void to_dictionary();
+    void index_insert(uint32_t position);
+    void rebuild_index();
+};
+
+template <bool Const>
+class Object::Iter {
+public:
+    using ObjectPtr = std::conditional_t<Const, const Object*, Object*>;
+    using reference = std::conditional_t<Const, ConstEntry, Entry>;
+    using value_type = reference;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    // operator-> needs an address; the entry view lives in this holder
+    struct pointer {
+        reference entry;
+        const reference* operator->() const { return &entry; }
+    };
+
+    Iter() = default;
+    Iter(ObjectPtr obj, size_t pos) : obj_(obj), pos_(pos) {}
+    operator Iter<true>() const { return Iter<true>(obj_, pos_); }
+
+    reference operator*() const { return {obj_->key_at(pos_), obj_->values_[pos_]}; }
+    pointer operator->() const { return {**this}; }
+    Iter& operator++() { ++pos_; return *this; }
+    Iter operator++(int) { Iter old = *this; ++pos_; return old; }
+    bool operator==(const Iter& other) const { return pos_ == other.pos_ && obj_ == other.obj_; }
+    bool operator!=(const Iter& other) const { return !(*this == other); }
+    size_t position() const { return pos_; }
+
+private:
+    ObjectPtr obj_ = nullptr;
+    size_t pos_ = 0;
+};
+
+inline Object::iterator Object::begin() { return iterator(this, 0); }
+inline Object::iterator Object::end() { return iterator(this, values_.size()); }
+inline Object::const_iterator Object::begin() const { return const_iterator(this, 0); }
+inline Object::const_iterator Object::end() const { return const_iterator(this, values_.size()); }
+
 } // namespace tq
+
+template <>
+struct std::hash<tq::Value> {
+    size_t operator()(const tq::Value& value) const { return value.hash(); }
+};
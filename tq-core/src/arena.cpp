@@ -0,0 +1,33 @@
+#include "tq/arena.hpp"
+
+namespace tq {
+
+Arena::Arena(size_t initial_size) : resource_(initial_size) {}
+
+size_t Arena::bytes_used() const {
+    size_t total = bytes_used_;
+    for (const auto& fork : forks_) {
+        total += fork->bytes_used();
+    }
+    return total;
+}
+
+Arena* Arena::fork() {
+    forks_.push_back(std::make_unique<Arena>());
+    return forks_.back().get();
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    bytes_used_ += bytes;
+    return resource_.allocate(bytes, alignment);
+}
+
+void Arena::do_deallocate(void*, size_t, size_t) {
+    // Released with the arena
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+} // namespace tq
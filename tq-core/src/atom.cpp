@@ -0,0 +1,136 @@
+#include "tq/atom.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace tq {
+
+namespace {
+
+// Names live in fixed-size chunks that never move, so name() can read them
+// without taking the lock: an atom is only handed out after its chunk slot
+// has been written.
+constexpr size_t kChunkBits = 12;
+constexpr size_t kChunkSize = size_t{1} << kChunkBits;
+constexpr size_t kMaxChunks = AtomTable::kMaxCapacity >> kChunkBits;
+
+struct Table {
+    std::shared_mutex mutex;
+    std::unordered_map<std::string_view, Atom> ids;
+    std::unique_ptr<std::atomic<std::string*>[]> chunks{new std::atomic<std::string*>[kMaxChunks]()};
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> capacity{AtomTable::kMaxCapacity};
+    std::atomic<bool> overflowed{false};
+
+    ~Table() {
+        for (size_t i = 0; i < kMaxChunks; ++i) {
+            delete[] chunks[i].load();
+        }
+    }
+};
+
+Table& table() {
+    static Table instance;
+    return instance;
+}
+
+// Names this thread found recently. Atoms are never removed, so an entry
+// stays right forever, and hits skip the table's lock altogether.
+struct CachedName {
+    std::string name;
+    Atom atom = AtomTable::kNoAtom;
+};
+constexpr size_t kCachedNames = 256;
+thread_local CachedName t_cache[kCachedNames];
+
+CachedName& cached(std::string_view name) {
+    return t_cache[std::hash<std::string_view>{}(name) & (kCachedNames - 1)];
+}
+
+Atom find_cached(std::string_view name) {
+    const CachedName& entry = cached(name);
+    return entry.atom != AtomTable::kNoAtom && entry.name == name ? entry.atom : AtomTable::kNoAtom;
+}
+
+Atom remember(std::string_view name, Atom atom) {
+    CachedName& entry = cached(name);
+    entry.name.assign(name);
+    entry.atom = atom;
+    return atom;
+}
+
+} // namespace
+
+Atom AtomTable::intern(std::string_view name) {
+    Atom atom = lookup(name);
+    if (atom != kNoAtom) {
+        return atom;
+    }
+
+    Table& t = table();
+    std::unique_lock lock(t.mutex);
+    auto it = t.ids.find(name);
+    if (it != t.ids.end()) {
+        return remember(name, it->second);
+    }
+
+    size_t index = t.count.load(std::memory_order_relaxed);
+    if (index >= t.capacity.load(std::memory_order_relaxed)) {
+        t.overflowed.store(true, std::memory_order_release);
+        return kNoAtom;
+    }
+    size_t chunk = index >> kChunkBits;
+    if (!t.chunks[chunk].load(std::memory_order_relaxed)) {
+        t.chunks[chunk].store(new std::string[kChunkSize], std::memory_order_release);
+    }
+
+    std::string& slot = t.chunks[chunk].load(std::memory_order_relaxed)[index & (kChunkSize - 1)];
+    slot.assign(name);
+    atom = static_cast<Atom>(index);
+    t.ids.emplace(std::string_view(slot), atom);
+    t.count.store(index + 1, std::memory_order_release);
+    return remember(name, atom);
+}
+
+Atom AtomTable::lookup(std::string_view name) {
+    Atom atom = find_cached(name);
+    if (atom != kNoAtom) {
+        return atom;
+    }
+    Table& t = table();
+    std::shared_lock lock(t.mutex);
+    auto it = t.ids.find(name);
+    return it != t.ids.end() ? remember(name, it->second) : kNoAtom;
+}
+
+const std::string& AtomTable::name(Atom atom) {
+    Table& t = table();
+    if (atom >= t.count.load(std::memory_order_acquire)) {
+        throw std::out_of_range("Unknown atom");
+    }
+    return t.chunks[atom >> kChunkBits].load(std::memory_order_acquire)[atom & (kChunkSize - 1)];
+}
+
+size_t AtomTable::size() {
+    return table().count.load(std::memory_order_acquire);
+}
+
+void AtomTable::set_capacity(size_t names) {
+    Table& t = table();
+    std::unique_lock lock(t.mutex);
+    names = std::max(names, t.count.load(std::memory_order_relaxed));
+    if (names < t.capacity.load(std::memory_order_relaxed)) {
+        t.capacity.store(names, std::memory_order_relaxed);
+    }
+}
+
+bool AtomTable::overflowed() {
+    return table().overflowed.load(std::memory_order_acquire);
+}
+
+} // namespace tq
@@ -0,0 +1,29 @@
+#include "tq/document.hpp"
+#include "tq/evaluator.hpp"
+#include "tq/lexer.hpp"
+#include "tq/parser.hpp"
+#include "tq/toon_parser.hpp"
+
+namespace tq {
+
+Document::Document(std::string text)
+    : root_(std::make_shared<const Value>(ToonParser::parse(std::move(text)))) {}
+
+Document::Document(Value root) : root_(std::make_shared<const Value>(std::move(root))) {}
+
+Query Document::compile(const std::string& expression) {
+    Lexer lexer(expression);
+    Parser parser(lexer.tokenize());
+    return parser.parse();
+}
+
+std::vector<Value> Document::query(const std::string& expression) const {
+    return query(compile(expression));
+}
+
+std::vector<Value> Document::query(const Query& compiled) const {
+    Evaluator evaluator;
+    return evaluator.eval(compiled.root, *root_);
+}
+
+} // namespace tq
@@ -1,4 +1,5 @@
 #include "tq/evaluator.hpp"
+#include "tq/checked.hpp"
 #include "tq/toon_parser.hpp"
 #include <algorithm>
 #include <cmath>
@@ -6,9 +7,13 @@
 #include <ctime>
 #include <cstring>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 #include <cctype>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 // Platform-specific helpers for date/time functions
 #ifdef _WIN32
@@ -34,21 +39,69 @@ inline struct std::tm* safe_gmtime(const std::time_t* time, struct std::tm* resu
     return result;
 }
 #else
-// Unix has gmtime which returns a pointer
+// Unix has gmtime_r; plain gmtime shares one buffer between threads
 inline struct std::tm* safe_gmtime(const std::time_t* time, struct std::tm* result) {
-    struct std::tm* tmp = std::gmtime(time);
-    if (tmp) {
-        *result = *tmp;
-        return result;
-    }
-    return nullptr;
+    return gmtime_r(time, result);
 }
 #endif
 
 namespace tq {
 
+namespace {
+    // A size or position as a number: exact while it fits in int64
+    Value count_value(size_t n) {
+        if (n > static_cast<size_t>(std::numeric_limits<int64_t>::max())) {
+            return Value(static_cast<double>(n));
+        }
+        return Value(static_cast<int64_t>(n));
+    }
+    
+    // An array index from a number value, fractions truncated. False when
+    // it lies outside int64, where no element can be.
+    bool to_index(const Value& number, int64_t& out) {
+        if (number.is_integer()) {
+            out = number.as_integer();
+            return true;
+        }
+        double val = number.as_number();
+        if (!(val >= -9223372036854775808.0 && val < 9223372036854775808.0)) {
+            return false;
+        }
+        out = static_cast<int64_t>(val);
+        return true;
+    }
+    
+    const char* kind_of(const Value& val) {
+        if (val.is_null()) return "null";
+        if (val.is_boolean()) return "boolean";
+        if (val.is_number()) return "number";
+        if (val.is_string()) return "string";
+        if (val.is_array()) return "array";
+        return "object";
+    }
+}
+
 // Base64 encoding/decoding helpers
 namespace {
+    // Matches `.f == "s"` and `"s" == .f`, and their != forms
+    bool field_vs_string(const ExprPtr& expr, Key& key, std::string_view& literal, bool& equal) {
+        if (expr->type != ExprType::BinaryOp || (expr->op != TokenType::Equal && expr->op != TokenType::NotEqual)) {
+            return false;
+        }
+        const ExprPtr* field = &expr->left;
+        const ExprPtr* text = &expr->right;
+        if ((*field)->type != ExprType::Field) {
+            std::swap(field, text);
+        }
+        if ((*field)->type != ExprType::Field || (*text)->type != ExprType::String) {
+            return false;
+        }
+        key = (*field)->field_key;
+        literal = (*text)->str_val;
+        equal = expr->op == TokenType::Equal;
+        return true;
+    }
+
     const char* base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
     
     std::string base64_encode(const std::string& input) {
@@ -208,6 +261,9 @@ void Evaluator::register_builtins() {
     builtins_["not"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_not(args); };
     builtins_["paths"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_paths(args); };
     builtins_["leaf_paths"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_leaf_paths(args); };
+    builtins_["getpath"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_getpath(args); };
+    builtins_["setpath"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_setpath(args); };
+    builtins_["delpaths"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_delpaths(args); };
     builtins_["keys_unsorted"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_keys_unsorted(args); };
     builtins_["min_by_value"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_min_by_value(args); };
     builtins_["max_by_value"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_max_by_value(args); };
@@ -281,6 +337,12 @@ void Evaluator::register_builtins() {
     expr_builtins_["walk"] = [this](Evaluator* eval, const ExprPtr& expr, const Value& data) { 
         return this->builtin_walk(expr, data); 
     };
+    expr_builtins_["path"] = [this](Evaluator* eval, const ExprPtr& expr, const Value& data) { 
+        return this->builtin_path(expr, data); 
+    };
+    expr_builtins_["del"] = [this](Evaluator* eval, const ExprPtr& expr, const Value& data) { 
+        return this->builtin_del(expr, data); 
+    };
     
     // I/O functions
     builtins_["limit"] = [this](const std::vector<std::vector<Value>>& args) { return builtin_limit(args); };
@@ -310,7 +372,7 @@ std::vector<Value> Evaluator::eval(const ExprPtr& expr, const Value& data) {
             return {Value(expr->bool_val)};
 
         case ExprType::Number:
-            return {Value(expr->num_val)};
+            return {expr->is_integer ? Value(expr->int_val) : Value(expr->num_val)};
 
         case ExprType::String:
             return {Value(expr->str_val)};
@@ -325,6 +387,9 @@ std::vector<Value> Evaluator::eval(const ExprPtr& expr, const Value& data) {
         case ExprType::Index:
             return eval_index(expr, data);
 
+        case ExprType::DynamicIndex:
+            return eval_dynamic_index(expr, data);
+
         case ExprType::Slice:
             return eval_slice(expr, data);
 
@@ -367,11 +432,318 @@ std::vector<Value> Evaluator::eval(const ExprPtr& expr, const Value& data) {
         case ExprType::Foreach:
             return eval_foreach(expr, data);
 
+        case ExprType::Variable:
+            return eval_variable(expr);
+
+        case ExprType::Assignment:
+            return eval_assignment(expr, data);
+
         default:
             throw std::runtime_error("Unsupported expression type");
     }
 }
 
+std::vector<ValueRef> Evaluator::eval_refs(const ExprPtr& expr, const Value& data) {
+    std::vector<ValueRef> out;
+    collect_refs(expr, data, out);
+    return out;
+}
+
+namespace {
+    // Children of an array or object: borrowed, except the rows of a table,
+    // which are row references. Their fields still point into the table.
+    void child_refs(const Value& data, std::vector<ValueRef>& out) {
+        if (data.is_table()) {
+            for (size_t i = 0; i < data.array_size(); ++i) {
+                out.push_back(ValueRef::own(data.element(i)));
+            }
+        } else if (data.is_array()) {
+            for (const auto& elem : data.as_array()) {
+                out.push_back(ValueRef::borrow(elem));
+            }
+        } else if (data.is_object()) {
+            for (size_t i = 0; i < data.field_count(); ++i) {
+                out.push_back(ValueRef::borrow(data.field_value(i)));
+            }
+        }
+    }
+}
+
+void Evaluator::collect_refs(const ExprPtr& expr, const Value& data, std::vector<ValueRef>& out) {
+    if (!expr) {
+        out.push_back(ValueRef::borrow(data));
+        return;
+    }
+    
+    switch (expr->type) {
+        case ExprType::Identity:
+            out.push_back(ValueRef::borrow(data));
+            return;
+        
+        case ExprType::Field:
+        case ExprType::OptionalField: {
+            const Value* field_val = data.is_object() ? data.get(expr->field_key, expr->field_cache) : nullptr;
+            if (field_val) {
+                out.push_back(ValueRef::borrow(*field_val));
+            } else if (expr->type == ExprType::OptionalField) {
+                out.push_back(ValueRef::own(Value()));
+            }
+            return;
+        }
+        
+        case ExprType::Index: {
+            if (!data.is_array()) {
+                return;
+            }
+            int64_t size = static_cast<int64_t>(data.array_size());
+            int64_t idx = expr->index_val < 0 ? size + expr->index_val : expr->index_val;
+            if (idx < 0 || idx >= size) {
+                out.push_back(ValueRef::own(Value()));
+            } else if (data.is_table() || data.is_sequence()) {
+                out.push_back(ValueRef::own(data.element(static_cast<size_t>(idx))));
+            } else {
+                out.push_back(ValueRef::borrow(*data.get(static_cast<size_t>(idx))));
+            }
+            return;
+        }
+        
+        case ExprType::Iterator:
+            child_refs(data, out);
+            return;
+        
+        case ExprType::RecursiveDescent: {
+            out.push_back(ValueRef::borrow(data));
+            std::function<void(const Value&)> recurse = [&](const Value& val) {
+                if (val.is_table()) {
+                    for (size_t i = 0; i < val.array_size(); ++i) {
+                        Value row = val.element(i);
+                        out.push_back(ValueRef::own(row));
+                        recurse(row);
+                    }
+                    return;
+                }
+                auto visit = [&](const Value& child) {
+                    out.push_back(ValueRef::borrow(child));
+                    if (child.is_array() || child.is_object()) {
+                        recurse(child);
+                    }
+                };
+                if (val.is_array()) {
+                    for (const auto& elem : val.as_array()) {
+                        visit(elem);
+                    }
+                } else {
+                    for (size_t i = 0; i < val.field_count(); ++i) {
+                        visit(val.field_value(i));
+                    }
+                }
+            };
+            recurse(data);
+            return;
+        }
+        
+        case ExprType::Pipe: {
+            std::vector<ValueRef> left_refs;
+            collect_refs(expr->left, data, left_refs);
+            for (const auto& ref : left_refs) {
+                if (ref.borrowed()) {
+                    collect_refs(expr->right, *ref, out);
+                } else if (ref->is_row()) {
+                    // Fields of a row live in its table; only the row itself
+                    // is local to this loop
+                    size_t first = out.size();
+                    collect_refs(expr->right, *ref, out);
+                    for (size_t i = first; i < out.size(); ++i) {
+                        if (out[i].borrowed() && &*out[i] == &*ref) {
+                            out[i] = ValueRef::own(*ref);
+                        }
+                    }
+                } else {
+                    // Nothing outlives this loop to keep a computed value alive
+                    for (auto& value : eval(expr->right, *ref)) {
+                        out.push_back(ValueRef::own(std::move(value)));
+                    }
+                }
+            }
+            return;
+        }
+        
+        case ExprType::Comma:
+            collect_refs(expr->left, data, out);
+            collect_refs(expr->right, data, out);
+            return;
+        
+        default:
+            for (auto& value : eval(expr, data)) {
+                out.push_back(ValueRef::own(std::move(value)));
+            }
+            return;
+    }
+}
+
+std::vector<Value> Evaluator::eval(const ExprPtr& expr, const Tape& tape) {
+    std::vector<Value> out;
+    eval_cursor(expr, tape.root(), out);
+    return out;
+}
+
+std::vector<Value> Evaluator::eval(const ExprPtr& expr, const LazyDocument& doc) {
+    std::vector<Value> out;
+    eval_cursor(expr, doc.root(), out);
+    return out;
+}
+
+namespace {
+    // Expressions collect_cursor() can answer with positions in the document
+    bool navigates(const ExprPtr& expr) {
+        if (!expr) {
+            return true;
+        }
+        switch (expr->type) {
+            case ExprType::Identity:
+            case ExprType::Field:
+            case ExprType::OptionalField:
+            case ExprType::Index:
+            case ExprType::Iterator:
+            case ExprType::RecursiveDescent:
+                return true;
+            case ExprType::Pipe:
+            case ExprType::Comma:
+                return navigates(expr->left) && navigates(expr->right);
+            default:
+                return false;
+        }
+    }
+    
+    // The null a lookup yields when there is nothing at the position asked for
+    TapeRef null_cursor(const TapeRef&) {
+        static const Tape null_tape = [] {
+            Tape::Builder builder;
+            builder.null();
+            return builder.finish();
+        }();
+        return null_tape.root();
+    }
+    LazyRef null_cursor(const LazyRef&) {
+        return LazyRef(Value());
+    }
+}
+
+template <typename Cursor>
+void Evaluator::eval_cursor(const ExprPtr& expr, const Cursor& data, std::vector<Value>& out) {
+    if (navigates(expr)) {
+        std::vector<Cursor> refs;
+        collect_cursor(expr, data, refs);
+        out.reserve(out.size() + refs.size());
+        for (const auto& ref : refs) {
+            out.push_back(ref.to_value());
+        }
+        return;
+    }
+    
+    if (expr->type == ExprType::Pipe) {
+        if (navigates(expr->left)) {
+            std::vector<Cursor> refs;
+            collect_cursor(expr->left, data, refs);
+            for (const auto& ref : refs) {
+                eval_cursor(expr->right, ref, out);
+            }
+        } else {
+            std::vector<Value> left_values;
+            eval_cursor(expr->left, data, left_values);
+            for (const auto& value : left_values) {
+                for (auto& result : eval(expr->right, value)) {
+                    out.push_back(std::move(result));
+                }
+            }
+        }
+        return;
+    }
+    
+    if (expr->type == ExprType::Comma) {
+        eval_cursor(expr->left, data, out);
+        eval_cursor(expr->right, data, out);
+        return;
+    }
+    
+    // Containers know their size without being materialized
+    if (expr->type == ExprType::FunctionCall && expr->func_name == "length" && expr->args.empty() &&
+        (data.is_array() || data.is_object())) {
+        out.push_back(count_value(data.size()));
+        return;
+    }
+    
+    // Anything else sees its input as an ordinary Value
+    Value value = data.to_value();
+    for (auto& result : eval(expr, value)) {
+        out.push_back(std::move(result));
+    }
+}
+
+template <typename Cursor>
+void Evaluator::collect_cursor(const ExprPtr& expr, const Cursor& data, std::vector<Cursor>& out) {
+    if (!expr) {
+        out.push_back(data);
+        return;
+    }
+    
+    switch (expr->type) {
+        case ExprType::Identity:
+            out.push_back(data);
+            return;
+        
+        case ExprType::Field:
+        case ExprType::OptionalField: {
+            Cursor field_val = data.get(expr->field_key);
+            if (field_val) {
+                out.push_back(field_val);
+            } else if (expr->type == ExprType::OptionalField) {
+                out.push_back(null_cursor(data));
+            }
+            return;
+        }
+        
+        case ExprType::Index: {
+            if (!data.is_array()) {
+                return;
+            }
+            int64_t size = static_cast<int64_t>(data.size());
+            int64_t idx = expr->index_val < 0 ? size + expr->index_val : expr->index_val;
+            if (idx < 0 || idx >= size) {
+                out.push_back(null_cursor(data));
+            } else {
+                out.push_back(data.get(static_cast<size_t>(idx)));
+            }
+            return;
+        }
+        
+        case ExprType::Iterator:
+            data.children(out);
+            return;
+        
+        case ExprType::RecursiveDescent:
+            data.descendants(out);
+            return;
+        
+        case ExprType::Pipe: {
+            std::vector<Cursor> left_refs;
+            collect_cursor(expr->left, data, left_refs);
+            for (const auto& ref : left_refs) {
+                collect_cursor(expr->right, ref, out);
+            }
+            return;
+        }
+        
+        case ExprType::Comma:
+            collect_cursor(expr->left, data, out);
+            collect_cursor(expr->right, data, out);
+            return;
+        
+        default:
+            throw std::logic_error("Expression does not navigate a document");
+    }
+}
+
 std::vector<Value> Evaluator::eval_identity(const Value& data) {
     return {data};
 }
@@ -384,7 +756,7 @@ std::vector<Value> Evaluator::eval_field(const ExprPtr& expr, const Value& data)
         return {}; // Empty result for required field on non-object
     }
     
-    const Value* field_val = data.get(expr->field_name);
+    const Value* field_val = data.get(expr->field_key, expr->field_cache);
     if (field_val) {
         return {*field_val};
     }
@@ -393,7 +765,7 @@ std::vector<Value> Evaluator::eval_field(const ExprPtr& expr, const Value& data)
         return {Value()};
     }
     
-    return {Value()}; // jq returns null for missing fields
+    return {}; // Missing required field produces no output
 }
 
 std::vector<Value> Evaluator::eval_index(const ExprPtr& expr, const Value& data) {
@@ -401,43 +773,73 @@ std::vector<Value> Evaluator::eval_index(const ExprPtr& expr, const Value& data)
         return {};
     }
     
-    const auto& arr = data.as_array();
-    int idx = expr->index_val;
+    int64_t size = static_cast<int64_t>(data.array_size());
+    int64_t idx = expr->index_val;
     
     // Handle negative indices
     if (idx < 0) {
-        idx = static_cast<int>(arr.size()) + idx;
+        idx = size + idx;
     }
     
-    if (idx >= 0 && idx < static_cast<int>(arr.size())) {
-        return {arr[idx]};
+    if (idx >= 0 && idx < size) {
+        return {data.element(static_cast<size_t>(idx))};
     }
     
     return {Value()}; // Out of bounds returns null
 }
 
+std::vector<Value> Evaluator::eval_dynamic_index(const ExprPtr& expr, const Value& data) {
+    std::vector<Value> keys = eval(expr->operand, data);
+    std::vector<Value> result;
+    for (const auto& base : eval(expr->left, data)) {
+        for (const auto& key : keys) {
+            // A name reads like .name, a number like .[n]
+            if (key.is_string()) {
+                const Value* field = base.is_object() ? base.get(key.as_string()) : nullptr;
+                if (field) {
+                    result.push_back(*field);
+                }
+            } else if (key.is_number()) {
+                if (!base.is_array()) {
+                    continue;
+                }
+                int64_t size = static_cast<int64_t>(base.array_size());
+                int64_t idx = 0;
+                bool valid = to_index(key, idx);
+                if (idx < 0) {
+                    idx = size + idx;
+                }
+                result.push_back(valid && idx >= 0 && idx < size ? base.element(static_cast<size_t>(idx)) : Value());
+            } else {
+                throw std::runtime_error(std::string("Cannot index ") + kind_of(base) + " with " + kind_of(key));
+            }
+        }
+    }
+    return result;
+}
+
 std::vector<Value> Evaluator::eval_slice(const ExprPtr& expr, const Value& data) {
     if (!data.is_array()) {
         return {};
     }
     
-    const auto& arr = data.as_array();
-    int size = static_cast<int>(arr.size());
+    int64_t size = static_cast<int64_t>(data.array_size());
     
-    int start = expr->slice_start;
+    int64_t start = expr->slice_start;
     if (start < 0) start = size + start;
     if (start < 0) start = 0;
     if (start > size) start = size;
     
-    int end = expr->has_slice_end ? expr->slice_end : size;
+    int64_t end = expr->has_slice_end ? expr->slice_end : size;
     if (end < 0) end = size + end;
     if (end < 0) end = 0;
     if (end > size) end = size;
     if (end < start) end = start;
     
     std::vector<Value> result_arr;
-    for (int i = start; i < end; ++i) {
-        result_arr.push_back(arr[i]);
+    result_arr.reserve(static_cast<size_t>(end - start));
+    for (int64_t i = start; i < end; ++i) {
+        result_arr.push_back(data.element(static_cast<size_t>(i)));
     }
     
     return {Value(std::move(result_arr))};
@@ -446,13 +848,18 @@ std::vector<Value> Evaluator::eval_slice(const ExprPtr& expr, const Value& data)
 std::vector<Value> Evaluator::eval_iterator(const Value& data) {
     std::vector<Value> results;
     
+    // Element copies share their container storage, so this is O(n) in
+    // the number of elements regardless of how large each element is.
+    // Tables yield row references instead of materialized row objects.
     if (data.is_array()) {
-        const auto& arr = data.as_array();
-        for (const auto& elem : arr) {
-            results.push_back(elem);
+        size_t size = data.array_size();
+        results.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            results.push_back(data.element(i));
         }
     } else if (data.is_object()) {
         const auto& obj = data.as_object();
+        results.reserve(obj.size());
         for (const auto& [key, val] : obj) {
             results.push_back(val);
         }
@@ -485,6 +892,69 @@ std::vector<Value> Evaluator::eval_recursive_descent(const Value& data) {
 }
 
 std::vector<Value> Evaluator::eval_pipe(const ExprPtr& expr, const Value& data) {
+    bool over_elements = expr->left->type == ExprType::Iterator ||
+                         (expr->left->type == ExprType::Pipe && expr->left->right->type == ExprType::Iterator);
+    auto element_sources = [&]() {
+        return expr->left->type == ExprType::Iterator ? std::vector<Value>{data} : eval(expr->left->left, data);
+    };
+    
+    // `source[] | .field` over a table is a copy of one column
+    bool field_of_elements = over_elements &&
+                             (expr->right->type == ExprType::Field || expr->right->type == ExprType::OptionalField);
+    if (field_of_elements) {
+        std::vector<Value> sources = element_sources();
+        
+        std::vector<Value> final_results;
+        for (const auto& source : sources) {
+            if (const auto* column = source.column(expr->right->field_key)) {
+                std::vector<Value> values = column->values();
+                final_results.insert(final_results.end(),
+                                     std::make_move_iterator(values.begin()),
+                                     std::make_move_iterator(values.end()));
+                continue;
+            }
+            for (const auto& elem : eval_iterator(source)) {
+                std::vector<Value> right_results = eval_field(expr->right, elem);
+                final_results.insert(final_results.end(),
+                                     std::make_move_iterator(right_results.begin()),
+                                     std::make_move_iterator(right_results.end()));
+            }
+        }
+        return final_results;
+    }
+    
+    // `source[] | select(.field == "s")` over a dictionary-encoded column
+    // compares one-byte row codes instead of strings
+    Key select_key;
+    std::string_view literal;
+    bool equal = true;
+    bool select_of_elements = over_elements && expr->right->type == ExprType::FunctionCall &&
+                              expr->right->func_name == "select" && expr->right->args.size() == 1 &&
+                              field_vs_string(expr->right->args[0], select_key, literal, equal);
+    if (select_of_elements) {
+        std::vector<Value> final_results;
+        for (const auto& source : element_sources()) {
+            const Column* column = source.column(select_key);
+            if (column && column->encoded()) {
+                int code = column->code_of(literal);
+                const auto& codes = column->codes();
+                for (size_t row = 0; row < codes.size(); ++row) {
+                    if ((codes[row] == code) == equal) {
+                        final_results.push_back(source.element(row));
+                    }
+                }
+                continue;
+            }
+            for (const auto& elem : eval_iterator(source)) {
+                std::vector<Value> right_results = eval(expr->right, elem);
+                final_results.insert(final_results.end(),
+                                     std::make_move_iterator(right_results.begin()),
+                                     std::make_move_iterator(right_results.end()));
+            }
+        }
+        return final_results;
+    }
+    
     // Evaluate left side first
     std::vector<Value> left_results = eval(expr->left, data);
     
@@ -492,7 +962,9 @@ std::vector<Value> Evaluator::eval_pipe(const ExprPtr& expr, const Value& data)
     std::vector<Value> final_results;
     for (const auto& val : left_results) {
         std::vector<Value> right_results = eval(expr->right, val);
-        final_results.insert(final_results.end(), right_results.begin(), right_results.end());
+        final_results.insert(final_results.end(),
+                             std::make_move_iterator(right_results.begin()),
+                             std::make_move_iterator(right_results.end()));
     }
     
     return final_results;
@@ -500,13 +972,12 @@ std::vector<Value> Evaluator::eval_pipe(const ExprPtr& expr, const Value& data)
 
 std::vector<Value> Evaluator::eval_comma(const ExprPtr& expr, const Value& data) {
     // Comma produces multiple outputs
-    std::vector<Value> results;
-    
-    std::vector<Value> left_results = eval(expr->left, data);
-    results.insert(results.end(), left_results.begin(), left_results.end());
+    std::vector<Value> results = eval(expr->left, data);
     
     std::vector<Value> right_results = eval(expr->right, data);
-    results.insert(results.end(), right_results.begin(), right_results.end());
+    results.insert(results.end(),
+                   std::make_move_iterator(right_results.begin()),
+                   std::make_move_iterator(right_results.end()));
     
     return results;
 }
@@ -515,6 +986,11 @@ std::vector<Value> Evaluator::eval_binary_op(const ExprPtr& expr, const Value& d
     std::vector<Value> left_results = eval(expr->left, data);
     std::vector<Value> right_results = eval(expr->right, data);
     
+    // Alternative falls through to the right side when the left produces nothing
+    if (expr->op == TokenType::Alternative && left_results.empty()) {
+        return right_results;
+    }
+    
     if (left_results.empty() || right_results.empty()) {
         return {};
     }
@@ -576,6 +1052,9 @@ std::vector<Value> Evaluator::eval_unary_op(const ExprPtr& expr, const Value& da
     }
     
     if (expr->op == TokenType::Minus) {
+        if (operand_val.is_integer() && operand_val.as_integer() != INT64_MIN) {
+            return {Value(-operand_val.as_integer())};
+        }
         if (operand_val.is_number()) {
             return {Value(-operand_val.as_number())};
         }
@@ -629,6 +1108,12 @@ std::vector<Value> Evaluator::eval_function_call(const ExprPtr& expr, const Valu
         return expr_it->second(this, expr->args[0], data);
     }
     
+    // first(f), last(f) and limit(n; f) pick from the outputs of f
+    if ((expr->args.size() == 1 && (expr->func_name == "first" || expr->func_name == "last")) ||
+        (expr->args.size() == 2 && expr->func_name == "limit")) {
+        return eval_generator_call(expr, data);
+    }
+    
     // Regular value-based built-ins
     auto it = builtins_.find(expr->func_name);
     if (it == builtins_.end()) {
@@ -649,40 +1134,648 @@ std::vector<Value> Evaluator::eval_function_call(const ExprPtr& expr, const Valu
     return it->second(arg_results);
 }
 
+std::vector<Value> Evaluator::eval_generator_call(const ExprPtr& expr, const Value& data) {
+    // Outputs of a range are computed from their index, so first, last and
+    // limit never run it
+    Value outputs;
+    if (!eval_range(expr->args.back(), data, outputs)) {
+        outputs = Value(eval(expr->args.back(), data));
+    }
+    size_t n = outputs.array_size();
+    
+    if (expr->func_name == "first") {
+        return n ? std::vector<Value>{outputs.element(0)} : std::vector<Value>{};
+    }
+    if (expr->func_name == "last") {
+        return n ? std::vector<Value>{outputs.element(n - 1)} : std::vector<Value>{};
+    }
+    
+    std::vector<Value> counts = eval(expr->args[0], data);
+    if (counts.empty() || !counts[0].is_number()) {
+        throw std::runtime_error("limit: count must be a number");
+    }
+    double count = counts[0].as_number();
+    size_t take = count <= 0 ? 0 : count >= static_cast<double>(n) ? n : static_cast<size_t>(count);
+    std::vector<Value> result;
+    result.reserve(take);
+    for (size_t i = 0; i < take; ++i) {
+        result.push_back(outputs.element(i));
+    }
+    return result;
+}
+
+namespace {
+    // Integral and within int64_t, so a range over it can be computed exactly
+    bool integral(const Value& v) {
+        if (v.is_integer()) {
+            return true;
+        }
+        double d = v.as_number();
+        return std::trunc(d) == d && d >= -9.2e18 && d <= 9.2e18;
+    }
+    
+    // Evaluates to the same single value whatever its input
+    bool is_literal(const ExprPtr& expr) {
+        return expr->type == ExprType::Null || expr->type == ExprType::Boolean ||
+               expr->type == ExprType::Number || expr->type == ExprType::String;
+    }
+}
+
+bool Evaluator::eval_range(const ExprPtr& expr, const Value& data, Value& out) {
+    if (expr->type != ExprType::FunctionCall || expr->func_name != "range" ||
+        expr->args.empty() || expr->args.size() > 3) {
+        return false;
+    }
+    
+    // Only the common case of one integer per argument; anything else is
+    // left to builtin_range
+    int64_t bounds[3];
+    for (size_t i = 0; i < expr->args.size(); ++i) {
+        std::vector<Value> arg = eval(expr->args[i], data);
+        if (arg.size() != 1 || !arg[0].is_number() || !integral(arg[0])) {
+            return false;
+        }
+        bounds[i] = arg[0].is_integer() ? arg[0].as_integer() : static_cast<int64_t>(arg[0].as_number());
+    }
+    
+    if (expr->args.size() == 1) {
+        out = Value::range(0, bounds[0]);
+        return true;
+    }
+    int64_t step = expr->args.size() == 3 ? bounds[2] : 1;
+    if (step == 0) {
+        throw std::runtime_error("range step must not be 0");
+    }
+    out = Value::range(bounds[0], bounds[1], step);
+    return true;
+}
+
 std::vector<Value> Evaluator::eval_array_literal(const ExprPtr& expr, const Value& data) {
-    std::vector<Value> result_arr;
+    // [range(...)] and [range(...) | <constant>] stay virtual: their elements
+    // are computed on access, so building one costs O(1) whatever its length
+    if (expr->array_elements.size() == 1) {
+        const ExprPtr& elem = expr->array_elements[0];
+        Value seq;
+        if (eval_range(elem, data, seq)) {
+            return {std::move(seq)};
+        }
+        if (elem->type == ExprType::Pipe && is_literal(elem->right) && eval_range(elem->left, data, seq)) {
+            std::vector<Value> item = eval(elem->right, data);
+            return {Value::repeat(std::move(item[0]), seq.array_size())};
+        }
+    }
     
+    // Every output of every element, in order
+    std::vector<Value> result_arr;
     for (const auto& elem_expr : expr->array_elements) {
         std::vector<Value> elem_results = eval(elem_expr, data);
-        // For array literals, take first result of each element
-        if (!elem_results.empty()) {
-            result_arr.push_back(elem_results[0]);
-        }
+        result_arr.insert(result_arr.end(),
+                          std::make_move_iterator(elem_results.begin()),
+                          std::make_move_iterator(elem_results.end()));
     }
     
     return {Value(std::move(result_arr))};
 }
 
 std::vector<Value> Evaluator::eval_object_literal(const ExprPtr& expr, const Value& data) {
-    std::map<std::string, Value> result_obj;
+    Object result_obj;
+    result_obj.reserve(expr->object_fields.size());
     
     for (const auto& [key, val_expr] : expr->object_fields) {
         std::vector<Value> val_results = eval(val_expr, data);
         if (!val_results.empty()) {
-            result_obj[key] = val_results[0];
+            result_obj.insert_or_assign(key, std::move(val_results[0]));
         }
     }
     
     return {Value(std::move(result_obj))};
 }
 
+namespace {
+    // Binds a variable for the lifetime of the scope, restoring any outer binding
+    class VarScope {
+    public:
+        VarScope(std::map<std::string, Value>& vars, const std::string& name) : vars_(vars), name_(name) {
+            auto it = vars_.find(name_);
+            if (it != vars_.end()) {
+                outer_ = std::move(it->second);
+                had_outer_ = true;
+            }
+        }
+        ~VarScope() {
+            if (had_outer_) {
+                vars_[name_] = std::move(outer_);
+            } else {
+                vars_.erase(name_);
+            }
+        }
+        void set(Value value) { vars_[name_] = std::move(value); }
+        
+    private:
+        std::map<std::string, Value>& vars_;
+        const std::string& name_;
+        Value outer_;
+        bool had_outer_ = false;
+    };
+}
+
 std::vector<Value> Evaluator::eval_reduce(const ExprPtr& expr, const Value& data) {
-    // Simplified reduce - full implementation would handle variables properly
-    throw std::runtime_error("reduce not yet implemented");
+    std::vector<Value> init = eval(expr->init_expr, data);
+    if (init.empty()) {
+        return {};
+    }
+    
+    Value acc = std::move(init.back());
+    VarScope var(vars_, expr->var_name);
+    // reduce range(...) as $i walks the range without building its outputs
+    Value seq;
+    if (eval_range(expr->reduce_iter_expr, data, seq)) {
+        for (size_t i = 0, n = seq.array_size(); i < n; ++i) {
+            var.set(seq.element(i));
+            acc = reduce_step(expr->update_expr, std::move(acc));
+        }
+        return {std::move(acc)};
+    }
+    for (auto& item : eval(expr->reduce_iter_expr, data)) {
+        var.set(std::move(item));
+        acc = reduce_step(expr->update_expr, std::move(acc));
+    }
+    return {std::move(acc)};
 }
 
 std::vector<Value> Evaluator::eval_foreach(const ExprPtr& expr, const Value& data) {
-    throw std::runtime_error("foreach not yet implemented");
+    std::vector<Value> init = eval(expr->init_expr, data);
+    if (init.empty()) {
+        return {};
+    }
+    
+    Value acc = std::move(init.back());
+    std::vector<Value> results;
+    VarScope var(vars_, expr->var_name);
+    for (auto& item : eval(expr->reduce_iter_expr, data)) {
+        var.set(std::move(item));
+        acc = reduce_step(expr->update_expr, std::move(acc));
+        // Each state is emitted as a snapshot, which an array accumulator can
+        // keep appending past; a plain copy would make the next step clone it
+        Value state = acc.snapshot();
+        if (expr->extract_expr) {
+            std::vector<Value> extracted = eval(expr->extract_expr, state);
+            results.insert(results.end(),
+                           std::make_move_iterator(extracted.begin()),
+                           std::make_move_iterator(extracted.end()));
+        } else {
+            results.push_back(std::move(state));
+        }
+    }
+    return results;
+}
+
+Value Evaluator::reduce_step(const ExprPtr& update, Value acc) {
+    // `. + x` on an array or object accumulator appends in place. acc is the
+    // only reference to its node after the first step (foreach outputs of an
+    // array are snapshots, which do not count), so copy-on-write leaves it
+    // alone and building an N-element result costs O(N), not O(N^2). If
+    // anything else still shares the node (the input document, x itself, an
+    // object foreach output), it is cloned first and that copy stays
+    // unchanged.
+    bool appends = update->type == ExprType::BinaryOp && update->op == TokenType::Plus &&
+                   update->left->type == ExprType::Identity;
+    if (appends && (acc.is_array() || acc.is_object())) {
+        std::vector<Value> rhs = eval(update->right, acc);
+        if (rhs.size() == 1 && rhs[0].type() == acc.type()) {
+            if (acc.is_array()) {
+                acc.append(rhs[0].as_array());
+            } else {
+                auto& fields = acc.as_object();
+                for (const auto& [key, value] : rhs[0].as_object()) {
+                    fields.insert_or_assign(key, value);
+                }
+            }
+            return acc;
+        }
+        Value last;
+        for (const auto& r : rhs) {
+            last = apply_arithmetic(TokenType::Plus, acc, r);
+        }
+        return last;
+    }
+    
+    // Assignments, setpath, delpaths and del update the accumulator they are
+    // handed in place
+    if (update->type == ExprType::Assignment) {
+        std::vector<Value> results = eval_assignment(update, std::move(acc));
+        return results.empty() ? Value() : std::move(results.back());
+    }
+    if (update->type == ExprType::FunctionCall &&
+        ((update->func_name == "setpath" && update->args.size() == 2) ||
+         ((update->func_name == "delpaths" || update->func_name == "del") && update->args.size() == 1))) {
+        std::vector<Value> results = eval_path_update(update, std::move(acc));
+        return results.empty() ? Value() : std::move(results.back());
+    }
+    
+    // jq keeps the last output of the update; no output leaves null
+    std::vector<Value> results = eval(update, acc);
+    return results.empty() ? Value() : std::move(results.back());
+}
+
+std::vector<Value> Evaluator::eval_variable(const ExprPtr& expr) {
+    auto it = vars_.find(expr->var_name);
+    if (it == vars_.end()) {
+        throw std::runtime_error("$" + expr->var_name + " is not defined");
+    }
+    return {it->second};
+}
+
+namespace {
+    // jq's limit on how far an assignment may grow an array
+    constexpr int64_t kMaxPathIndex = 536870911;
+    
+    // Array position of a path step, negative steps counting from the end;
+    // -1 if it lies before the start
+    int64_t path_index(const Value& step, size_t size) {
+        int64_t index = step.is_integer() ? step.as_integer() : static_cast<int64_t>(std::floor(step.as_number()));
+        if (index < 0) {
+            index += static_cast<int64_t>(size);
+        }
+        return index < 0 ? -1 : index;
+    }
+    
+    // Value at path, or null where it does not exist
+    Value get_path(const Value& root, const std::vector<Value>& path) {
+        Value current = root;
+        for (const auto& step : path) {
+            if (current.is_null()) {
+                return current;
+            }
+            if (step.is_string() && current.is_object()) {
+                const Value* field = std::as_const(current).get(step.as_string());
+                current = field ? *field : Value();
+            } else if (step.is_number() && current.is_array()) {
+                int64_t index = path_index(step, current.array_size());
+                current = index >= 0 && static_cast<size_t>(index) < current.array_size()
+                              ? current.element(static_cast<size_t>(index)) : Value();
+            } else {
+                throw std::runtime_error(std::string("Cannot index ") + kind_of(current) + " with " + kind_of(step));
+            }
+        }
+        return current;
+    }
+    
+    // Replaces the value at path, creating objects, arrays and null padding on
+    // the way. Copy-on-write clones only the containers along the path that
+    // are still shared.
+    void set_path(Value& root, const std::vector<Value>& path, Value value) {
+        Value* slot = &root;
+        for (const auto& step : path) {
+            if (step.is_string()) {
+                if (slot->is_null()) {
+                    *slot = Value(Object());
+                } else if (!slot->is_object()) {
+                    throw std::runtime_error(std::string("Cannot index ") + kind_of(*slot) + " with \"" +
+                                             step.as_string() + "\"");
+                }
+                slot = &slot->as_object()[step.as_string_view()];
+            } else if (step.is_number()) {
+                if (slot->is_null()) {
+                    *slot = Value(std::vector<Value>{});
+                } else if (!slot->is_array()) {
+                    throw std::runtime_error(std::string("Cannot index ") + kind_of(*slot) + " with number");
+                }
+                auto& items = slot->as_array();
+                int64_t index = path_index(step, items.size());
+                if (index < 0) {
+                    throw std::runtime_error("Out of bounds negative array index");
+                }
+                if (index > kMaxPathIndex) {
+                    throw std::runtime_error("Array index too large");
+                }
+                if (static_cast<size_t>(index) >= items.size()) {
+                    items.resize(static_cast<size_t>(index) + 1);
+                }
+                slot = &items[static_cast<size_t>(index)];
+            } else {
+                throw std::runtime_error(std::string("Invalid path component: ") + kind_of(step));
+            }
+        }
+        *slot = std::move(value);
+    }
+    
+    void delete_path(Value& current, const std::vector<Value>& path, size_t depth) {
+        if (current.is_null()) {
+            return;
+        }
+        const Value& step = path[depth];
+        if (step.is_string() && current.is_object()) {
+            if (depth + 1 == path.size()) {
+                current.as_object().erase(step.as_string_view());
+            } else if (std::as_const(current).get(step.as_string())) {
+                delete_path(current.as_object().at(step.as_string_view()), path, depth + 1);
+            }
+        } else if (step.is_number() && current.is_array()) {
+            int64_t index = path_index(step, current.array_size());
+            if (index < 0 || static_cast<size_t>(index) >= current.array_size()) {
+                return;
+            }
+            auto& items = current.as_array();
+            if (depth + 1 == path.size()) {
+                items.erase(items.begin() + index);
+            } else {
+                delete_path(items[static_cast<size_t>(index)], path, depth + 1);
+            }
+        } else {
+            throw std::runtime_error(std::string("Cannot delete ") + kind_of(step) + " field of " + kind_of(current));
+        }
+    }
+    
+    // Steps of a path argument to getpath or setpath
+    const std::vector<Value>& path_steps(const Value& path) {
+        if (!path.is_array()) {
+            throw std::runtime_error("Path must be specified as an array");
+        }
+        return path.as_array();
+    }
+    
+    // Paths of a delpaths argument
+    const std::vector<Value>& path_list(const Value& paths) {
+        if (!paths.is_array()) {
+            throw std::runtime_error("Paths must be specified as an array");
+        }
+        for (const auto& path : paths.as_array()) {
+            path_steps(path);
+        }
+        return paths.as_array();
+    }
+    
+    // Deletes the deepest and last paths first, so earlier array positions
+    // still point where they did
+    void delete_paths(Value& root, std::vector<Value> paths) {
+        std::sort(paths.begin(), paths.end(), [](const Value& a, const Value& b) { return a.compare(b) > 0; });
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+        for (const auto& path : paths) {
+            const auto& steps = path.as_array();
+            if (steps.empty()) {
+                root = Value();
+                continue;
+            }
+            delete_path(root, steps, 0);
+        }
+    }
+}
+
+void Evaluator::collect_paths(const ExprPtr& expr, const Value& data, std::vector<Value>& prefix,
+                              std::vector<PathEntry>& out) {
+    // `?` after an expression: where it fails, it has no paths
+    if (expr->optional) {
+        auto required = std::make_shared<Expr>(*expr);
+        required->optional = false;
+        size_t start = out.size();
+        try {
+            collect_paths(required, data, prefix, out);
+        } catch (const std::runtime_error&) {
+            out.resize(start);
+        }
+        return;
+    }
+    
+    auto emit = [&](Value step, Value value) {
+        prefix.push_back(std::move(step));
+        out.emplace_back(prefix, std::move(value));
+        prefix.pop_back();
+    };
+    
+    switch (expr->type) {
+        case ExprType::Identity:
+            out.emplace_back(prefix, data);
+            return;
+            
+        case ExprType::Field:
+        case ExprType::OptionalField: {
+            // Unlike reading, a missing field is still a place to assign to
+            if (data.is_null()) {
+                emit(Value(expr->field_name), Value());
+            } else if (data.is_object()) {
+                const Value* field = data.get(expr->field_key, expr->field_cache);
+                emit(Value(expr->field_name), field ? *field : Value());
+            } else if (expr->type == ExprType::Field) {
+                throw std::runtime_error(std::string("Cannot index ") + kind_of(data) + " with \"" +
+                                         expr->field_name + "\"");
+            }
+            return;
+        }
+            
+        case ExprType::Index: {
+            if (data.is_null()) {
+                emit(Value(expr->index_val), Value());
+            } else if (data.is_array()) {
+                std::vector<Value> found = eval_index(expr, data);
+                emit(Value(expr->index_val), found.empty() ? Value() : std::move(found[0]));
+            } else {
+                throw std::runtime_error(std::string("Cannot index ") + kind_of(data) + " with number");
+            }
+            return;
+        }
+            
+        case ExprType::DynamicIndex: {
+            std::vector<Value> keys = eval(expr->operand, data);
+            std::vector<PathEntry> bases;
+            collect_paths(expr->left, data, prefix, bases);
+            for (auto& [path, base] : bases) {
+                for (const auto& key : keys) {
+                    Value found = get_path(base, {key});
+                    path.push_back(key);
+                    out.emplace_back(path, std::move(found));
+                    path.pop_back();
+                }
+            }
+            return;
+        }
+            
+        case ExprType::Iterator:
+            if (data.is_array()) {
+                for (size_t i = 0; i < data.array_size(); ++i) {
+                    emit(Value(static_cast<int64_t>(i)), data.element(i));
+                }
+            } else if (data.is_object()) {
+                for (size_t i = 0; i < data.field_count(); ++i) {
+                    emit(Value(data.field_key(i).str()), data.field_value(i));
+                }
+            } else if (!data.is_null()) {
+                throw std::runtime_error(std::string("Cannot iterate over ") + kind_of(data));
+            }
+            return;
+            
+        case ExprType::RecursiveDescent: {
+            out.emplace_back(prefix, data);
+            if (!data.is_array() && !data.is_object()) {
+                return;
+            }
+            std::vector<PathEntry> children;
+            collect_paths(std::make_shared<Expr>(ExprType::Iterator), data, prefix, children);
+            for (auto& [path, child] : children) {
+                std::vector<Value> child_prefix = path;
+                collect_paths(expr, child, child_prefix, out);
+            }
+            return;
+        }
+            
+        case ExprType::Pipe: {
+            std::vector<PathEntry> left;
+            collect_paths(expr->left, data, prefix, left);
+            for (auto& [path, value] : left) {
+                collect_paths(expr->right, value, path, out);
+            }
+            return;
+        }
+            
+        case ExprType::Comma:
+            collect_paths(expr->left, data, prefix, out);
+            collect_paths(expr->right, data, prefix, out);
+            return;
+            
+        case ExprType::If: {
+            std::vector<Value> cond = eval(expr->condition, data);
+            if (!cond.empty() && is_truthy(cond[0])) {
+                collect_paths(expr->then_branch, data, prefix, out);
+                return;
+            }
+            for (const auto& [elif_cond, elif_body] : expr->elif_branches) {
+                std::vector<Value> elif_results = eval(elif_cond, data);
+                if (!elif_results.empty() && is_truthy(elif_results[0])) {
+                    collect_paths(elif_body, data, prefix, out);
+                    return;
+                }
+            }
+            if (expr->else_branch) {
+                collect_paths(expr->else_branch, data, prefix, out);
+            } else {
+                out.emplace_back(prefix, data);
+            }
+            return;
+        }
+            
+        case ExprType::Try: {
+            // .a.b? over a number has no paths rather than failing
+            size_t start = out.size();
+            try {
+                collect_paths(expr->left, data, prefix, out);
+            } catch (const std::runtime_error&) {
+                out.resize(start);
+            }
+            return;
+        }
+            
+        case ExprType::BinaryOp:
+            if (expr->op == TokenType::Alternative) {
+                // Paths of the left side whose values are truthy, else the right side's
+                size_t start = out.size();
+                collect_paths(expr->left, data, prefix, out);
+                out.erase(std::remove_if(out.begin() + start, out.end(),
+                                         [this](const PathEntry& entry) { return !is_truthy(entry.second); }),
+                          out.end());
+                if (out.size() == start) {
+                    collect_paths(expr->right, data, prefix, out);
+                }
+                return;
+            }
+            break;
+            
+        case ExprType::FunctionCall: {
+            const std::string& name = expr->func_name;
+            if (name == "empty" && expr->args.empty()) {
+                return;
+            }
+            if (name == "select" && expr->args.size() == 1) {
+                std::vector<Value> cond = eval(expr->args[0], data);
+                if (!cond.empty() && is_truthy(cond[0])) {
+                    out.emplace_back(prefix, data);
+                }
+                return;
+            }
+            if ((name == "first" || name == "last") && expr->args.size() == 1) {
+                std::vector<PathEntry> all;
+                collect_paths(expr->args[0], data, prefix, all);
+                if (!all.empty()) {
+                    out.push_back(std::move(name == "first" ? all.front() : all.back()));
+                }
+                return;
+            }
+            if (name == "recurse" && expr->args.empty()) {
+                collect_paths(Expr::recursive_descent_expr(), data, prefix, out);
+                return;
+            }
+            if (name == "getpath" && expr->args.size() == 1) {
+                for (const auto& path : eval(expr->args[0], data)) {
+                    if (!path.is_array()) {
+                        throw std::runtime_error("Path must be specified as an array");
+                    }
+                    std::vector<Value> full = prefix;
+                    full.insert(full.end(), path.as_array().begin(), path.as_array().end());
+                    out.emplace_back(std::move(full), get_path(data, path.as_array()));
+                }
+                return;
+            }
+            break;
+        }
+            
+        default:
+            break;
+    }
+    throw std::runtime_error("Invalid path expression");
+}
+
+std::vector<Value> Evaluator::eval_assignment(const ExprPtr& expr, Value data) {
+    std::vector<PathEntry> paths;
+    std::vector<Value> prefix;
+    collect_paths(expr->left, data, prefix, paths);
+    // Values are read again from the result as it changes; holding on to
+    // these would make every container on the way look shared
+    for (auto& entry : paths) {
+        entry.second = Value();
+    }
+    
+    // lhs |= f: each path gets the first output of f on its current value;
+    // a path f yields nothing for is deleted
+    if (expr->op == TokenType::UpdateAssign) {
+        Value result = std::move(data);
+        std::vector<Value> removed;
+        for (auto& entry : paths) {
+            std::vector<Value> updated = eval(expr->right, get_path(result, entry.first));
+            if (updated.empty()) {
+                removed.push_back(Value(std::move(entry.first)));
+            } else {
+                set_path(result, entry.first, std::move(updated[0]));
+            }
+        }
+        if (!removed.empty()) {
+            delete_paths(result, std::move(removed));
+        }
+        return {result};
+    }
+    
+    // lhs = rhs and lhs op= rhs: rhs runs on the original input, and every
+    // one of its outputs gives one result
+    std::vector<Value> values = eval(expr->right, data);
+    std::vector<Value> results;
+    for (size_t i = 0; i < values.size(); ++i) {
+        const Value& rhs = values[i];
+        Value result = i + 1 == values.size() ? std::move(data) : data;
+        for (const auto& entry : paths) {
+            Value current = get_path(result, entry.first);
+            Value updated;
+            switch (expr->op) {
+                case TokenType::Assign: updated = rhs; break;
+                case TokenType::PlusAssign: updated = apply_arithmetic(TokenType::Plus, current, rhs); break;
+                case TokenType::MinusAssign: updated = apply_arithmetic(TokenType::Minus, current, rhs); break;
+                case TokenType::StarAssign: updated = apply_arithmetic(TokenType::Star, current, rhs); break;
+                case TokenType::SlashAssign: updated = apply_arithmetic(TokenType::Slash, current, rhs); break;
+                case TokenType::AltAssign: updated = is_truthy(current) ? current : rhs; break;
+                default: throw std::runtime_error("Unknown assignment operator");
+            }
+            set_path(result, entry.first, std::move(updated));
+        }
+        results.push_back(std::move(result));
+    }
+    return results;
 }
 
 // Helper functions
@@ -696,8 +1789,16 @@ bool Evaluator::is_truthy(const Value& val) {
 Value Evaluator::apply_arithmetic(TokenType op, const Value& left, const Value& right) {
     // String concatenation for +
     if (op == TokenType::Plus) {
+        // null is the identity of +
+        if (left.is_null()) return right;
+        if (right.is_null()) return left;
         if (left.is_string() && right.is_string()) {
-            return Value(left.as_string() + right.as_string());
+            std::string_view l = left.as_string_view();
+            std::string_view r = right.as_string_view();
+            std::string joined;
+            joined.reserve(l.size() + r.size());
+            joined.append(l).append(r);
+            return Value(std::move(joined));
         }
         if (left.is_array() && right.is_array()) {
             std::vector<Value> result = left.as_array();
@@ -705,6 +1806,14 @@ Value Evaluator::apply_arithmetic(TokenType op, const Value& left, const Value&
             result.insert(result.end(), right_arr.begin(), right_arr.end());
             return Value(std::move(result));
         }
+        if (left.is_object() && right.is_object()) {
+            // Shallow merge; fields of the right side win
+            Object result = left.as_object();
+            for (const auto& [key, value] : right.as_object()) {
+                result.insert_or_assign(key, value);
+            }
+            return Value(std::move(result));
+        }
     }
     
     // Numeric operations
@@ -712,6 +1821,29 @@ Value Evaluator::apply_arithmetic(TokenType op, const Value& left, const Value&
         throw std::runtime_error("Arithmetic operation on non-numbers");
     }
     
+    // Integer fast path; falls through to double on overflow and for division
+    if (left.is_integer() && right.is_integer()) {
+        int64_t a = left.as_integer();
+        int64_t b = right.as_integer();
+        int64_t out = 0;
+        switch (op) {
+            case TokenType::Plus:
+                if (!checked::add(a, b, out)) return Value(out);
+                break;
+            case TokenType::Minus:
+                if (!checked::sub(a, b, out)) return Value(out);
+                break;
+            case TokenType::Star:
+                if (!checked::mul(a, b, out)) return Value(out);
+                break;
+            case TokenType::Percent:
+                if (b == 0) throw std::runtime_error("Modulo by zero");
+                return Value(b == -1 ? int64_t{0} : a % b);
+            default:
+                break;
+        }
+    }
+    
     double l = left.as_number();
     double r = right.as_number();
     
@@ -731,11 +1863,12 @@ Value Evaluator::apply_arithmetic(TokenType op, const Value& left, const Value&
 }
 
 bool Evaluator::apply_comparison(TokenType op, const Value& left, const Value& right) {
+    if (op == TokenType::Equal) return left.equals(right);
+    if (op == TokenType::NotEqual) return !left.equals(right);
+    
     int cmp = compare_values(left, right);
     
     switch (op) {
-        case TokenType::Equal: return cmp == 0;
-        case TokenType::NotEqual: return cmp != 0;
         case TokenType::Less: return cmp < 0;
         case TokenType::LessEqual: return cmp <= 0;
         case TokenType::Greater: return cmp > 0;
@@ -746,35 +1879,7 @@ bool Evaluator::apply_comparison(TokenType op, const Value& left, const Value& r
 }
 
 int Evaluator::compare_values(const Value& a, const Value& b) {
-    // Type ordering: null < boolean < number < string < array < object
-    auto type_order = [](const Value& v) -> int {
-        if (v.is_null()) return 0;
-        if (v.is_boolean()) return 1;
-        if (v.is_number()) return 2;
-        if (v.is_string()) return 3;
-        if (v.is_array()) return 4;
-        if (v.is_object()) return 5;
-        return 6;
-    };
-    
-    int a_type = type_order(a);
-    int b_type = type_order(b);
-    
-    if (a_type != b_type) {
-        return a_type - b_type;
-    }
-    
-    // Same type comparison
-    if (a.is_null()) return 0;
-    if (a.is_boolean()) return a.as_boolean() == b.as_boolean() ? 0 : (a.as_boolean() ? 1 : -1);
-    if (a.is_number()) {
-        double diff = a.as_number() - b.as_number();
-        return diff < 0 ? -1 : (diff > 0 ? 1 : 0);
-    }
-    if (a.is_string()) return a.as_string().compare(b.as_string());
-    
-    // Arrays and objects would need recursive comparison
-    return 0; // Simplified
+    return a.compare(b);
 }
 
 // Built-in function implementations
@@ -802,16 +1907,16 @@ std::vector<Value> Evaluator::builtin_length(const std::vector<std::vector<Value
     const Value& val = args[0][0];
     
     if (val.is_array()) {
-        return {Value(static_cast<double>(val.as_array().size()))};
+        return {count_value(val.array_size())};
     }
     if (val.is_object()) {
-        return {Value(static_cast<double>(val.as_object().size()))};
+        return {count_value(val.as_object().size())};
     }
     if (val.is_string()) {
-        return {Value(static_cast<double>(val.as_string().length()))};
+        return {count_value(val.as_string_view().length())};
     }
     if (val.is_null()) {
-        return {Value(0.0)};
+        return {Value(0)};
     }
     
     throw std::runtime_error("length not supported for this type");
@@ -823,20 +1928,28 @@ std::vector<Value> Evaluator::builtin_keys(const std::vector<std::vector<Value>>
     const Value& val = args[0][0];
     
     if (val.is_object()) {
-        std::vector<Value> keys;
+        // Objects keep insertion order; sort the key names on demand
+        std::vector<const std::string*> names;
+        names.reserve(val.as_object().size());
         for (const auto& [key, _] : val.as_object()) {
-            keys.push_back(Value(key));
+            names.push_back(&key.str());
         }
-        std::sort(keys.begin(), keys.end(), [this](const Value& a, const Value& b) {
-            return compare_values(a, b) < 0;
+        std::sort(names.begin(), names.end(), [](const std::string* a, const std::string* b) {
+            return *a < *b;
         });
+        
+        std::vector<Value> keys;
+        keys.reserve(names.size());
+        for (const auto* name : names) {
+            keys.push_back(Value(*name));
+        }
         return {Value(std::move(keys))};
     }
     
     if (val.is_array()) {
         std::vector<Value> indices;
         for (size_t i = 0; i < val.as_array().size(); ++i) {
-            indices.push_back(Value(static_cast<double>(i)));
+            indices.push_back(Value(static_cast<int64_t>(i)));
         }
         return {Value(std::move(indices))};
     }
@@ -854,11 +1967,11 @@ std::vector<Value> Evaluator::builtin_values(const std::vector<std::vector<Value
         for (const auto& [_, v] : val.as_object()) {
             vals.push_back(v);
         }
-        return vals;
+        return {Value(std::move(vals))};
     }
     
     if (val.is_array()) {
-        return val.as_array();
+        return {val};
     }
     
     throw std::runtime_error("values only works on objects and arrays");
@@ -879,6 +1992,37 @@ std::vector<Value> Evaluator::builtin_type(const std::vector<std::vector<Value>>
     return {Value("unknown")};
 }
 
+namespace {
+    // Sum of the numbers among n elements; stays exact while every element
+    // is an integer and the sum fits
+    template <typename At>
+    Value sum_numbers(size_t n, At at) {
+        int64_t int_sum = 0;
+        size_t i = 0;
+        for (; i < n; ++i) {
+            decltype(auto) v = at(i);
+            if (!v.is_number()) continue;
+            int64_t next = 0;
+            if (!v.is_integer() || checked::add(int_sum, v.as_integer(), next)) {
+                break;
+            }
+            int_sum = next;
+        }
+        if (i == n) {
+            return Value(int_sum);
+        }
+        
+        double sum = static_cast<double>(int_sum);
+        for (; i < n; ++i) {
+            decltype(auto) v = at(i);
+            if (v.is_number()) {
+                sum += v.as_number();
+            }
+        }
+        return Value(sum);
+    }
+}
+
 std::vector<Value> Evaluator::builtin_add(const std::vector<std::vector<Value>>& args) {
     if (args.empty()) throw std::runtime_error("add requires input");
     
@@ -888,6 +2032,17 @@ std::vector<Value> Evaluator::builtin_add(const std::vector<std::vector<Value>>&
         return {val};
     }
     
+    // Ranges and repeats are summed element by element, never built
+    if (val.is_sequence()) {
+        size_t n = val.array_size();
+        if (n == 0) {
+            return {Value()};
+        }
+        if (val.element(0).is_number()) {
+            return {sum_numbers(n, [&](size_t i) { return val.element(i); })};
+        }
+    }
+    
     const auto& arr = val.as_array();
     if (arr.empty()) {
         return {Value()};
@@ -895,20 +2050,14 @@ std::vector<Value> Evaluator::builtin_add(const std::vector<std::vector<Value>>&
     
     // Detect type from first element
     if (arr[0].is_number()) {
-        double sum = 0.0;
-        for (const auto& elem : arr) {
-            if (elem.is_number()) {
-                sum += elem.as_number();
-            }
-        }
-        return {Value(sum)};
+        return {sum_numbers(arr.size(), [&](size_t i) -> const Value& { return arr[i]; })};
     }
     
     if (arr[0].is_string()) {
         std::string result;
         for (const auto& elem : arr) {
             if (elem.is_string()) {
-                result += elem.as_string();
+                result += elem.as_string_view();
             }
         }
         return {Value(result)};
@@ -1038,7 +2187,7 @@ std::vector<Value> Evaluator::builtin_tostring(const std::vector<std::vector<Val
         return {val};
     }
     if (val.is_number()) {
-        return {Value(std::to_string(val.as_number()))};
+        return {Value(val.to_toon())};
     }
     if (val.is_boolean()) {
         return {Value(val.as_boolean() ? "true" : "false")};
@@ -1059,12 +2208,12 @@ std::vector<Value> Evaluator::builtin_tonumber(const std::vector<std::vector<Val
     if (val.is_number()) {
         return {val};
     }
+    Value number;
+    if (val.is_string() && Value::try_parse_number(val.as_string_view(), number)) {
+        return {number};
+    }
     if (val.is_string()) {
-        try {
-            return {Value(std::stod(val.as_string()))};
-        } catch (...) {
-            throw std::runtime_error("Cannot convert string to number");
-        }
+        throw std::runtime_error("Cannot convert string to number");
     }
     
     throw std::runtime_error("Cannot convert to number");
@@ -1077,6 +2226,8 @@ std::vector<Value> Evaluator::builtin_floor(const std::vector<std::vector<Value>
     
     if (!val.is_number()) throw std::runtime_error("floor requires number");
     
+    if (val.is_integer()) return {val};  // already whole
+    
     return {Value(std::floor(val.as_number()))};
 }
 
@@ -1107,11 +2258,15 @@ std::vector<Value> Evaluator::builtin_has(const std::vector<std::vector<Value>>&
     const auto& key = args[1][0];
     
     if (container.is_object() && key.is_string()) {
-        return {Value(container.as_object().find(key.as_string()) != container.as_object().end())};
+        return {Value(container.as_object().find(key.as_string_view()) != container.as_object().end())};
     } else if (container.is_array() && key.is_number()) {
-        int idx = static_cast<int>(key.as_number());
-        if (idx < 0) idx = static_cast<int>(container.as_array().size()) + idx;
-        return {Value(idx >= 0 && idx < static_cast<int>(container.as_array().size()))};
+        int64_t idx = 0;
+        int64_t size = static_cast<int64_t>(container.array_size());
+        if (!to_index(key, idx)) {
+            return {Value(false)};
+        }
+        if (idx < 0) idx = size + idx;
+        return {Value(idx >= 0 && idx < size)};
     }
     
     return {Value(false)};
@@ -1127,7 +2282,7 @@ std::vector<Value> Evaluator::builtin_to_entries(const std::vector<std::vector<V
     
     if (val.is_object()) {
         for (const auto& [k, v] : val.as_object()) {
-            std::map<std::string, Value> entry;
+            Object entry;
             entry["key"] = Value(k);
             entry["value"] = v;
             entries.push_back(Value(entry));
@@ -1135,8 +2290,8 @@ std::vector<Value> Evaluator::builtin_to_entries(const std::vector<std::vector<V
     } else if (val.is_array()) {
         const auto& arr = val.as_array();
         for (size_t i = 0; i < arr.size(); i++) {
-            std::map<std::string, Value> entry;
-            entry["key"] = Value(static_cast<double>(i));
+            Object entry;
+            entry["key"] = Value(static_cast<int64_t>(i));
             entry["value"] = arr[i];
             entries.push_back(Value(entry));
         }
@@ -1155,7 +2310,7 @@ std::vector<Value> Evaluator::builtin_from_entries(const std::vector<std::vector
         throw std::runtime_error("from_entries requires array");
     }
     
-    std::map<std::string, Value> result;
+    Object result;
     
     for (const auto& entry : val.as_array()) {
         if (entry.is_object()) {
@@ -1223,7 +2378,7 @@ std::vector<Value> Evaluator::builtin_join(const std::vector<std::vector<Value>>
     const auto& arr = arr_val.as_array();
     for (size_t i = 0; i < arr.size(); i++) {
         if (arr[i].is_string()) {
-            result += arr[i].as_string();
+            result += arr[i].as_string_view();
         } else {
             result += arr[i].to_toon();
         }
@@ -1247,7 +2402,7 @@ std::vector<Value> Evaluator::builtin_startswith(const std::vector<std::vector<V
         return {Value(false)};
     }
     
-    return {Value(str_val.as_string().find(prefix_val.as_string()) == 0)};
+    return {Value(str_val.as_string_view().find(prefix_val.as_string_view()) == 0)};
 }
 
 std::vector<Value> Evaluator::builtin_endswith(const std::vector<std::vector<Value>>& args) {
@@ -1262,8 +2417,8 @@ std::vector<Value> Evaluator::builtin_endswith(const std::vector<std::vector<Val
         return {Value(false)};
     }
     
-    const std::string& str = str_val.as_string();
-    const std::string& suffix = suffix_val.as_string();
+    std::string_view str = str_val.as_string_view();
+    std::string_view suffix = suffix_val.as_string_view();
     
     if (suffix.length() > str.length()) {
         return {Value(false)};
@@ -1282,6 +2437,8 @@ std::vector<Value> Evaluator::builtin_ceil(const std::vector<std::vector<Value>>
         throw std::runtime_error("ceil requires number");
     }
     
+    if (val.is_integer()) return {val};  // already whole
+    
     return {Value(std::ceil(val.as_number()))};
 }
 
@@ -1295,6 +2452,8 @@ std::vector<Value> Evaluator::builtin_round(const std::vector<std::vector<Value>
         throw std::runtime_error("round requires number");
     }
     
+    if (val.is_integer()) return {val};  // already whole
+    
     return {Value(std::round(val.as_number()))};
 }
 
@@ -1305,9 +2464,18 @@ std::vector<Value> Evaluator::builtin_map(const ExprPtr& expr, const Value& data
         throw std::runtime_error("map can only be applied to arrays");
     }
     
+    // map(.field) over a table is a copy of the column
+    if (expr->type == ExprType::Field) {
+        if (const auto* column = data.column(expr->field_key)) {
+            return {Value(column->values())};
+        }
+    }
+    
     std::vector<Value> result_arr;
-    for (const auto& elem : data.as_array()) {
-        auto mapped_results = eval(expr, elem);
+    size_t size = data.array_size();
+    result_arr.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        auto mapped_results = eval(expr, data.element(i));
         // map collects all results into an array
         for (const auto& val : mapped_results) {
             result_arr.push_back(val);
@@ -1390,22 +2558,57 @@ std::vector<Value> Evaluator::builtin_group_by(const ExprPtr& expr, const Value&
         throw std::runtime_error("group_by can only be applied to arrays");
     }
     
-    // Create map of key -> elements
-    std::map<std::string, std::vector<Value>> groups;
+    // Grouping a table by an encoded column buckets rows by code; groups
+    // come out in the same order as the general path below
+    if (expr->type == ExprType::Field) {
+        const Column* column = data.column(expr->field_key);
+        if (column && column->encoded()) {
+            const auto& dictionary = column->dictionary();
+            std::vector<std::vector<Value>> buckets(dictionary.size());
+            const auto& codes = column->codes();
+            for (size_t row = 0; row < codes.size(); ++row) {
+                buckets[codes[row]].push_back(data.element(row));
+            }
+            
+            // The dictionary is sorted, so codes are already in key order
+            std::vector<Value> result_arr;
+            result_arr.reserve(dictionary.size());
+            for (auto& bucket : buckets) {
+                result_arr.push_back(Value(std::move(bucket)));
+            }
+            return {Value(std::move(result_arr))};
+        }
+    }
     
-    for (const auto& elem : data.as_array()) {
+    // Bucket elements by structural hash of their key, then order groups by key
+    std::unordered_map<Value, size_t> group_of;
+    std::vector<Value> keys;
+    std::vector<std::vector<Value>> groups;
+    
+    size_t n = data.array_size();
+    for (size_t i = 0; i < n; ++i) {
+        Value elem = data.element(i);
         auto key_results = eval(expr, elem);
         if (!key_results.empty()) {
-            // Convert key to string for grouping
-            std::string key = key_results[0].to_toon();
-            groups[key].push_back(elem);
+            auto [it, inserted] = group_of.try_emplace(key_results[0], groups.size());
+            if (inserted) {
+                keys.push_back(std::move(key_results[0]));
+                groups.emplace_back();
+            }
+            groups[it->second].push_back(std::move(elem));
         }
     }
     
-    // Convert groups to array of arrays
+    std::vector<size_t> order(groups.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a].compare(keys[b]) < 0; });
+    
     std::vector<Value> result_arr;
-    for (const auto& [key, group] : groups) {
-        result_arr.push_back(Value(group));
+    result_arr.reserve(groups.size());
+    for (size_t index : order) {
+        result_arr.push_back(Value(std::move(groups[index])));
     }
     
     return {Value(std::move(result_arr))};
@@ -1497,6 +2700,10 @@ std::vector<Value> Evaluator::builtin_abs(const std::vector<std::vector<Value>>&
         throw std::runtime_error("abs requires a number");
     }
     
+    if (val.is_integer() && val.as_integer() != INT64_MIN) {
+        return {Value(val.as_integer() < 0 ? -val.as_integer() : val.as_integer())};
+    }
+    
     return {Value(std::abs(val.as_number()))};
 }
 
@@ -1793,7 +3000,7 @@ std::vector<Value> Evaluator::builtin_contains(const std::vector<std::vector<Val
     
     // String contains substring
     if (haystack.is_string() && needle.is_string()) {
-        return {Value(haystack.as_string().find(needle.as_string()) != std::string::npos)};
+        return {Value(haystack.as_string_view().find(needle.as_string_view()) != std::string::npos)};
     }
     
     // Array contains element
@@ -1809,7 +3016,7 @@ std::vector<Value> Evaluator::builtin_contains(const std::vector<std::vector<Val
     // Object contains key
     if (haystack.is_object()) {
         if (needle.is_string()) {
-            return {Value(haystack.as_object().find(needle.as_string()) != haystack.as_object().end())};
+            return {Value(haystack.as_object().find(needle.as_string_view()) != haystack.as_object().end())};
         }
     }
     
@@ -1826,9 +3033,9 @@ std::vector<Value> Evaluator::builtin_index(const std::vector<std::vector<Value>
     
     // String index of substring
     if (haystack.is_string() && needle.is_string()) {
-        size_t pos = haystack.as_string().find(needle.as_string());
+        size_t pos = haystack.as_string_view().find(needle.as_string_view());
         if (pos != std::string::npos) {
-            return {Value(static_cast<double>(pos))};
+            return {Value(static_cast<int64_t>(pos))};
         }
         return {Value()};
     }
@@ -1838,7 +3045,7 @@ std::vector<Value> Evaluator::builtin_index(const std::vector<std::vector<Value>
         const auto& arr = haystack.as_array();
         for (size_t i = 0; i < arr.size(); i++) {
             if (compare_values(arr[i], needle) == 0) {
-                return {Value(static_cast<double>(i))};
+                return {Value(static_cast<int64_t>(i))};
             }
         }
         return {Value()};
@@ -1857,9 +3064,9 @@ std::vector<Value> Evaluator::builtin_rindex(const std::vector<std::vector<Value
     
     // String rindex of substring (last occurrence)
     if (haystack.is_string() && needle.is_string()) {
-        size_t pos = haystack.as_string().rfind(needle.as_string());
+        size_t pos = haystack.as_string_view().rfind(needle.as_string_view());
         if (pos != std::string::npos) {
-            return {Value(static_cast<double>(pos))};
+            return {Value(static_cast<int64_t>(pos))};
         }
         return {Value()};
     }
@@ -1867,9 +3074,9 @@ std::vector<Value> Evaluator::builtin_rindex(const std::vector<std::vector<Value
     // Array rindex of element (last occurrence)
     if (haystack.is_array()) {
         const auto& arr = haystack.as_array();
-        for (int i = static_cast<int>(arr.size()) - 1; i >= 0; i--) {
+        for (size_t i = arr.size(); i-- > 0;) {
             if (compare_values(arr[i], needle) == 0) {
-                return {Value(static_cast<double>(i))};
+                return {count_value(i)};
             }
         }
         return {Value()};
@@ -1889,7 +3096,7 @@ std::vector<Value> Evaluator::builtin_inside(const std::vector<std::vector<Value
     // Reverse of contains: check if needle is inside haystack
     // String inside string
     if (needle.is_string() && haystack.is_string()) {
-        return {Value(haystack.as_string().find(needle.as_string()) != std::string::npos)};
+        return {Value(haystack.as_string_view().find(needle.as_string_view()) != std::string::npos)};
     }
     
     // Element inside array
@@ -1905,7 +3112,7 @@ std::vector<Value> Evaluator::builtin_inside(const std::vector<std::vector<Value
     // Key inside object
     if (haystack.is_object()) {
         if (needle.is_string()) {
-            return {Value(haystack.as_object().find(needle.as_string()) != haystack.as_object().end())};
+            return {Value(haystack.as_object().find(needle.as_string_view()) != haystack.as_object().end())};
         }
     }
     
@@ -1924,18 +3131,18 @@ std::vector<Value> Evaluator::builtin_indices(const std::vector<std::vector<Valu
     
     // String indices of all substring occurrences
     if (haystack.is_string() && needle.is_string()) {
-        const std::string& str = haystack.as_string();
-        const std::string& substr = needle.as_string();
+        std::string_view str = haystack.as_string_view();
+        std::string_view substr = needle.as_string_view();
         
         if (substr.empty()) {
             // All positions for empty string
             for (size_t i = 0; i <= str.length(); i++) {
-                indices.push_back(Value(static_cast<double>(i)));
+                indices.push_back(Value(static_cast<int64_t>(i)));
             }
         } else {
             size_t pos = 0;
             while ((pos = str.find(substr, pos)) != std::string::npos) {
-                indices.push_back(Value(static_cast<double>(pos)));
+                indices.push_back(Value(static_cast<int64_t>(pos)));
                 pos += substr.length();
             }
         }
@@ -1945,7 +3152,7 @@ std::vector<Value> Evaluator::builtin_indices(const std::vector<std::vector<Valu
         const auto& arr = haystack.as_array();
         for (size_t i = 0; i < arr.size(); i++) {
             if (compare_values(arr[i], needle) == 0) {
-                indices.push_back(Value(static_cast<double>(i)));
+                indices.push_back(Value(static_cast<int64_t>(i)));
             }
         }
     }
@@ -1964,9 +3171,9 @@ std::vector<Value> Evaluator::builtin_first(const std::vector<std::vector<Value>
     
     // first(array) returns first element
     if (val.is_array()) {
-        const auto& arr = val.as_array();
-        if (!arr.empty()) {
-            return {arr[0]};
+        size_t n = val.array_size();
+        if (n > 0) {
+            return {val.element(0)};
         }
         return {};
     }
@@ -1984,9 +3191,9 @@ std::vector<Value> Evaluator::builtin_last(const std::vector<std::vector<Value>>
     
     // last(array) returns last element
     if (val.is_array()) {
-        const auto& arr = val.as_array();
-        if (!arr.empty()) {
-            return {arr.back()};
+        size_t n = val.array_size();
+        if (n > 0) {
+            return {val.element(n - 1)};
         }
         return {};
     }
@@ -2007,17 +3214,20 @@ std::vector<Value> Evaluator::builtin_nth(const std::vector<std::vector<Value>>&
         throw std::runtime_error("nth requires numeric index");
     }
     
-    int n = static_cast<int>(n_val.as_number());
+    int64_t n = 0;
+    if (!to_index(n_val, n)) {
+        return {};  // past any array
+    }
     
     if (val.is_array()) {
-        const auto& arr = val.as_array();
+        int64_t size = static_cast<int64_t>(val.array_size());
         // Handle negative indices
         if (n < 0) {
-            n = static_cast<int>(arr.size()) + n;
+            n = size + n;
         }
         
-        if (n >= 0 && n < static_cast<int>(arr.size())) {
-            return {arr[n]};
+        if (n >= 0 && n < size) {
+            return {val.element(static_cast<size_t>(n))};
         }
         return {};
     }
@@ -2027,51 +3237,44 @@ std::vector<Value> Evaluator::builtin_nth(const std::vector<std::vector<Value>>&
 }
 
 std::vector<Value> Evaluator::builtin_range(const std::vector<std::vector<Value>>& args) {
-    std::vector<Value> result;
-    
-    if (args.empty()) {
-        return {Value()};
-    }
-    
-    // range(n) generates 0 to n-1
-    if (args.size() == 1 && !args[0].empty()) {
-        const auto& n_val = args[0][0];
-        if (!n_val.is_number()) {
-            throw std::runtime_error("range requires numeric arguments");
+    // args[0] is the input; range(n), range(from; to) and range(from; to; by)
+    if (args.size() < 2 || args.size() > 4) {
+        throw std::runtime_error("range takes 1 to 3 arguments");
+    }
+    double bounds[3];
+    bool integers = true;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i].empty()) {
+            return {};
         }
-        
-        int n = static_cast<int>(n_val.as_number());
-        for (int i = 0; i < n; i++) {
-            result.push_back(Value(static_cast<double>(i)));
+        if (!args[i][0].is_number()) {
+            throw std::runtime_error("range requires numeric arguments");
         }
-        return {Value(result)};
+        bounds[i - 1] = args[i][0].as_number();
+        integers = integers && integral(args[i][0]);
     }
     
-    // range(from; to) generates from to to-1
-    if (args.size() >= 2 && !args[0].empty() && !args[1].empty()) {
-        const auto& from_val = args[0][0];
-        const auto& to_val = args[1][0];
-        
-        if (!from_val.is_number() || !to_val.is_number()) {
-            throw std::runtime_error("range requires numeric arguments");
-        }
-        
-        int from = static_cast<int>(from_val.as_number());
-        int to = static_cast<int>(to_val.as_number());
-        
-        if (from <= to) {
-            for (int i = from; i < to; i++) {
-                result.push_back(Value(static_cast<double>(i)));
-            }
-        } else {
-            for (int i = from; i > to; i--) {
-                result.push_back(Value(static_cast<double>(i)));
-            }
-        }
-        return {Value(result)};
+    double from = args.size() == 2 ? 0 : bounds[0];
+    double to = args.size() == 2 ? bounds[0] : bounds[1];
+    double by = args.size() == 4 ? bounds[2] : 1;
+    if (by == 0) {
+        throw std::runtime_error("range step must not be 0");
     }
     
-    return {Value(result)};
+    std::vector<Value> result;
+    if (integers) {
+        Value seq = Value::range(static_cast<int64_t>(from), static_cast<int64_t>(to), static_cast<int64_t>(by));
+        size_t n = seq.array_size();
+        result.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            result.push_back(seq.element(i));
+        }
+        return result;
+    }
+    for (double x = from; by > 0 ? x < to : x > to; x += by) {
+        result.push_back(Value(x));
+    }
+    return result;
 }
 
 std::vector<Value> Evaluator::builtin_flatten(const std::vector<std::vector<Value>>& args) {
@@ -2092,7 +3295,7 @@ std::vector<Value> Evaluator::builtin_flatten(const std::vector<std::vector<Valu
     
     std::function<std::vector<Value>(const Value&, int)> flatten_recursive;
     flatten_recursive = [&](const Value& v, int d) -> std::vector<Value> {
-        if (d <= 0 || !v.is_array()) {
+        if (!v.is_array()) {
             return {v};
         }
         
@@ -2222,7 +3425,7 @@ std::vector<Value> Evaluator::builtin_paths(const std::vector<std::vector<Value>
             }
         } else if (v.is_array()) {
             for (size_t i = 0; i < v.as_array().size(); i++) {
-                path.push_back(Value(static_cast<double>(i)));
+                path.push_back(Value(static_cast<int64_t>(i)));
                 collect_paths(v.as_array()[i], path);
                 path.pop_back();
             }
@@ -2263,7 +3466,7 @@ std::vector<Value> Evaluator::builtin_leaf_paths(const std::vector<std::vector<V
                 result.push_back(Value(path));
             } else {
                 for (size_t i = 0; i < v.as_array().size(); i++) {
-                    path.push_back(Value(static_cast<double>(i)));
+                    path.push_back(Value(static_cast<int64_t>(i)));
                     collect_leaf_paths(v.as_array()[i], path);
                     path.pop_back();
                 }
@@ -2280,6 +3483,94 @@ std::vector<Value> Evaluator::builtin_leaf_paths(const std::vector<std::vector<V
     return result;
 }
 
+std::vector<Value> Evaluator::builtin_getpath(const std::vector<std::vector<Value>>& args) {
+    if (args.size() < 2) {
+        throw std::runtime_error("getpath requires a path");
+    }
+    
+    std::vector<Value> result;
+    for (const auto& path : args[1]) {
+        result.push_back(get_path(args[0][0], path_steps(path)));
+    }
+    return result;
+}
+
+std::vector<Value> Evaluator::builtin_setpath(const std::vector<std::vector<Value>>& args) {
+    if (args.size() < 3) {
+        throw std::runtime_error("setpath requires a path and a value");
+    }
+    
+    std::vector<Value> result;
+    for (const auto& path : args[1]) {
+        const auto& steps = path_steps(path);
+        for (const auto& value : args[2]) {
+            Value updated = args[0][0];
+            set_path(updated, steps, value);
+            result.push_back(std::move(updated));
+        }
+    }
+    return result;
+}
+
+std::vector<Value> Evaluator::builtin_delpaths(const std::vector<std::vector<Value>>& args) {
+    if (args.size() < 2) {
+        throw std::runtime_error("delpaths requires a list of paths");
+    }
+    
+    std::vector<Value> result;
+    for (const auto& paths : args[1]) {
+        const auto& list = path_list(paths);
+        Value updated = args[0][0];
+        delete_paths(updated, list);
+        result.push_back(std::move(updated));
+    }
+    return result;
+}
+
+std::vector<Value> Evaluator::builtin_path(const ExprPtr& expr, const Value& data) {
+    std::vector<PathEntry> paths;
+    std::vector<Value> prefix;
+    collect_paths(expr, data, prefix, paths);
+    
+    std::vector<Value> result;
+    result.reserve(paths.size());
+    for (auto& entry : paths) {
+        result.push_back(Value(std::move(entry.first)));
+    }
+    return result;
+}
+
+std::vector<Value> Evaluator::builtin_del(const ExprPtr& expr, const Value& data) {
+    std::vector<Value> paths = builtin_path(expr, data);
+    Value result = data;
+    delete_paths(result, std::move(paths));
+    return {result};
+}
+
+std::vector<Value> Evaluator::eval_path_update(const ExprPtr& expr, Value data) {
+    if (expr->func_name == "del") {
+        std::vector<Value> paths = builtin_path(expr->args[0], data);
+        delete_paths(data, std::move(paths));
+        return {std::move(data)};
+    }
+    
+    std::vector<std::vector<Value>> args;
+    for (const auto& arg : expr->args) {
+        args.push_back(eval(arg, data));
+    }
+    // With one output it is data itself, updated; with several, each is a copy
+    if (expr->func_name == "setpath" && args[0].size() == 1 && args[1].size() == 1) {
+        set_path(data, path_steps(args[0][0]), std::move(args[1][0]));
+        return {std::move(data)};
+    }
+    if (expr->func_name == "delpaths" && args[0].size() == 1) {
+        delete_paths(data, path_list(args[0][0]));
+        return {std::move(data)};
+    }
+    args.insert(args.begin(), {std::move(data)});
+    return builtins_.at(expr->func_name)(args);
+}
+
 std::vector<Value> Evaluator::builtin_keys_unsorted(const std::vector<std::vector<Value>>& args) {
     if (args.empty() || args[0].empty()) {
         return {Value()};
@@ -2296,7 +3587,7 @@ std::vector<Value> Evaluator::builtin_keys_unsorted(const std::vector<std::vecto
     } else if (val.is_array()) {
         std::vector<Value> indices;
         for (size_t i = 0; i < val.as_array().size(); i++) {
-            indices.push_back(Value(static_cast<double>(i)));
+            indices.push_back(Value(static_cast<int64_t>(i)));
         }
         return {Value(indices)};
     }
@@ -2318,7 +3609,7 @@ std::vector<Value> Evaluator::builtin_walk(const ExprPtr& expr, const Value& dat
             }
             current = Value(walked);
         } else if (v.is_object()) {
-            std::map<std::string, Value> walked;
+            Object walked;
             for (const auto& [key, val] : v.as_object()) {
                 walked[key] = walk_recursive(val);
             }
@@ -2404,7 +3695,7 @@ std::vector<Value> Evaluator::builtin_to_array(const std::vector<std::vector<Val
 
 std::vector<Value> Evaluator::builtin_to_object(const std::vector<std::vector<Value>>& args) {
     if (args.empty() || args[0].empty()) {
-        return {Value(std::map<std::string, Value>())};
+        return {Value(Object())};
     }
     
     const auto& val = args[0][0];
@@ -2413,7 +3704,7 @@ std::vector<Value> Evaluator::builtin_to_object(const std::vector<std::vector<Va
         return {val};
     } else if (val.is_array()) {
         // Convert array of [key, value] pairs to object
-        std::map<std::string, Value> obj;
+        Object obj;
         for (const auto& elem : val.as_array()) {
             if (elem.is_array()) {
                 const auto& pair = elem.as_array();
@@ -2588,8 +3879,8 @@ std::vector<Value> Evaluator::builtin_ascii(const std::vector<std::vector<Value>
     if (val.is_string()) {
         // Convert string to array of codepoints
         std::vector<Value> codepoints;
-        for (char c : val.as_string()) {
-            codepoints.push_back(Value(static_cast<double>(static_cast<unsigned char>(c))));
+        for (char c : val.as_string_view()) {
+            codepoints.push_back(Value(static_cast<int64_t>(static_cast<unsigned char>(c))));
         }
         return {Value(codepoints)};
     }
@@ -2605,8 +3896,8 @@ std::vector<Value> Evaluator::builtin_explode(const std::vector<std::vector<Valu
     const auto& val = args[0][0];
     if (val.is_string()) {
         std::vector<Value> codepoints;
-        for (char c : val.as_string()) {
-            codepoints.push_back(Value(static_cast<double>(static_cast<unsigned char>(c))));
+        for (char c : val.as_string_view()) {
+            codepoints.push_back(Value(static_cast<int64_t>(static_cast<unsigned char>(c))));
         }
         return {Value(codepoints)};
     }
@@ -2671,7 +3962,7 @@ std::vector<Value> Evaluator::builtin_now(const std::vector<std::vector<Value>>&
     // Returns current Unix timestamp as a number
     auto now = std::chrono::system_clock::now();
     auto timestamp = std::chrono::system_clock::to_time_t(now);
-    return {Value(static_cast<double>(timestamp))};
+    return {Value(static_cast<int64_t>(timestamp))};
 }
 
 std::vector<Value> Evaluator::builtin_gmtime(const std::vector<std::vector<Value>>& args) {
@@ -2695,14 +3986,14 @@ std::vector<Value> Evaluator::builtin_gmtime(const std::vector<std::vector<Value
     }
     
     std::vector<Value> resultarr;
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_year + 1900)));  // year
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_mon)));           // month (0-11)
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_mday)));          // day
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_hour)));          // hour
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_min)));           // minute
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_sec)));           // second
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_wday)));          // day of week (0=Sunday)
-    resultarr.push_back(Value(static_cast<double>(timeinfo.tm_yday)));          // day of year
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_year + 1900)));  // year
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_mon)));           // month (0-11)
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_mday)));          // day
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_hour)));          // hour
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_min)));           // minute
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_sec)));           // second
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_wday)));          // day of week (0=Sunday)
+    resultarr.push_back(Value(static_cast<int64_t>(timeinfo.tm_yday)));          // day of year
     
     return {Value(resultarr)};
 }
@@ -2737,7 +4028,7 @@ std::vector<Value> Evaluator::builtin_mktime(const std::vector<std::vector<Value
         throw std::runtime_error("mktime conversion failed");
     }
     
-    return {Value(static_cast<double>(timestamp))};
+    return {Value(static_cast<int64_t>(timestamp))};
 }
 
 std::vector<Value> Evaluator::builtin_strftime(const std::vector<std::vector<Value>>& args) {
@@ -2792,21 +4083,23 @@ std::vector<Value> Evaluator::builtin_strptime(const std::vector<std::vector<Val
     }
     
     struct std::tm timeinfo = {};
-    const char* p = strptime(str_val.as_string().c_str(), fmt_val.as_string().c_str(), &timeinfo);
+    std::string input = str_val.as_string();
+    std::string format = fmt_val.as_string();
+    const char* p = strptime(input.c_str(), format.c_str(), &timeinfo);
     
     if (!p || *p != '\0') {
         throw std::runtime_error("strptime: time parsing failed");
     }
     
     std::vector<Value> result;
-    result.push_back(Value(static_cast<double>(timeinfo.tm_year + 1900)));  // year
-    result.push_back(Value(static_cast<double>(timeinfo.tm_mon)));           // month
-    result.push_back(Value(static_cast<double>(timeinfo.tm_mday)));          // day
-    result.push_back(Value(static_cast<double>(timeinfo.tm_hour)));          // hour
-    result.push_back(Value(static_cast<double>(timeinfo.tm_min)));           // minute
-    result.push_back(Value(static_cast<double>(timeinfo.tm_sec)));           // second
-    result.push_back(Value(static_cast<double>(timeinfo.tm_wday)));          // weekday
-    result.push_back(Value(static_cast<double>(timeinfo.tm_yday)));          // yearday
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_year + 1900)));  // year
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_mon)));           // month
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_mday)));          // day
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_hour)));          // hour
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_min)));           // minute
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_sec)));           // second
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_wday)));          // weekday
+    result.push_back(Value(static_cast<int64_t>(timeinfo.tm_yday)));          // yearday
     
     return {Value(result)};
 }
@@ -2848,11 +4141,12 @@ std::vector<Value> Evaluator::builtin_fromdate(const std::vector<std::vector<Val
     }
     
     struct std::tm timeinfo = {};
-    const char* p = strptime(val.as_string().c_str(), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+    std::string input = val.as_string();
+    const char* p = strptime(input.c_str(), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
     
     if (!p || (*p != '\0' && *p != '+' && *p != '-')) {
         // Try without Z suffix
-        p = strptime(val.as_string().c_str(), "%Y-%m-%dT%H:%M:%S", &timeinfo);
+        p = strptime(input.c_str(), "%Y-%m-%dT%H:%M:%S", &timeinfo);
         if (!p || *p != '\0') {
             throw std::runtime_error("fromdate: unable to parse date");
         }
@@ -2863,7 +4157,7 @@ std::vector<Value> Evaluator::builtin_fromdate(const std::vector<std::vector<Val
         throw std::runtime_error("fromdate conversion failed");
     }
     
-    return {Value(static_cast<double>(timestamp))};
+    return {Value(static_cast<int64_t>(timestamp))};
 }
 
 std::vector<Value> Evaluator::builtin_todateiso8601(const std::vector<std::vector<Value>>& args) {
@@ -2889,7 +4183,7 @@ std::vector<Value> Evaluator::builtin_format_base64(const std::vector<std::vecto
     if (val.is_string()) {
         input = val.as_string();
     } else if (val.is_number()) {
-        input = std::to_string(static_cast<long long>(val.as_number()));
+        input = val.to_toon();
     } else if (val.is_boolean()) {
         input = val.as_boolean() ? "true" : "false";
     } else {
@@ -2927,7 +4221,7 @@ std::vector<Value> Evaluator::builtin_format_uri(const std::vector<std::vector<V
     if (val.is_string()) {
         input = val.as_string();
     } else if (val.is_number()) {
-        input = std::to_string(static_cast<long long>(val.as_number()));
+        input = val.to_toon();
     } else if (val.is_boolean()) {
         input = val.as_boolean() ? "true" : "false";
     } else {
@@ -2956,7 +4250,7 @@ std::vector<Value> Evaluator::builtin_format_csv(const std::vector<std::vector<V
         if (arr[i].is_string()) {
             result += csv_escape(arr[i].as_string());
         } else if (arr[i].is_number()) {
-            result += std::to_string(static_cast<long long>(arr[i].as_number()));
+            result += arr[i].to_toon();
         } else if (arr[i].is_boolean()) {
             result += arr[i].as_boolean() ? "true" : "false";
         } else if (arr[i].is_null()) {
@@ -2986,9 +4280,9 @@ std::vector<Value> Evaluator::builtin_format_tsv(const std::vector<std::vector<V
         if (i > 0) result += "\t";
         
         if (arr[i].is_string()) {
-            result += arr[i].as_string();
+            result += arr[i].as_string_view();
         } else if (arr[i].is_number()) {
-            result += std::to_string(static_cast<long long>(arr[i].as_number()));
+            result += arr[i].to_toon();
         } else if (arr[i].is_boolean()) {
             result += arr[i].as_boolean() ? "true" : "false";
         } else if (arr[i].is_null()) {
@@ -3012,7 +4306,7 @@ std::vector<Value> Evaluator::builtin_format_html(const std::vector<std::vector<
     if (val.is_string()) {
         input = val.as_string();
     } else if (val.is_number()) {
-        input = std::to_string(static_cast<long long>(val.as_number()));
+        input = val.to_toon();
     } else if (val.is_boolean()) {
         input = val.as_boolean() ? "true" : "false";
     } else {
@@ -3041,9 +4335,9 @@ std::vector<Value> Evaluator::builtin_format_text(const std::vector<std::vector<
     
     
     if (val.is_string()) {
-        return {Value(val.as_string())};
+        return {val};
     } else if (val.is_number()) {
-        return {Value(std::to_string(static_cast<long long>(val.as_number())))};
+        return {Value(val.to_toon())};
     } else if (val.is_boolean()) {
         return {Value(val.as_boolean() ? std::string("true") : std::string("false"))};
     } else if (val.is_null()) {
@@ -3073,8 +4367,8 @@ std::vector<Value> Evaluator::builtin_limit(const std::vector<std::vector<Value>
     // For now, return a special marker - actual limiting happens in the expression evaluator
     // In jq, limit is implemented as a generator that yields at most n values
     
-    std::map<std::string, Value> marker_map;
-    marker_map["__limit_count__"] = Value(static_cast<double>(limit));
+    Object marker_map;
+    marker_map["__limit_count__"] = Value(static_cast<int64_t>(limit));
     
     return {Value(marker_map)};
 }
@@ -3115,7 +4409,7 @@ std::vector<Value> Evaluator::builtin_INDEX(const std::vector<std::vector<Value>
         }
         
         // For simple single-argument INDEX, create index by array indices
-        std::map<std::string, Value> result_map;
+        Object result_map;
         
         for (size_t i = 0; i < arr.as_array().size(); ++i) {
             std::string key = std::to_string(i);
@@ -3127,7 +4421,7 @@ std::vector<Value> Evaluator::builtin_INDEX(const std::vector<std::vector<Value>
     
     // More complex cases would require expression evaluation
     // For now, provide basic indexed object creation
-    std::map<std::string, Value> result_map;
+    Object result_map;
     
     for (size_t i = 0; i < args.size(); ++i) {
         if (!args[i].empty()) {
@@ -3140,42 +4434,25 @@ std::vector<Value> Evaluator::builtin_INDEX(const std::vector<std::vector<Value>
 }
 
 std::vector<Value> Evaluator::builtin_IN(const std::vector<std::vector<Value>>& args) {
-    // IN(values) - Creates a lookup set for quick membership testing
-    // IN([1,2,3]) returns a function that tests membership
-    // Typically used as: IN([1,2,3]) or IN(stream)
+    // IN(s) - whether the input is among the outputs of s
+    // IN(source; s) - whether any output of source is among the outputs of s
+    // The outputs of s are hashed once; lookups use Value::hash and deep
+    // equality, so no element is ever turned into text
     
-    if (args.empty() || args[0].empty()) {
+    if (args.size() < 2) {
         throw std::runtime_error("IN: requires argument");
     }
     
-    const auto& val = args[0][0];
-    
-    if (!val.is_array()) {
-        throw std::runtime_error("IN: argument must be an array");
-    }
+    const auto& candidates = args.size() == 2 ? args[0] : args[1];
+    const auto& members = args.back();
+    std::unordered_set<Value> lookup(members.begin(), members.end());
     
-    // Create a set-like structure (using object for O(1) lookup)
-    std::map<std::string, Value> obj_map;
-    
-    for (const auto& elem : val.as_array()) {
-        // Convert element to string key for membership testing
-        std::string key;
-        if (elem.is_string()) {
-            key = elem.as_string();
-        } else if (elem.is_number()) {
-            key = std::to_string(static_cast<long long>(elem.as_number()));
-        } else if (elem.is_boolean()) {
-            key = elem.as_boolean() ? "true" : "false";
-        } else if (elem.is_null()) {
-            key = "null";
-        } else {
-            key = elem.to_toon();
+    for (const auto& candidate : candidates) {
+        if (lookup.count(candidate)) {
+            return {Value(true)};
         }
-        
-        obj_map[key] = Value(true);
     }
-    
-    return {Value(obj_map)};
+    return {Value(false)};
 }
 
 std::vector<Value> Evaluator::builtin_GROUP_BY_advanced(const ExprPtr& expr, const Value& data) {
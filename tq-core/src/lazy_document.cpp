@@ -0,0 +1,279 @@
+#include "tq/lazy_document.hpp"
+#include "tq/projection.hpp"
+#include "tq/toon_parser.hpp"
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace tq {
+
+// An object whose fields are located on first use
+struct LazyDocument::Node {
+    struct Field {
+        Key key;
+        size_t line;  // of its "key: ..." line
+        bool resolved = false;
+        std::unique_ptr<Node> child = nullptr;  // a nested object, itself lazy
+        Value value = Value();                  // anything else, once decoded
+    };
+
+    size_t line;  // first line of the fields
+    int depth;
+    const Projection* projection;  // what is read of the object, nullptr: all
+    bool scanned = false;
+    std::vector<Field> fields;
+    std::unordered_map<Key, size_t> index;  // key -> field, for objects above kIndexed fields
+    bool decoded = false;
+    Value value;  // the whole object, once asked for
+
+    static constexpr size_t kIndexed = 16;
+
+    Node(size_t line, int depth, const Projection* projection) : line(line), depth(depth), projection(projection) {}
+
+    long find(Key key) const {
+        if (!index.empty()) {
+            auto it = index.find(key);
+            return it == index.end() ? -1 : static_cast<long>(it->second);
+        }
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (fields[i].key == key) {
+                return static_cast<long>(i);
+            }
+        }
+        return -1;
+    }
+};
+
+struct LazyDocument::State {
+    ToonParser::Context ctx;
+    std::shared_ptr<const Projection> projection;
+    std::mutex mutex;
+    size_t lines_decoded = 0;
+    std::unique_ptr<Node> root;  // a root object
+    bool root_array = false;
+    bool root_decoded = false;
+    Value root_value;            // any other root, decoded on first use
+
+    State(std::string content, Arena* arena, unsigned threads, std::shared_ptr<const Projection> projection)
+        : ctx(std::move(content), arena, threads), projection(std::move(projection)) {}
+};
+
+LazyDocument::LazyDocument(std::string content, Arena* arena, unsigned threads, std::shared_ptr<const Projection> projection) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    state_ = std::make_unique<State>(std::move(content), arena, threads, std::move(projection));
+    ToonParser::Context& ctx = state_->ctx;
+
+    // The same root cases as ToonParser::parse
+    if (ctx.line_count == 0) {
+        state_->root_value = Value(Object(ctx.arena), ctx.arena);
+        state_->root_decoded = true;
+        return;
+    }
+    std::string_view first = ctx.content(0);
+    state_->root_array = ToonParser::is_array_header(first) && first[0] == '[';
+    bool root_primitive = ctx.line_count == 1 && first.find(':') == std::string_view::npos;
+    if (!state_->root_array && !root_primitive) {
+        state_->root = std::make_unique<Node>(0, 0, state_->projection.get());
+    }
+}
+
+LazyDocument::LazyDocument(LazyDocument&&) noexcept = default;
+LazyDocument& LazyDocument::operator=(LazyDocument&&) noexcept = default;
+LazyDocument::~LazyDocument() = default;
+
+LazyRef LazyDocument::root() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (state_->root) {
+        return LazyRef(this, state_->root.get());
+    }
+    if (!state_->root_decoded) {
+        ToonParser::Context& ctx = state_->ctx;
+        state_->root_value = state_->root_array ? ToonParser::parse_root_array(ctx, state_->projection.get()) : ToonParser::parse_primitive(ctx, ctx.content(0));
+        state_->lines_decoded += std::max<size_t>(ctx.current_line, 1);
+        state_->root_decoded = true;
+    }
+    return LazyRef(state_->root_value);
+}
+
+Value LazyDocument::to_value() const {
+    return root().to_value();
+}
+
+size_t LazyDocument::lines_decoded() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->lines_decoded;
+}
+
+// Locates the fields of node as ToonParser::parse_object_fields reads them,
+// reading only the lines at the object's own depth
+void LazyDocument::scan(Node& node) const {
+    if (node.scanned) {
+        return;
+    }
+    ToonParser::Context& ctx = state_->ctx;
+    size_t line = node.line;
+    while (line < ctx.line_count && ctx.depth(line) == node.depth) {
+        std::string_view content = ctx.content(line);
+        if (content.empty() || content[0] == '-') {
+            break;  // Not an object field
+        }
+        size_t colon_pos = ctx.find_colon(content);
+        if (colon_pos == std::string_view::npos) {
+            break;
+        }
+        Key key = ToonParser::is_array_header(content)
+            ? Key(ToonParser::parse_array_header(content).key)
+            : ctx.key(ToonParser::trim(content.substr(0, colon_pos)));
+        state_->lines_decoded++;
+
+        // A repeated key keeps its first position and takes the later value
+        long existing = node.find(key);
+        if (existing >= 0) {
+            node.fields[existing].line = line;
+        } else {
+            node.fields.push_back({key, line});
+            if (!node.index.empty() || node.fields.size() > Node::kIndexed) {
+                for (size_t i = node.index.size(); i < node.fields.size(); ++i) {
+                    node.index.emplace(node.fields[i].key, i);
+                }
+            }
+        }
+
+        // The field's own block is every deeper line after it
+        for (++line; line < ctx.line_count && ctx.depth(line) > node.depth; ++line) {
+        }
+    }
+    node.scanned = true;
+}
+
+// Field i of a scanned node, decoded as ToonParser::parse_object_fields
+// would decode it
+LazyRef LazyDocument::field(Node& node, size_t i) const {
+    Node::Field& field = node.fields[i];
+    if (!field.resolved) {
+        ToonParser::Context& ctx = state_->ctx;
+        std::string_view content = ctx.content(field.line);
+        std::string_view value_part = ToonParser::trim(content.substr(ctx.find_colon(content) + 1));
+        const Projection* p = Projection::field(node.projection, field.key);  // all, if skipped
+
+        if (ToonParser::is_array_header(content)) {
+            ToonParser::ArrayHeader header = ToonParser::parse_array_header(content);
+            ctx.current_line = field.line + 1;
+            if (!value_part.empty()) {
+                field.value = ToonParser::parse_inline_array(ctx, value_part, header.length, header.delimiter);
+            } else if (!header.fields.empty()) {
+                field.value = ToonParser::parse_tabular_array(ctx, node.depth + 1, header, p);
+            } else {
+                field.value = ToonParser::parse_list_array(ctx, node.depth + 1, header.length, p);
+            }
+            state_->lines_decoded += ctx.current_line - field.line - 1;
+        } else if (value_part.empty()) {
+            field.child = std::make_unique<Node>(field.line + 1, node.depth + 1, p);
+        } else {
+            field.value = ToonParser::parse_primitive(ctx, value_part);
+        }
+        field.resolved = true;
+    }
+    return field.child ? LazyRef(this, field.child.get()) : LazyRef(field.value);
+}
+
+// The whole of node. An object nothing has looked into is decoded in one
+// pass; once scanned, it is built from its fields, so those already
+// resolved are not read again.
+Value LazyDocument::decode(Node& node) const {
+    if (node.decoded) {
+        return node.value;
+    }
+    ToonParser::Context& ctx = state_->ctx;
+    if (!node.scanned) {
+        ctx.current_line = node.line;
+        node.value = ToonParser::parse_object_fields(ctx, node.depth, node.projection);
+        state_->lines_decoded += ctx.current_line - node.line;
+    } else {
+        Object obj(ctx.arena);
+        obj.reserve(node.fields.size());
+        for (size_t i = 0; i < node.fields.size(); ++i) {
+            if (Projection::skips(node.projection, node.fields[i].key)) {
+                continue;  // as parse_object_fields leaves it out
+            }
+            field(node, i);
+            Node::Field& resolved = node.fields[i];
+            obj.insert_or_assign(resolved.key, resolved.child ? decode(*resolved.child) : resolved.value);
+        }
+        node.value = Value(std::move(obj), ctx.arena);
+    }
+    node.decoded = true;
+    return node.value;
+}
+
+size_t LazyRef::size() const {
+    if (node_) {
+        std::lock_guard<std::mutex> lock(doc_->state_->mutex);
+        doc_->scan(*node_);
+        return node_->fields.size();
+    }
+    if (value_.is_array()) {
+        return value_.array_size();
+    }
+    return value_.is_object() ? value_.field_count() : 0;
+}
+
+LazyRef LazyRef::get(Key key) const {
+    if (node_) {
+        std::lock_guard<std::mutex> lock(doc_->state_->mutex);
+        doc_->scan(*node_);
+        long i = node_->find(key);
+        return i < 0 ? LazyRef() : doc_->field(*node_, static_cast<size_t>(i));
+    }
+    if (!value_.is_object()) {
+        return LazyRef();
+    }
+    const Value* field = value_.get(key);
+    return field ? LazyRef(*field) : LazyRef();
+}
+
+LazyRef LazyRef::get(size_t index) const {
+    if (node_ || !value_.is_array() || index >= value_.array_size()) {
+        return LazyRef();
+    }
+    return LazyRef(value_.element(index));
+}
+
+void LazyRef::children(std::vector<LazyRef>& out) const {
+    if (node_) {
+        std::lock_guard<std::mutex> lock(doc_->state_->mutex);
+        doc_->scan(*node_);
+        for (size_t i = 0; i < node_->fields.size(); ++i) {
+            out.push_back(doc_->field(*node_, i));
+        }
+    } else if (value_.is_array()) {
+        for (size_t i = 0; i < value_.array_size(); ++i) {
+            out.emplace_back(value_.element(i));
+        }
+    } else if (value_.is_object()) {
+        for (size_t i = 0; i < value_.field_count(); ++i) {
+            out.emplace_back(value_.field_value(i));
+        }
+    }
+}
+
+void LazyRef::descendants(std::vector<LazyRef>& out) const {
+    out.push_back(*this);
+    std::vector<LazyRef> nested;
+    children(nested);
+    for (const LazyRef& child : nested) {
+        child.descendants(out);
+    }
+}
+
+Value LazyRef::to_value() const {
+    if (node_) {
+        std::lock_guard<std::mutex> lock(doc_->state_->mutex);
+        return doc_->decode(*node_);
+    }
+    return value_;
+}
+
+} // namespace tq
@@ -366,6 +366,17 @@ std::vector<Token> Lexer::tokenize() {
                 }
                 break;
                 
+            case '$':
+                {
+                    advance();
+                    if (std::isalpha(static_cast<unsigned char>(current())) || current() == '_') {
+                        tokens.emplace_back(TokenType::Variable, read_identifier(), token_pos);
+                    } else {
+                        throw LexerError("Expected variable name after '$' at position " + std::to_string(token_pos));
+                    }
+                }
+                break;
+                
             default:
                 if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
                     std::string id = read_identifier();
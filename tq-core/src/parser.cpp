@@ -1,8 +1,27 @@
 #include "tq/parser.hpp"
+#include <limits>
 #include <stdexcept>
 
 namespace tq {
 
+namespace {
+    // An index or slice bound given as a number literal. Fractions are
+    // truncated; bounds past int64 saturate, which no array can reach.
+    int64_t index_literal(const ExprPtr& number) {
+        if (number->is_integer) {
+            return number->int_val;
+        }
+        double val = number->num_val;
+        if (val >= 9223372036854775807.0) {
+            return std::numeric_limits<int64_t>::max();
+        }
+        if (val <= -9223372036854775808.0) {
+            return std::numeric_limits<int64_t>::min();
+        }
+        return val == val ? static_cast<int64_t>(val) : 0;  // NaN: 0
+    }
+}
+
 Parser::Parser(std::vector<Token> tokens) : tokens_(std::move(tokens)), pos_(0) {}
 
 const Token& Parser::current() const {
@@ -102,7 +121,8 @@ ExprPtr Parser::parse_assignment() {
         match(TokenType::AltAssign)) {
         
         TokenType assign_op = tokens_[pos_ - 1].type;
-        ExprPtr right = parse_expression();
+        // Binds tighter than , and |, as in jq: `.a = 1 | .a` is `(.a = 1) | .a`
+        ExprPtr right = parse_or();
         
         auto assign_expr = std::make_shared<Expr>(ExprType::Assignment);
         assign_expr->op = assign_op;
@@ -286,8 +306,9 @@ ExprPtr Parser::parse_primary() {
     }
     
     if (match(TokenType::Number)) {
-        double val = std::stod(tokens_[pos_ - 1].value);
-        return Expr::number_expr(val);
+        Value val = Value::parse_number(tokens_[pos_ - 1].value);
+        return val.is_integer() ? Expr::integer_expr(val.as_integer())
+                                : Expr::number_expr(val.as_number());
     }
     
     if (match(TokenType::String)) {
@@ -318,6 +339,14 @@ ExprPtr Parser::parse_primary() {
         return parse_try();
     }
     
+    // Variable reference
+    if (check(TokenType::Variable)) {
+        auto var_expr = std::make_shared<Expr>(ExprType::Variable);
+        var_expr->var_name = current().value;
+        advance();
+        return var_expr;
+    }
+    
     // Iteration constructs
     if (check(TokenType::Reduce)) {
         return parse_reduce();
@@ -327,6 +356,11 @@ ExprPtr Parser::parse_primary() {
         return parse_foreach();
     }
     
+    // Recursive descent; the lexer folds `..` into one token
+    if (match(TokenType::DoubleDot)) {
+        return Expr::recursive_descent_expr();
+    }
+    
     // Identity or field access
     if (match(TokenType::Dot)) {
         if (match(TokenType::Dot)) {
@@ -410,7 +444,7 @@ ExprPtr Parser::parse_index_or_slice(ExprPtr base) {
         
         // Get start from index_expr (must be a number literal for now)
         if (index_expr->type == ExprType::Number) {
-            slice_expr->slice_start = static_cast<int>(index_expr->num_val);
+            slice_expr->slice_start = index_literal(index_expr);
         } else {
             throw ParseError("Slice start must be a number");
         }
@@ -418,7 +452,7 @@ ExprPtr Parser::parse_index_or_slice(ExprPtr base) {
         if (!check(TokenType::RightBracket)) {
             ExprPtr end_expr = parse_expression();
             if (end_expr->type == ExprType::Number) {
-                slice_expr->slice_end = static_cast<int>(end_expr->num_val);
+                slice_expr->slice_end = index_literal(end_expr);
                 slice_expr->has_slice_end = true;
             } else {
                 throw ParseError("Slice end must be a number");
@@ -435,12 +469,22 @@ ExprPtr Parser::parse_index_or_slice(ExprPtr base) {
     
     consume(TokenType::RightBracket, "Expected ']'");
     
-    // Simple index
-    auto idx_expr = std::make_shared<Expr>(ExprType::Index);
+    // Anything but a literal index or name is computed from the input, as
+    // the base is: in .a[.i], .i is read from the same object as .a
+    if (index_expr->type != ExprType::Number && index_expr->type != ExprType::String) {
+        auto dyn_expr = std::make_shared<Expr>(ExprType::DynamicIndex);
+        dyn_expr->left = base;
+        dyn_expr->operand = index_expr;
+        return dyn_expr;
+    }
+    
+    // Simple index, or .["name"] as a field
+    ExprPtr idx_expr;
     if (index_expr->type == ExprType::Number) {
-        idx_expr->index_val = static_cast<int>(index_expr->num_val);
+        idx_expr = std::make_shared<Expr>(ExprType::Index);
+        idx_expr->index_val = index_literal(index_expr);
     } else {
-        throw ParseError("Index must be a number");
+        idx_expr = Expr::field_expr(index_expr->str_val);
     }
     
     auto pipe_expr = std::make_shared<Expr>(ExprType::Pipe);
@@ -520,9 +564,10 @@ ExprPtr Parser::parse_object_literal() {
             }
             
             consume(TokenType::Colon, "Expected ':'");
-            ExprPtr value = parse_expression();
+            // Values stop at ',' and '|' so the next field is not swallowed
+            ExprPtr value = parse_or();
             
-            obj_expr->object_fields.push_back({key, value});
+            obj_expr->object_fields.push_back({Key(key), value});
         } while (match(TokenType::Comma));
     }
     
@@ -582,8 +627,8 @@ ExprPtr Parser::parse_reduce() {
     reduce_expr->reduce_iter_expr = parse_expression();
     
     consume(TokenType::As, "Expected 'as'");
-    // Parse variable pattern (simplified - just $var for now)
-    // Full implementation would handle destructuring
+    // Only plain $var patterns; destructuring is not supported
+    reduce_expr->var_name = consume(TokenType::Variable, "Expected variable after 'as'").value;
     
     consume(TokenType::LeftParen, "Expected '('");
     reduce_expr->init_expr = parse_expression();
@@ -601,7 +646,7 @@ ExprPtr Parser::parse_foreach() {
     foreach_expr->reduce_iter_expr = parse_expression();
     
     consume(TokenType::As, "Expected 'as'");
-    // Parse variable pattern
+    foreach_expr->var_name = consume(TokenType::Variable, "Expected variable after 'as'").value;
     
     consume(TokenType::LeftParen, "Expected '('");
     foreach_expr->init_expr = parse_expression();
@@ -0,0 +1,260 @@
+#include "tq/projection.hpp"
+
+namespace tq {
+
+std::shared_ptr<const Projection> Projection::of(const Query& query) {
+    if (!query.root) {
+        return nullptr;
+    }
+    auto root = std::make_shared<Projection>();
+    Positions results;
+    analyze(query.root, {root.get()}, results);
+    read_whole(results);  // results are printed or handed back whole
+    if (root->whole_) {
+        return nullptr;
+    }
+    root->settle();
+    return root;
+}
+
+const Projection* Projection::elements(const Projection* p) {
+    if (!p || p->whole_) {
+        return nullptr;
+    }
+    // Elements nobody reads are still kept, as empty shells, so arrays keep
+    // their length
+    static const Projection nothing;
+    return p->elements_ ? p->elements_.get() : &nothing;
+}
+
+const Projection* Projection::field(Key key) const {
+    for (const auto& [name, child] : fields_) {
+        if (name == key) {
+            return child.get();
+        }
+    }
+    return values_.get();
+}
+
+Projection* Projection::child(Key key) {
+    for (auto& [name, child] : fields_) {
+        if (name == key) {
+            return child.get();
+        }
+    }
+    fields_.emplace_back(key, std::make_unique<Projection>());
+    return fields_.back().second.get();
+}
+
+Projection* Projection::values() {
+    if (!values_) {
+        values_ = std::make_unique<Projection>();
+    }
+    return values_.get();
+}
+
+Projection* Projection::elements() {
+    if (!elements_) {
+        elements_ = std::make_unique<Projection>();
+    }
+    return elements_.get();
+}
+
+void Projection::read_whole(const Positions& at) {
+    for (Projection* p : at) {
+        p->whole_ = true;
+    }
+}
+
+void Projection::analyze(const ExprPtr& expr, const Positions& in, Positions& out) {
+    if (!expr) {
+        out.insert(out.end(), in.begin(), in.end());
+        return;
+    }
+
+    // Reads what sub reads of the input, and all of what sub yields
+    auto consume = [&in](const ExprPtr& sub) {
+        Positions read;
+        analyze(sub, in, read);
+        read_whole(read);
+    };
+
+    switch (expr->type) {
+        case ExprType::Null:
+        case ExprType::Boolean:
+        case ExprType::Number:
+        case ExprType::String:
+        case ExprType::Variable:
+            return;  // nothing of the input
+
+        case ExprType::Identity:
+            out.insert(out.end(), in.begin(), in.end());
+            return;
+
+        case ExprType::Field:
+        case ExprType::OptionalField:
+            for (Projection* p : in) {
+                out.push_back(p->child(expr->field_key));
+            }
+            return;
+
+        case ExprType::Index:
+            for (Projection* p : in) {
+                out.push_back(p->elements());
+            }
+            return;
+
+        case ExprType::DynamicIndex: {
+            consume(expr->operand);
+            Positions bases;
+            analyze(expr->left, in, bases);
+            for (Projection* p : bases) {
+                out.push_back(p->elements());
+                out.push_back(p->values());
+            }
+            return;
+        }
+
+        case ExprType::Slice:
+            out.insert(out.end(), in.begin(), in.end());  // an array of the same elements
+            return;
+
+        case ExprType::Iterator:
+            for (Projection* p : in) {
+                out.push_back(p->elements());
+                out.push_back(p->values());
+            }
+            return;
+
+        case ExprType::Pipe: {
+            Positions middle;
+            analyze(expr->left, in, middle);
+            analyze(expr->right, middle, out);
+            return;
+        }
+
+        case ExprType::Comma:
+            analyze(expr->left, in, out);
+            analyze(expr->right, in, out);
+            return;
+
+        case ExprType::Array:
+            for (const auto& element : expr->array_elements) {
+                consume(element);
+            }
+            return;
+
+        case ExprType::Object:
+            for (const auto& field : expr->object_fields) {
+                consume(field.second);
+            }
+            return;
+
+        case ExprType::BinaryOp:
+            if (expr->op == TokenType::Alternative) {
+                // Either side comes out as it is; null and false are
+                // never projected away
+                analyze(expr->left, in, out);
+                analyze(expr->right, in, out);
+            } else {
+                consume(expr->left);
+                consume(expr->right);
+            }
+            return;
+
+        case ExprType::UnaryOp:
+            consume(expr->operand);
+            return;
+
+        case ExprType::If:
+            consume(expr->condition);
+            analyze(expr->then_branch, in, out);
+            for (const auto& [condition, body] : expr->elif_branches) {
+                consume(condition);
+                analyze(body, in, out);
+            }
+            if (expr->else_branch) {
+                analyze(expr->else_branch, in, out);
+            }
+            return;
+
+        case ExprType::Try:
+            analyze(expr->left, in, out);
+            analyze(expr->right, in, out);  // the handler runs on the same input
+            return;
+
+        case ExprType::FunctionCall: {
+            const std::string& name = expr->func_name;
+            size_t arity = expr->args.size();
+            if (name == "empty" && arity == 0) {
+                return;
+            }
+            if (name == "select" && arity == 1) {
+                consume(expr->args[0]);
+                out.insert(out.end(), in.begin(), in.end());
+                return;
+            }
+            if ((name == "first" || name == "last") && arity == 1) {
+                analyze(expr->args[0], in, out);
+                return;
+            }
+            if (name == "limit" && arity == 2) {
+                consume(expr->args[0]);
+                analyze(expr->args[1], in, out);
+                return;
+            }
+            if (name == "map" && arity == 1) {
+                Positions items;
+                for (Projection* p : in) {
+                    items.push_back(p->elements());
+                    items.push_back(p->values());
+                }
+                Positions mapped;
+                analyze(expr->args[0], items, mapped);
+                read_whole(mapped);
+                return;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    // Anything else may read all of its input: other builtins, assignment,
+    // reduce, foreach, `..`
+    read_whole(in);
+}
+
+void Projection::merge(const Projection& other) {
+    whole_ = whole_ || other.whole_;
+    for (const auto& [key, child] : other.fields_) {
+        this->child(key)->merge(*child);
+    }
+    if (other.values_) {
+        values()->merge(*other.values_);
+    }
+    if (other.elements_) {
+        elements()->merge(*other.elements_);
+    }
+}
+
+void Projection::settle() {
+    if (whole_) {
+        return;
+    }
+    for (auto& [key, child] : fields_) {
+        if (values_) {
+            child->merge(*values_);
+        }
+        child->settle();
+    }
+    if (values_) {
+        values_->settle();
+    }
+    if (elements_) {
+        elements_->settle();
+    }
+}
+
+} // namespace tq
@@ -0,0 +1,192 @@
+#include "tq/scanner.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TQ_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace tq {
+
+namespace {
+
+// Each backend fills out[0, count) from count full blocks starting at data
+using ScanFn = void (*)(const char* data, size_t count, ScanBlock* out);
+
+void scan_scalar(const char* data, size_t count, ScanBlock* out) {
+    for (size_t b = 0; b < count; ++b, data += 64) {
+        ScanBlock block{};
+        for (int i = 0; i < 64; ++i) {
+            uint64_t bit = uint64_t{1} << i;
+            switch (data[i]) {
+                case '\n': block.newline |= bit; break;
+                case ':': block.colon |= bit; break;
+                case '"': block.quote |= bit; break;
+                case '\\': block.escape |= bit; break;
+                case ',': case '|': case '\t': block.delimiter |= bit; break;
+                default: break;
+            }
+        }
+        out[b] = block;
+    }
+}
+
+#ifdef TQ_SCAN_X86
+
+// 16 bytes at a time; SSE2 would do, but SSE4.2 is the baseline the other
+// x86 backends are measured against
+__attribute__((target("sse4.2")))
+inline uint64_t match_sse42(const __m128i (&chunks)[4], char c) {
+    __m128i needle = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t bits = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], needle)));
+        mask |= static_cast<uint64_t>(bits) << (16 * i);
+    }
+    return mask;
+}
+
+__attribute__((target("sse4.2")))
+void scan_sse42(const char* data, size_t count, ScanBlock* out) {
+    for (size_t b = 0; b < count; ++b, data += 64) {
+        __m128i chunks[4];
+        for (int i = 0; i < 4; ++i) {
+            chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i));
+        }
+        out[b].newline = match_sse42(chunks, '\n');
+        out[b].colon = match_sse42(chunks, ':');
+        out[b].quote = match_sse42(chunks, '"');
+        out[b].escape = match_sse42(chunks, '\\');
+        out[b].delimiter = match_sse42(chunks, ',') | match_sse42(chunks, '|') | match_sse42(chunks, '\t');
+    }
+}
+
+__attribute__((target("avx2")))
+inline uint64_t match_avx2(__m256i lo, __m256i hi, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+    uint64_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+    uint64_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+    return low | (high << 32);
+}
+
+__attribute__((target("avx2")))
+void scan_avx2(const char* data, size_t count, ScanBlock* out) {
+    for (size_t b = 0; b < count; ++b, data += 64) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+        out[b].newline = match_avx2(lo, hi, '\n');
+        out[b].colon = match_avx2(lo, hi, ':');
+        out[b].quote = match_avx2(lo, hi, '"');
+        out[b].escape = match_avx2(lo, hi, '\\');
+        out[b].delimiter = match_avx2(lo, hi, ',') | match_avx2(lo, hi, '|') | match_avx2(lo, hi, '\t');
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline uint64_t match_avx512(__m512i block, char c) {
+    return _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(c));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void scan_avx512(const char* data, size_t count, ScanBlock* out) {
+    for (size_t b = 0; b < count; ++b, data += 64) {
+        __m512i block = _mm512_loadu_si512(data);
+        out[b].newline = match_avx512(block, '\n');
+        out[b].colon = match_avx512(block, ':');
+        out[b].quote = match_avx512(block, '"');
+        out[b].escape = match_avx512(block, '\\');
+        out[b].delimiter = match_avx512(block, ',') | match_avx512(block, '|') | match_avx512(block, '\t');
+    }
+}
+
+#endif  // TQ_SCAN_X86
+
+constexpr int kUnset = -1;
+std::atomic<int> g_backend{kUnset};
+
+ScanBackend best_backend() {
+    for (ScanBackend backend : {ScanBackend::AVX512, ScanBackend::AVX2, ScanBackend::SSE42}) {
+        if (StructuralScanner::supported(backend)) {
+            return backend;
+        }
+    }
+    return ScanBackend::Scalar;
+}
+
+ScanFn function(ScanBackend backend) {
+    switch (backend) {
+#ifdef TQ_SCAN_X86
+        case ScanBackend::SSE42: return scan_sse42;
+        case ScanBackend::AVX2: return scan_avx2;
+        case ScanBackend::AVX512: return scan_avx512;
+#endif
+        default: return scan_scalar;
+    }
+}
+
+} // namespace
+
+void StructuralScanner::scan(std::string_view text, size_t first, size_t count, ScanBlock* out) {
+    ScanFn fn = function(backend());
+    size_t full_blocks = text.size() / 64;
+    size_t full = first < full_blocks ? std::min(count, full_blocks - first) : 0;
+    fn(text.data() + first * 64, full, out);
+
+    // The partial last block, and any past the end, are scanned zero-padded
+    for (size_t b = full; b < count; ++b) {
+        char padded[64] = {};
+        size_t start = (first + b) * 64;
+        if (start < text.size()) {
+            std::memcpy(padded, text.data() + start, text.size() - start);
+        }
+        fn(padded, 1, out + b);
+    }
+}
+
+ScanBackend StructuralScanner::backend() {
+    int backend = g_backend.load(std::memory_order_relaxed);
+    if (backend == kUnset) {
+        backend = static_cast<int>(best_backend());
+        g_backend.store(backend, std::memory_order_relaxed);
+    }
+    return static_cast<ScanBackend>(backend);
+}
+
+bool StructuralScanner::supported(ScanBackend backend) {
+    switch (backend) {
+        case ScanBackend::Scalar: return true;
+#ifdef TQ_SCAN_X86
+        case ScanBackend::SSE42: return __builtin_cpu_supports("sse4.2");
+        case ScanBackend::AVX2: return __builtin_cpu_supports("avx2");
+        case ScanBackend::AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+        default: return false;
+    }
+}
+
+const char* StructuralScanner::name(ScanBackend backend) {
+    switch (backend) {
+        case ScanBackend::Scalar: return "scalar";
+        case ScanBackend::SSE42: return "sse4.2";
+        case ScanBackend::AVX2: return "avx2";
+        case ScanBackend::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+void StructuralScanner::force(ScanBackend backend) {
+    if (!supported(backend)) {
+        throw std::invalid_argument(std::string("Scan backend not supported here: ") + name(backend));
+    }
+    g_backend.store(static_cast<int>(backend), std::memory_order_relaxed);
+}
+
+void StructuralScanner::reset() {
+    g_backend.store(kUnset, std::memory_order_relaxed);
+}
+
+} // namespace tq
@@ -0,0 +1,103 @@
+#include "tq/shape.hpp"
+
+namespace tq {
+
+namespace {
+
+// Bounds the memory spent on shapes for documents whose key sets never repeat
+constexpr uint32_t kMaxShapes = uint32_t{1} << 20;
+
+std::atomic<uint32_t> g_shape_count{0};
+
+} // namespace
+
+Shape::Shape(uint32_t id, std::vector<Key> keys) : id_(id), keys_(std::move(keys)) {
+    if (keys_.size() < kIndexThreshold) {
+        return;
+    }
+
+    size_t capacity = 32;
+    while (capacity < keys_.size() * 4) {
+        capacity <<= 1;
+    }
+    index_.assign(capacity, 0);
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        size_t slot = keys_[i].hash() & (capacity - 1);
+        while (index_[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        index_[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+const Shape* Shape::empty() {
+    static const Shape* root = new Shape(g_shape_count++, {});
+    return root;
+}
+
+const Shape* Shape::with(Key key) const {
+    if (!key.interned()) {
+        return nullptr;  // shapes are process-wide; a key outside the atom table stays with its object
+    }
+    const Shape* child = last_child_.load(std::memory_order_acquire);
+    if (child && child->keys_.back() == key) {
+        return child;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Shape* candidate : children_) {
+        if (candidate->keys_.back() == key) {
+            last_child_.store(candidate, std::memory_order_release);
+            return candidate;
+        }
+    }
+
+    if (keys_.size() >= kMaxKeys || g_shape_count.load(std::memory_order_relaxed) >= kMaxShapes) {
+        return nullptr;
+    }
+
+    std::vector<Key> keys = keys_;
+    keys.push_back(key);
+    child = new Shape(g_shape_count.fetch_add(1, std::memory_order_relaxed), std::move(keys));
+    children_.push_back(child);
+    last_child_.store(child, std::memory_order_release);
+    return child;
+}
+
+const Shape* Shape::of(const std::vector<Key>& keys) {
+    const Shape* shape = empty();
+    for (Key key : keys) {
+        if (shape->slot(key) >= 0) {
+            return nullptr;  // a shape cannot repeat a key
+        }
+        shape = shape->with(key);
+        if (!shape) {
+            return nullptr;
+        }
+    }
+    return shape;
+}
+
+long Shape::slot(Key key) const {
+    if (index_.empty()) {
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            if (keys_[i] == key) {
+                return static_cast<long>(i);
+            }
+        }
+        return -1;
+    }
+
+    size_t mask = index_.size() - 1;
+    size_t slot = key.hash() & mask;
+    while (index_[slot] != 0) {
+        uint32_t position = index_[slot] - 1;
+        if (keys_[position] == key) {
+            return static_cast<long>(position);
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+} // namespace tq
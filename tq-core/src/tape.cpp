@@ -0,0 +1,689 @@
+#include "tq/tape.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tq {
+
+namespace {
+    constexpr uint64_t kPayloadMask = (uint64_t{1} << 56) - 1;
+    constexpr uint64_t kIndexMask = UINT32_MAX;
+    constexpr uint64_t kMaxCount = (uint64_t{1} << 23) - 1;  // saturated: count by walking
+    constexpr uint64_t kTableBit = uint64_t{1} << 55;
+
+    uint64_t make_word(char tag, uint64_t payload) {
+        return (static_cast<uint64_t>(static_cast<unsigned char>(tag)) << 56) | (payload & kPayloadMask);
+    }
+
+    char tag_of(uint64_t word) { return static_cast<char>(word >> 56); }
+    uint64_t payload_of(uint64_t word) { return word & kPayloadMask; }
+    size_t count_of(uint64_t word) { return static_cast<size_t>((word >> 32) & kMaxCount); }
+
+    // Index past the value starting at words[i]; containers must be closed
+    size_t end_of(const uint64_t* words, size_t i) {
+        switch (tag_of(words[i])) {
+            case '[': case '{': return static_cast<size_t>(words[i] & kIndexMask);
+            case 'l': case 'd': case 's': return i + 2;
+            default: return i + 1;
+        }
+    }
+    
+    // Snapshot layout: this header, the words, one uint32 length per key,
+    // the key names back to back, then the string buffer. Integers are
+    // stored in native byte order, which the header records.
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t words;
+        uint64_t keys;
+        uint64_t key_bytes;
+        uint64_t string_bytes;
+    };
+    static_assert(sizeof(SnapshotHeader) % sizeof(uint64_t) == 0, "words must stay aligned");
+    
+    constexpr char kSnapshotMagic[8] = {'T', 'Q', 'B', 'T', 'A', 'P', 'E', '\0'};
+    constexpr uint32_t kSnapshotVersion = 1;
+    constexpr uint32_t kByteOrder = 0x01020304;
+    
+    // A mapped snapshot is checked as it is read, so damage shows up here
+    // rather than as a read outside the file
+    [[noreturn]] void corrupt() {
+        throw std::runtime_error("Corrupt snapshot");
+    }
+    
+    // Index + 1 of key in keys, 0 if absent: by atom through ids, or for the
+    // rare key outside the atom table by scanning keys
+    uint32_t find_key(const std::vector<Key>& keys, const std::vector<uint32_t>& ids, Key key) {
+        if (key.interned()) {
+            return key.atom() < ids.size() ? ids[key.atom()] : 0;
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) {
+                return static_cast<uint32_t>(i + 1);
+            }
+        }
+        return 0;
+    }
+}
+
+// Bytes of a snapshot file: mapped where the platform allows, read otherwise
+struct Tape::Mapping {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<uint64_t> buffer;
+    
+    ~Mapping() {
+#ifndef _WIN32
+        if (data && buffer.empty()) {
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+    }
+};
+
+// Builder
+
+void Tape::Builder::push(char tag, uint64_t payload) {
+    words_.push_back(make_word(tag, payload));
+}
+
+void Tape::Builder::element() {
+    if (!frames_.empty() && tag_of(words_[frames_.back().start]) == '[') {
+        frames_.back().count++;
+    }
+}
+
+void Tape::Builder::null() {
+    element();
+    push('n');
+}
+
+void Tape::Builder::boolean(bool b) {
+    element();
+    push(b ? 't' : 'f');
+}
+
+void Tape::Builder::integer(int64_t i) {
+    element();
+    push('l');
+    words_.push_back(static_cast<uint64_t>(i));
+}
+
+void Tape::Builder::number(double d) {
+    element();
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    push('d');
+    words_.push_back(bits);
+}
+
+void Tape::Builder::string(std::string_view s) {
+    element();
+    push('s', strings_.size());
+    words_.push_back(s.size());
+    strings_.append(s);
+}
+
+void Tape::Builder::begin_array() {
+    element();
+    frames_.push_back({words_.size()});
+    push('[');
+}
+
+void Tape::Builder::begin_object() {
+    element();
+    frames_.push_back({words_.size(), 0, open_keys_.size()});
+    push('{');
+}
+
+void Tape::Builder::key(Key key) {
+    uint32_t found = find_key(keys_, key_ids_, key);
+    if (found == 0) {
+        keys_.push_back(key);
+        found = static_cast<uint32_t>(keys_.size());
+        if (key.interned()) {
+            if (key.atom() >= key_ids_.size()) {
+                key_ids_.resize(key.atom() + 1, 0);
+            }
+            key_ids_[key.atom()] = found;
+        }
+    }
+    uint32_t id = found - 1;
+    
+    Frame& frame = frames_.back();
+    for (size_t i = frame.keys; i < open_keys_.size(); ++i) {
+        if (open_keys_[i].first == id) {
+            words_[open_keys_[i].second] = make_word('x', id);
+            open_keys_[i].second = words_.size();
+            frame.repeated = true;
+            push('k', id);
+            return;
+        }
+    }
+    frame.count++;
+    open_keys_.emplace_back(id, words_.size());
+    push('k', id);
+}
+
+void Tape::Builder::close(char tag) {
+    Frame frame = frames_.back();
+    frames_.pop_back();
+    if (frame.repeated) {
+        merge_repeated(frame.start);
+    }
+    if (words_.size() + 1 > kIndexMask) {
+        throw std::length_error("Document too large for a tape");
+    }
+    uint64_t count = frame.count < kMaxCount ? frame.count : kMaxCount;
+    words_[frame.start] |= (count << 32) | (words_.size() + 1);
+    push(tag, frame.start);
+    if (tag == '}') {
+        open_keys_.resize(frame.keys);
+    }
+}
+
+// A repeated key keeps the position it first had and the value it last
+// had, as in Object: each live field moves up to its key's first 'x', and
+// the values it replaced are dropped. Moved containers get their end and
+// start indices shifted with them.
+void Tape::Builder::merge_repeated(size_t start) {
+    struct Field {
+        uint64_t id;
+        size_t begin;  // the key word
+        size_t end;
+    };
+    std::vector<Field> fields;
+    std::unordered_map<uint64_t, size_t> live;  // key index -> field holding its value
+    for (size_t i = start + 1; i < words_.size(); ) {
+        size_t end = end_of(words_.data(), i + 1);
+        if (tag_of(words_[i]) == 'k') {
+            live[payload_of(words_[i])] = fields.size();
+        }
+        fields.push_back({payload_of(words_[i]), i, end});
+        i = end;
+    }
+
+    std::vector<uint64_t> merged;
+    merged.reserve(words_.size() - start - 1);
+    for (const Field& field : fields) {
+        auto found = live.find(field.id);
+        if (found == live.end()) {
+            continue;  // placed already
+        }
+        const Field& from = fields[found->second];
+        live.erase(found);
+        size_t to = start + 1 + merged.size();
+        auto shift = [&](uint64_t index) { return index - from.begin + to; };
+        merged.push_back(words_[from.begin]);
+        for (size_t j = from.begin + 1; j < from.end; ) {
+            uint64_t w = words_[j];
+            switch (tag_of(w)) {
+                case '[': case '{':
+                    merged.push_back((w & ~kIndexMask) | shift(w & kIndexMask));
+                    j++;
+                    break;
+                case ']': case '}':
+                    merged.push_back(make_word(tag_of(w), shift(payload_of(w))));
+                    j++;
+                    break;
+                case 'l': case 'd': case 's':
+                    merged.push_back(w);
+                    merged.push_back(words_[j + 1]);
+                    j += 2;
+                    break;
+                default:
+                    merged.push_back(w);
+                    j++;
+                    break;
+            }
+        }
+    }
+    words_.resize(start + 1);
+    words_.insert(words_.end(), merged.begin(), merged.end());
+}
+
+void Tape::Builder::end_array(bool table) {
+    size_t start = frames_.back().start;
+    close(']');
+    if (table) {
+        words_[start] |= kTableBit;
+    }
+}
+
+void Tape::Builder::end_object() {
+    close('}');
+}
+
+void Tape::Builder::reserve(size_t words, size_t string_bytes) {
+    words_.reserve(words);
+    strings_.reserve(string_bytes);
+}
+
+Tape Tape::Builder::finish() {
+    if (words_.empty()) {
+        push('n');
+    }
+    return Tape(std::move(words_), std::move(strings_), std::move(keys_));
+}
+
+// Tape
+
+Tape::Tape(std::vector<uint64_t> words, std::string strings, std::vector<Key> keys)
+    : keys_(std::move(keys)), owned_words_(std::move(words)) {
+    words_ = owned_words_.data();
+    word_count_ = owned_words_.size();
+    owned_strings_.emplace(std::move(strings));
+    strings_ = owned_strings_->view();
+    index_keys();
+}
+
+Tape::Tape(Tape&&) noexcept = default;
+Tape& Tape::operator=(Tape&&) noexcept = default;
+Tape::~Tape() = default;
+
+void Tape::index_keys() {
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        if (!keys_[i].interned()) {
+            continue;
+        }
+        Atom atom = keys_[i].atom();
+        if (atom >= key_ids_.size()) {
+            key_ids_.resize(atom + 1, 0);
+        }
+        key_ids_[atom] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+uint32_t Tape::key_id(Key key) const {
+    return find_key(keys_, key_ids_, key);
+}
+
+Value Tape::to_value() const {
+    return root().to_value();
+}
+
+void Tape::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+    
+    std::vector<uint32_t> lengths;
+    std::string names;
+    for (const Key& key : keys_) {
+        const std::string& name = key.str();
+        lengths.push_back(static_cast<uint32_t>(name.size()));
+        names += name;
+    }
+    
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof header.magic);
+    header.version = kSnapshotVersion;
+    header.byte_order = kByteOrder;
+    header.words = word_count_;
+    header.keys = keys_.size();
+    header.key_bytes = names.size();
+    header.string_bytes = strings_.size();
+    
+    file.write(reinterpret_cast<const char*>(&header), sizeof header);
+    file.write(reinterpret_cast<const char*>(words_), static_cast<std::streamsize>(word_count_ * sizeof(uint64_t)));
+    file.write(reinterpret_cast<const char*>(lengths.data()), static_cast<std::streamsize>(lengths.size() * sizeof(uint32_t)));
+    file.write(names.data(), static_cast<std::streamsize>(names.size()));
+    file.write(strings_.data(), static_cast<std::streamsize>(strings_.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to write snapshot: " + path);
+    }
+}
+
+Tape Tape::load(const std::string& path) {
+    auto mapping = std::make_unique<Mapping>();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a tq snapshot: " + path);
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+    mapping->data = static_cast<const char*>(data);
+    mapping->size = size;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    size_t size = static_cast<size_t>(file.tellg());
+    mapping->buffer.resize(size / sizeof(uint64_t) + 1);  // words must be aligned
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(mapping->buffer.data()), static_cast<std::streamsize>(size));
+    mapping->data = reinterpret_cast<const char*>(mapping->buffer.data());
+    mapping->size = size;
+#endif
+    
+    try {
+        return Tape(std::move(mapping));
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(e.what() + (": " + path));
+    }
+}
+
+// Points into a snapshot. Only the header, the section sizes and the key
+// names are checked here; TapeRef checks each word it follows, so a query
+// reads no more of the file than it touches.
+Tape::Tape(std::unique_ptr<Mapping> mapping) : mapping_(std::move(mapping)) {
+    const char* data = mapping_->data;
+    size_t size = mapping_->size;
+    
+    SnapshotHeader header;
+    if (size < sizeof header) {
+        throw std::runtime_error("Not a tq snapshot");
+    }
+    std::memcpy(&header, data, sizeof header);
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof header.magic) != 0) {
+        throw std::runtime_error("Not a tq snapshot");
+    }
+    if (header.version != kSnapshotVersion || header.byte_order != kByteOrder) {
+        throw std::runtime_error("Snapshot written by an incompatible version or byte order");
+    }
+    
+    size_t offset = sizeof header;
+    auto section = [&](uint64_t count, size_t unit) {
+        if (count > (size - offset) / unit) {
+            throw std::runtime_error("Truncated snapshot");
+        }
+        const char* start = data + offset;
+        offset += static_cast<size_t>(count) * unit;
+        return start;
+    };
+    const char* words = section(header.words, sizeof(uint64_t));
+    const char* lengths = section(header.keys, sizeof(uint32_t));
+    const char* names = section(header.key_bytes, 1);
+    const char* strings = section(header.string_bytes, 1);
+    if (header.words == 0) {
+        throw std::runtime_error("Truncated snapshot");
+    }
+    
+    words_ = reinterpret_cast<const uint64_t*>(words);
+    word_count_ = static_cast<size_t>(header.words);
+    strings_ = std::string_view(strings, static_cast<size_t>(header.string_bytes));
+    
+    // Keys are renumbered per tape, so only their names need interning
+    keys_.reserve(static_cast<size_t>(header.keys));
+    size_t name_offset = 0;
+    for (size_t i = 0; i < header.keys; ++i) {
+        uint32_t length;
+        std::memcpy(&length, lengths + i * sizeof length, sizeof length);
+        if (length > header.key_bytes - name_offset) {
+            throw std::runtime_error("Truncated snapshot");
+        }
+        keys_.emplace_back(std::string_view(names + name_offset, length));
+        name_offset += length;
+    }
+    index_keys();
+}
+
+// TapeRef
+
+Value::Type TapeRef::type() const {
+    switch (tag_of(word())) {
+        case 'n': return Value::Type::Null;
+        case 't': case 'f': return Value::Type::Boolean;
+        case 'l': case 'd': return Value::Type::Number;
+        case 's': return Value::Type::String;
+        case '[': return Value::Type::Array;
+        case '{': return Value::Type::Object;
+        default: corrupt();
+    }
+}
+
+size_t TapeRef::end() const {
+    const uint64_t* words = tape_->words_;
+    uint64_t w = word();
+    switch (tag_of(w)) {
+        case '[': case '{': {
+            // The matching close lies on the tape and points back here
+            size_t end = static_cast<size_t>(w & kIndexMask);
+            if (end <= index_ + 1 || end > tape_->word_count_ ||
+                tag_of(words[end - 1]) != (tag_of(w) == '[' ? ']' : '}') || payload_of(words[end - 1]) != index_) {
+                corrupt();
+            }
+            return end;
+        }
+        case 'l': case 'd': case 's':
+            if (index_ + 2 > tape_->word_count_) {
+                corrupt();
+            }
+            return index_ + 2;
+        case 'n': case 't': case 'f':
+            return index_ + 1;
+        default:
+            corrupt();
+    }
+}
+
+size_t TapeRef::member_end(size_t i, size_t close) const {
+    if (tag_of(word()) == '{') {
+        char tag = tag_of(tape_->words_[i]);
+        if ((tag != 'k' && tag != 'x') || i + 1 >= close) {
+            corrupt();
+        }
+        i++;
+    }
+    size_t end = TapeRef(tape_, i).end();
+    if (end > close) {
+        corrupt();
+    }
+    return end;
+}
+
+size_t TapeRef::size() const {
+    uint64_t w = word();
+    char tag = tag_of(w);
+    if (tag != '[' && tag != '{') {
+        return 0;
+    }
+    if (count_of(w) < kMaxCount) {
+        return count_of(w);
+    }
+    std::vector<TapeRef> items;
+    children(items);
+    return items.size();
+}
+
+TapeRef TapeRef::get(Key key) const {
+    if (tag_of(word()) != '{') {
+        return TapeRef();
+    }
+    uint32_t id = tape_->key_id(key);
+    if (id == 0) {
+        return TapeRef();
+    }
+    const uint64_t* words = tape_->words_;
+    uint64_t wanted = make_word('k', id - 1);
+    size_t close = end() - 1;
+    for (size_t i = index_ + 1; i < close; ) {
+        size_t next = member_end(i, close);
+        if (words[i] == wanted) {
+            return TapeRef(tape_, i + 1);
+        }
+        i = next;
+    }
+    return TapeRef();
+}
+
+TapeRef TapeRef::get(size_t index) const {
+    if (tag_of(word()) != '[' || index >= size()) {
+        return TapeRef();
+    }
+    size_t close = end() - 1;
+    size_t i = index_ + 1;
+    for (size_t n = 0; n < index; ++n) {
+        if (i >= close) {
+            corrupt();  // fewer elements than the count says
+        }
+        i = member_end(i, close);
+    }
+    if (i >= close) {
+        corrupt();
+    }
+    return TapeRef(tape_, i);
+}
+
+void TapeRef::children(std::vector<TapeRef>& out) const {
+    const uint64_t* words = tape_->words_;
+    char tag = tag_of(word());
+    if (tag != '[' && tag != '{') {
+        return;
+    }
+    size_t close = end() - 1;
+    for (size_t i = index_ + 1; i < close; ) {
+        size_t next = member_end(i, close);
+        if (tag == '[') {
+            out.emplace_back(tape_, i);
+        } else if (tag_of(words[i]) == 'k') {
+            out.emplace_back(tape_, i + 1);
+        }
+        i = next;
+    }
+}
+
+void TapeRef::descendants(std::vector<TapeRef>& out) const {
+    // Document order is the order `..` visits values in, so this is one
+    // pass over the words
+    const uint64_t* words = tape_->words_;
+    size_t stop = end();
+    for (size_t i = index_; i < stop; ) {
+        switch (tag_of(words[i])) {
+            case 'k': case ']': case '}':
+                i++;
+                break;
+            case 'x':
+                if (i + 1 >= stop) {
+                    corrupt();
+                }
+                i = TapeRef(tape_, i + 1).end();
+                break;
+            case '[': case '{':
+                out.emplace_back(tape_, i);
+                i++;
+                break;
+            default: {
+                TapeRef value(tape_, i);
+                out.push_back(value);
+                i = value.end();
+                break;
+            }
+        }
+    }
+}
+
+Key TapeRef::key_at(size_t index) const {
+    uint64_t id = payload_of(tape_->words_[index]);
+    if (id >= tape_->keys_.size()) {
+        corrupt();
+    }
+    return tape_->keys_[id];
+}
+
+Value TapeRef::to_value() const {
+    const uint64_t* words = tape_->words_;
+    uint64_t w = word();
+    switch (tag_of(w)) {
+        case 't': return Value(true);
+        case 'f': return Value(false);
+        case 'l': end(); return Value(static_cast<int64_t>(words[index_ + 1]));
+        case 'd': {
+            end();
+            double d;
+            std::memcpy(&d, &words[index_ + 1], sizeof d);
+            return Value(d);
+        }
+        case 's': {
+            end();
+            uint64_t offset = payload_of(w);
+            uint64_t length = words[index_ + 1];
+            if (offset > tape_->strings_.size() || length > tape_->strings_.size() - offset) {
+                corrupt();
+            }
+            std::string_view text = tape_->strings_.substr(offset, length);
+            return tape_->owned_strings_ ? tape_->owned_strings_->slice(text) : Value(std::string(text));
+        }
+        case '[': {
+            std::vector<TapeRef> items;
+            items.reserve(std::min(size(), end() - index_));
+            children(items);
+            if (!(w & kTableBit) || items.empty()) {
+                std::vector<Value> values;
+                values.reserve(items.size());
+                for (const auto& item : items) {
+                    values.push_back(item.to_value());
+                }
+                return Value(std::move(values));
+            }
+
+            // Header rows: same keys in the same order, so read them off the first
+            std::vector<Key> keys;
+            const TapeRef& first = items.front();
+            if (tag_of(first.word()) != '{') {
+                corrupt();
+            }
+            size_t first_close = first.end() - 1;
+            for (size_t i = first.index_ + 1; i < first_close; i = first.member_end(i, first_close)) {
+                keys.push_back(key_at(i));
+            }
+            std::vector<std::vector<Value>> columns(keys.size());
+            for (auto& column : columns) {
+                column.reserve(items.size());
+            }
+            std::vector<TapeRef> cells;
+            for (const auto& item : items) {
+                cells.clear();
+                item.children(cells);
+                if (tag_of(item.word()) != '{' || cells.size() != columns.size()) {
+                    corrupt();
+                }
+                for (size_t c = 0; c < columns.size(); ++c) {
+                    columns[c].push_back(cells[c].to_value());
+                }
+            }
+            return Value::table(std::move(keys), std::move(columns));
+        }
+        case '{': {
+            Object obj;
+            size_t close = end() - 1;
+            obj.reserve(std::min(size(), close - index_));
+            for (size_t i = index_ + 1; i < close; ) {
+                size_t next = member_end(i, close);
+                if (tag_of(words[i]) == 'k') {
+                    obj.insert_or_assign(key_at(i), TapeRef(tape_, i + 1).to_value());
+                }
+                i = next;
+            }
+            return Value(std::move(obj));
+        }
+        case 'n':
+            return Value();
+        default:
+            corrupt();
+    }
+}
+
+} // namespace tq
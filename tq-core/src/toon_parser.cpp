@@ -1,48 +1,56 @@
 #include "tq/toon_parser.hpp"
-#include <sstream>
+#include "tq/projection.hpp"
+#include "tq/scanner.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
 #include <cmath>
+#include <cstring>
+#include <exception>
+#include <iterator>
 #include <limits>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
 namespace tq {
 
 // Parse a complete TOON document
-Value ToonParser::parse(const std::string& content) {
-    std::vector<std::string> lines = split_lines(content);
-    if (lines.empty()) {
-        return Value(std::map<std::string, Value>{});  // Empty input is empty object
+Value ToonParser::parse(std::string content, Arena* arena, unsigned threads, const Projection* projection) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
     }
+    Context ctx(std::move(content), arena, threads);
     
-    Context ctx;
-    ctx.lines = lines;
-    ctx.current_line = 0;
-    ctx.indent_size = 2;  // Default indent
+    if (ctx.line_count == 0) {
+        return Value(Object(ctx.arena), ctx.arena);  // Empty input is empty object
+    }
     
-    // Check if root is an array
-    if (!lines.empty()) {
-        std::string first_content_line = get_line_content(lines[0]);
-        if (is_array_header(first_content_line)) {
-            return parse_root_array(ctx);
-        }
+    // Check if root is an array (a keyed header is an ordinary object field)
+    std::string_view first_content_line = ctx.content(0);
+    if (is_array_header(first_content_line) && first_content_line[0] == '[') {
+        return parse_root_array(ctx, projection);
     }
     
     // Check if root is single primitive
-    if (lines.size() == 1) {
-        std::string line_content = get_line_content(lines[0]);
-        if (line_content.find(':') == std::string::npos) {
-            return parse_primitive(line_content);
+    if (ctx.line_count == 1) {
+        if (first_content_line.find(':') == std::string_view::npos) {
+            return parse_primitive(ctx, first_content_line);
         }
     }
     
     // Root is an object
-    return parse_object_fields(ctx, 0);
+    return parse_object_fields(ctx, 0, projection);
 }
 
-// Parse object fields at a given depth level
-Value ToonParser::parse_object_fields(Context& ctx, int base_depth) {
-    std::map<std::string, Value> obj;
+// Parse object fields at a given depth level. A field p never reads is
+// passed over with the deeper lines below it, undecoded.
+Value ToonParser::parse_object_fields(Context& ctx, int base_depth, const Projection* p) {
+    Object obj(ctx.arena);
     
-    while (ctx.current_line < ctx.lines.size()) {
-        int depth = get_line_depth(ctx.lines[ctx.current_line], ctx.indent_size);
+    while (ctx.current_line < ctx.line_count) {
+        int depth = ctx.depth(ctx.current_line);
         
         // Stop if we've moved to a shallower depth
         if (depth < base_depth) {
@@ -54,234 +62,387 @@ Value ToonParser::parse_object_fields(Context& ctx, int base_depth) {
             break;
         }
         
-        std::string content = get_line_content(ctx.lines[ctx.current_line]);
+        std::string_view content = ctx.content(ctx.current_line);
         if (content.empty() || content[0] == '-') {
             break;  // Not an object field
         }
         
         // Parse the key-value pair
-        size_t colon_pos = find_unquoted_colon(content);
-        if (colon_pos == std::string::npos) {
+        size_t colon_pos = ctx.find_colon(content);
+        if (colon_pos == std::string_view::npos) {
             break;  // Not a valid key-value line
         }
         
-        std::string key_part = content.substr(0, colon_pos);
-        std::string value_part = content.substr(colon_pos + 1);
-        trim(key_part);
-        trim(value_part);
+        std::string_view key_part = trim(content.substr(0, colon_pos));
+        std::string_view value_part = trim(content.substr(colon_pos + 1));
         
         // Check for array header: key[n]: or key[n]{fields}:
-        if (is_array_header(content)) {
-            ArrayHeader header = parse_array_header(content);
-            ctx.current_line++;
-            
-            Value array_value(std::vector<Value>{});
+        bool array = is_array_header(content);
+        ArrayHeader header;
+        if (array) {
+            header = parse_array_header(content);
+        }
+        Key key = array ? Key(header.key) : ctx.key(key_part);
+        ctx.current_line++;
+        
+        if (Projection::skips(p, key)) {
+            while (ctx.current_line < ctx.line_count && ctx.depth(ctx.current_line) > base_depth) {
+                ctx.current_line++;
+            }
+            continue;
+        }
+        const Projection* field_p = Projection::field(p, key);
+        
+        if (array) {
+            Value array_value;
             if (!value_part.empty()) {
                 // Inline primitive array
-                array_value = parse_inline_array(value_part, header.length, header.delimiter);
+                array_value = parse_inline_array(ctx, value_part, header.length, header.delimiter);
             } else if (!header.fields.empty()) {
                 // Tabular array
-                array_value = parse_tabular_array(ctx, base_depth + 1, header);
+                array_value = parse_tabular_array(ctx, base_depth + 1, header, field_p);
             } else {
                 // List array
-                array_value = parse_list_array(ctx, base_depth + 1, header.length);
+                array_value = parse_list_array(ctx, base_depth + 1, header.length, field_p);
             }
             
-            obj[header.key] = std::move(array_value);
+            obj[key] = std::move(array_value);
+        } else if (value_part.empty()) {
+            // Nested object
+            Value nested = parse_object_fields(ctx, base_depth + 1, field_p);
+            obj[key] = std::move(nested);
         } else {
-            // Regular key-value
-            std::string key = parse_key(key_part);
-            ctx.current_line++;
-            
-            if (value_part.empty()) {
-                // Nested object
-                Value nested = parse_object_fields(ctx, base_depth + 1);
-                obj[key] = std::move(nested);
-            } else {
-                // Inline primitive value
-                obj[key] = parse_primitive(value_part);
-            }
+            // Inline primitive value
+            obj[key] = parse_primitive(ctx, value_part);
         }
     }
     
-    return Value(std::move(obj));
+    return Value(std::move(obj), ctx.arena);
 }
 
 // Parse root-level array
-Value ToonParser::parse_root_array(Context& ctx) {
-    std::string content = get_line_content(ctx.lines[0]);
+Value ToonParser::parse_root_array(Context& ctx, const Projection* p) {
+    std::string_view content = ctx.content(0);
     ArrayHeader header = parse_array_header(content);
     ctx.current_line = 1;
+    const Projection* array_p = header.key.empty() ? p : Projection::field(p, Key(header.key));
     
     Value array_value;
     
     // Check for inline values
-    size_t colon_pos = find_unquoted_colon(content);
-    if (colon_pos != std::string::npos) {
-        std::string after_colon = content.substr(colon_pos + 1);
-        trim(after_colon);
+    size_t colon_pos = ctx.find_colon(content);
+    if (colon_pos != std::string_view::npos) {
+        std::string_view after_colon = trim(content.substr(colon_pos + 1));
         if (!after_colon.empty()) {
-            array_value = parse_inline_array(after_colon, header.length, header.delimiter);
+            array_value = parse_inline_array(ctx, after_colon, header.length, header.delimiter);
         }
     }
     
     if (array_value.is_null()) {
         if (!header.fields.empty()) {
-            array_value = parse_tabular_array(ctx, 1, header);
+            array_value = parse_tabular_array(ctx, 1, header, array_p);
         } else {
-            array_value = parse_list_array(ctx, 1, header.length);
+            array_value = parse_list_array(ctx, 1, header.length, array_p);
         }
     }
     
     // If the array header has a key, wrap it in an object
     if (!header.key.empty()) {
-        std::map<std::string, Value> obj;
+        Object obj(ctx.arena);
         obj[header.key] = std::move(array_value);
-        return Value(std::move(obj));
+        return Value(std::move(obj), ctx.arena);
     }
     
     return array_value;
 }
 
 // Parse inline primitive array (e.g., [3]: 1, 2, 3)
-Value ToonParser::parse_inline_array(const std::string& values_str, int expected_length, char delimiter) {
+Value ToonParser::parse_inline_array(const Context& ctx, std::string_view values_str, int expected_length, char delimiter) {
     std::vector<Value> items;
-    std::vector<std::string> parts = split_delimited(values_str, delimiter);
+    std::vector<std::string_view> parts;
+    ctx.split(values_str, delimiter, parts);
+    items.reserve(parts.size());
     
-    for (const auto& part : parts) {
-        std::string trimmed = part;
-        trim(trimmed);
+    for (std::string_view part : parts) {
+        std::string_view trimmed = trim(part);
         if (!trimmed.empty()) {
-            items.push_back(parse_primitive(trimmed));
+            items.push_back(parse_primitive(ctx, trimmed));
         }
     }
     
-    return Value(std::move(items));
+    return Value(std::move(items), ctx.arena);
 }
 
-// Parse tabular array (rows with delimited values)
-Value ToonParser::parse_tabular_array(Context& ctx, int item_depth, const ArrayHeader& header) {
-    std::vector<Value> items;
+template <typename Work>
+void ToonParser::for_each_range(Context& ctx, size_t count, Work work) {
+    if (ctx.threads <= 1 || count < kParallelRows) {
+        work(ctx, 0, count);
+        return;
+    }
     
-    while (ctx.current_line < ctx.lines.size() && items.size() < static_cast<size_t>(header.length)) {
-        int depth = get_line_depth(ctx.lines[ctx.current_line], ctx.indent_size);
-        
-        if (depth < item_depth) {
-            break;
+    size_t ranges = (count + kRangeRows - 1) / kRangeRows;
+    unsigned threads = static_cast<unsigned>(std::min<size_t>(ctx.threads, ranges));
+    std::vector<Arena*> arenas(threads, ctx.arena);
+    for (unsigned t = 1; t < threads && ctx.arena; ++t) {
+        arenas[t] = ctx.arena->fork();
+    }
+    
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto run = [&](unsigned t) {
+        try {
+            Context worker(ctx, arenas[t]);
+            for (size_t range = next++; range < ranges; range = next++) {
+                size_t begin = range * kRangeRows;
+                work(worker, begin, std::min(count, begin + kRangeRows));
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            next = ranges;  // the rest of the work is moot
         }
-        
-        if (depth == item_depth) {
-            std::string content = get_line_content(ctx.lines[ctx.current_line]);
-            std::vector<std::string> values = split_delimited(content, header.delimiter);
-            
-            std::map<std::string, Value> obj;
-            for (size_t i = 0; i < header.fields.size() && i < values.size(); i++) {
-                std::string val = values[i];
-                trim(val);
-                obj[header.fields[i]] = parse_primitive(val);
+    };
+    
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        try {
+            pool.emplace_back(run, t);
+        } catch (const std::system_error&) {
+            break;  // no more threads to be had: the ones running take the ranges left
+        }
+    }
+    run(0);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Parse tabular array (rows with delimited values). Rows are stored
+// column-wise unless a row is short or the header repeats a field. Columns
+// the rows' projection never reads are not converted.
+Value ToonParser::parse_tabular_array(Context& ctx, int item_depth, const ArrayHeader& header, const Projection* p) {
+    size_t width = header.fields.size();
+    const Projection* row_p = Projection::elements(p);
+    std::vector<size_t> kept;  // the columns rows keep, in header order
+    std::vector<Key> kept_keys;
+    for (size_t i = 0; i < width; i++) {
+        if (!Projection::skips(row_p, header.field_keys[i])) {
+            kept.push_back(i);
+            kept_keys.push_back(header.field_keys[i]);
+        }
+    }
+    std::vector<Key> sorted_keys = kept_keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    bool columnar = !kept.empty() && std::adjacent_find(sorted_keys.begin(), sorted_keys.end()) == sorted_keys.end();
+    
+    // One row per line at item_depth, up to the announced count
+    size_t first = ctx.current_line;
+    size_t end = first;
+    size_t limit = header.length < 0 ? ctx.line_count : first + ctx.rows_left(header.length);
+    while (end < limit && ctx.depth(end) == item_depth) {
+        end++;
+    }
+    size_t rows = end - first;
+    ctx.current_line = end;
+    
+    // Every row has its slot, so ranges of rows can be decoded independently
+    std::vector<std::vector<Value>> columns(columnar ? kept.size() : 0);
+    for (auto& column : columns) {
+        column.resize(rows);
+    }
+    std::vector<Value> items(columnar ? 0 : rows);  // row objects, when the table cannot be columnar
+    std::vector<std::pair<size_t, Value>> short_rows;  // rows of a columnar table with missing fields
+    std::mutex short_rows_mutex;
+    
+    for_each_range(ctx, rows, [&](Context& worker, size_t row, size_t row_end) {
+        std::vector<std::string_view> values;  // reused for every row
+        values.reserve(width);
+        for (; row < row_end; ++row) {
+            worker.split(worker.content(first + row), header.delimiter, values);
+            if (columnar && values.size() >= width) {
+                for (size_t c = 0; c < kept.size(); c++) {
+                    columns[c][row] = parse_primitive(worker, trim(values[kept[c]]));
+                }
+                continue;
             }
             
-            items.push_back(Value(std::move(obj)));
-            ctx.current_line++;
-        } else {
-            break;
+            Object obj(worker.arena);
+            obj.reserve(kept.size());
+            for (size_t i : kept) {
+                if (i >= values.size()) {
+                    break;
+                }
+                obj.insert_or_assign(header.field_keys[i], parse_primitive(worker, trim(values[i])));
+            }
+            if (columnar) {
+                std::lock_guard<std::mutex> lock(short_rows_mutex);
+                short_rows.emplace_back(row, Value(std::move(obj), worker.arena));
+            } else {
+                items[row] = Value(std::move(obj), worker.arena);
+            }
         }
-    }
+    });
     
-    return Value(std::move(items));
+    if (columnar && short_rows.empty()) {
+        return Value::table(kept_keys, std::move(columns), ctx.arena);
+    }
+    if (columnar) {
+        // Full rows become row objects of the table, short ones keep theirs
+        items = Value::table(kept_keys, std::move(columns)).as_array();
+        for (auto& [row, obj] : short_rows) {
+            items[row] = std::move(obj);
+        }
+    }
+    return Value(std::move(items), ctx.arena);
 }
 
 // Parse list array (items starting with -)
-Value ToonParser::parse_list_array(Context& ctx, int item_depth, int expected_length) {
-    std::vector<Value> items;
+Value ToonParser::parse_list_array(Context& ctx, int item_depth, int expected_length, const Projection* p) {
+    size_t count = expected_length < 0 ? SIZE_MAX : static_cast<size_t>(expected_length);
+    
+    // Where each item starts: a dash line at item_depth. Items may span any
+    // number of deeper lines, so ranges of items are cut at these lines.
+    std::vector<size_t> starts;
+    if (ctx.threads > 1 && ctx.rows_left(expected_length) >= kParallelRows) {
+        for (size_t line = ctx.current_line; line < ctx.line_count && starts.size() < count; ++line) {
+            int depth = ctx.depth(line);
+            if (depth < item_depth) {
+                break;
+            }
+            if (depth == item_depth) {
+                std::string_view content = ctx.content(line);
+                if (content.empty() || content[0] != '-') {
+                    break;
+                }
+                starts.push_back(line);
+            }
+        }
+    }
+    if (starts.size() < kParallelRows) {
+        ListItems items;
+        items.expected = ctx.rows_left(expected_length);
+        parse_list_items(ctx, item_depth, count, items, p);
+        return items.finish(ctx.arena);
+    }
+    
+    // Each range parses its items as the sequential parser would; a range
+    // that stops short of the next one ends the array there, as a malformed
+    // item would have on one thread
+    size_t ranges = (starts.size() + kRangeRows - 1) / kRangeRows;
+    std::vector<ListItems> parts(ranges);
+    std::vector<size_t> part_end(ranges);
+    for_each_range(ctx, starts.size(), [&](Context& worker, size_t item, size_t item_end) {
+        size_t part = item / kRangeRows;
+        worker.current_line = starts[item];
+        parts[part].expected = item_end - item;
+        parse_list_items(worker, item_depth, item_end - item, parts[part], p);
+        part_end[part] = worker.current_line;
+    });
     
-    while (ctx.current_line < ctx.lines.size() && items.size() < static_cast<size_t>(expected_length)) {
-        int depth = get_line_depth(ctx.lines[ctx.current_line], ctx.indent_size);
+    ListItems items;
+    for (size_t part = 0; part < ranges; ++part) {
+        items.append(std::move(parts[part]));
+        ctx.current_line = part_end[part];
+        size_t next = (part + 1) * kRangeRows;
+        if (next < starts.size() && part_end[part] != starts[next]) {
+            break;
+        }
+    }
+    return items.finish(ctx.arena);
+}
+
+// Items of a list array from ctx.current_line on, into items, until count
+// are read or a line ends the array. p is the array's projection; fields
+// its items never read are not converted.
+void ToonParser::parse_list_items(Context& ctx, int item_depth, size_t count, ListItems& items, const Projection* p) {
+    const Projection* item_p = Projection::elements(p);
+    while (ctx.current_line < ctx.line_count && items.size() < count) {
+        int depth = ctx.depth(ctx.current_line);
         
         if (depth < item_depth) {
             break;
         }
         
         if (depth == item_depth) {
-            std::string content = get_line_content(ctx.lines[ctx.current_line]);
+            std::string_view content = ctx.content(ctx.current_line);
             
             if (!content.empty() && content[0] == '-') {
                 ctx.current_line++;
                 
                 // Get content after the dash
-                std::string after_dash = content.substr(1);
-                trim(after_dash);
+                std::string_view after_dash = trim(content.substr(1));
                 
                 if (after_dash.empty()) {
                     // Empty object
-                    items.push_back(Value(std::map<std::string, Value>{}));
+                    items.add(Value(Object(ctx.arena), ctx.arena));
                 } else if (is_array_header(after_dash)) {
                     // Array item
                     ArrayHeader header = parse_array_header(after_dash);
-                    Value arr(std::vector<Value>{});
+                    Value arr;
                     
-                    size_t colon_pos = find_unquoted_colon(after_dash);
-                    if (colon_pos != std::string::npos) {
-                        std::string after_colon = after_dash.substr(colon_pos + 1);
-                        trim(after_colon);
+                    size_t colon_pos = ctx.find_colon(after_dash);
+                    if (colon_pos != std::string_view::npos) {
+                        std::string_view after_colon = trim(after_dash.substr(colon_pos + 1));
                         if (!after_colon.empty()) {
-                            arr = parse_inline_array(after_colon, header.length, header.delimiter);
+                            arr = parse_inline_array(ctx, after_colon, header.length, header.delimiter);
                         }
                     }
                     
                     if (arr.is_null()) {
                         if (!header.fields.empty()) {
-                            arr = parse_tabular_array(ctx, item_depth + 1, header);
+                            arr = parse_tabular_array(ctx, item_depth + 1, header, item_p);
                         } else {
-                            arr = parse_list_array(ctx, item_depth + 1, header.length);
+                            arr = parse_list_array(ctx, item_depth + 1, header.length, item_p);
                         }
                     }
                     
-                    items.push_back(std::move(arr));
-                } else if (after_dash.find(':') != std::string::npos) {
+                    items.add(std::move(arr));
+                } else if (after_dash.find(':') != std::string_view::npos) {
                     // Object item starting with first field on same line
-                    std::map<std::string, Value> obj;
+                    auto& fields = items.fields;
+                    fields.clear();
                     
-                    size_t colon_pos = find_unquoted_colon(after_dash);
-                    std::string key = after_dash.substr(0, colon_pos);
-                    std::string val = after_dash.substr(colon_pos + 1);
-                    trim(key);
-                    trim(val);
-                    
-                    key = parse_key(key);
-                    obj[key] = parse_primitive(val);
+                    size_t colon_pos = ctx.find_colon(after_dash);
+                    Key key = ctx.key(after_dash.substr(0, colon_pos));
+                    if (!Projection::skips(item_p, key)) {
+                        fields.emplace_back(key, parse_primitive(ctx, trim(after_dash.substr(colon_pos + 1))));
+                    }
                     
                     // Parse remaining fields
-                    while (ctx.current_line < ctx.lines.size()) {
-                        int field_depth = get_line_depth(ctx.lines[ctx.current_line], ctx.indent_size);
+                    while (ctx.current_line < ctx.line_count) {
+                        int field_depth = ctx.depth(ctx.current_line);
                         if (field_depth <= item_depth) {
                             break;
                         }
                         
-                        std::string field_content = get_line_content(ctx.lines[ctx.current_line]);
+                        std::string_view field_content = ctx.content(ctx.current_line);
                         if (field_content.empty() || field_content[0] == '-') {
                             break;
                         }
                         
-                        size_t field_colon = find_unquoted_colon(field_content);
-                        if (field_colon == std::string::npos) {
+                        size_t field_colon = ctx.find_colon(field_content);
+                        if (field_colon == std::string_view::npos) {
                             break;
                         }
                         
-                        std::string field_key = field_content.substr(0, field_colon);
-                        std::string field_val = field_content.substr(field_colon + 1);
-                        trim(field_key);
-                        trim(field_val);
-                        
-                        field_key = parse_key(field_key);
-                        obj[field_key] = parse_primitive(field_val);
+                        Key field_key = ctx.key(field_content.substr(0, field_colon));
+                        if (!Projection::skips(item_p, field_key)) {
+                            fields.emplace_back(field_key, parse_primitive(ctx, trim(field_content.substr(field_colon + 1))));
+                        }
                         ctx.current_line++;
                     }
                     
-                    items.push_back(Value(std::move(obj)));
+                    items.add_fields(ctx.arena);
                 } else {
                     // Primitive item
-                    items.push_back(parse_primitive(after_dash));
+                    items.add(parse_primitive(ctx, after_dash));
                 }
             } else {
                 break;
@@ -290,17 +451,126 @@ Value ToonParser::parse_list_array(Context& ctx, int item_depth, int expected_le
             break;
         }
     }
+}
+
+void ToonParser::ListItems::add(Value item) {
+    to_objects();
+    items.push_back(std::move(item));
+}
+
+void ToonParser::ListItems::add_fields(Arena* arena) {
+    if (columnar && rows == 0) {
+        // The first item sets the keys, if they can head a table
+        keys.clear();
+        for (const auto& field : fields) {
+            keys.push_back(field.first);
+        }
+        std::vector<Key> sorted = keys;
+        std::sort(sorted.begin(), sorted.end());
+        if (!keys.empty() && std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end()) {
+            columns.assign(keys.size(), {});
+            for (auto& column : columns) {
+                column.reserve(expected);
+            }
+        } else {
+            to_objects();
+        }
+    }
+    if (columnar && fields_match(keys)) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            columns[i].push_back(std::move(fields[i].second));
+        }
+        rows++;
+        return;
+    }
+    to_objects();
     
-    return Value(std::move(items));
+    // Items repeating the keys of a recent one take its shape as is
+    for (size_t i = 0; i < shapes.size() && shapes[i]; ++i) {
+        if (!fields_match(shapes[i]->keys())) {
+            continue;
+        }
+        std::rotate(shapes.begin(), shapes.begin() + i, shapes.begin() + i + 1);
+        std::vector<Value> values;
+        values.reserve(fields.size());
+        for (auto& field : fields) {
+            values.push_back(std::move(field.second));
+        }
+        items.push_back(Value(Object(shapes[0], std::move(values), arena), arena));
+        return;
+    }
+    Object obj(arena);
+    obj.reserve(fields.size());
+    for (auto& [key, value] : fields) {
+        obj.insert_or_assign(key, std::move(value));
+    }
+    if (obj.size() == fields.size()) {
+        std::rotate(shapes.begin(), shapes.end() - 1, shapes.end());
+        shapes[0] = obj.shape();
+    }
+    items.push_back(Value(std::move(obj), arena));
+}
+
+bool ToonParser::ListItems::fields_match(const std::vector<Key>& keys) const {
+    if (fields.size() != keys.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (fields[i].first != keys[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ToonParser::ListItems::append(ListItems&& other) {
+    if (columnar && other.columnar && (rows == 0 || other.rows == 0 || keys == other.keys)) {
+        if (rows == 0) {
+            keys = std::move(other.keys);
+            columns = std::move(other.columns);
+        } else if (other.rows > 0) {
+            for (size_t c = 0; c < columns.size(); ++c) {
+                columns[c].insert(columns[c].end(), std::make_move_iterator(other.columns[c].begin()),
+                                  std::make_move_iterator(other.columns[c].end()));
+            }
+        }
+        rows += other.rows;
+        return;
+    }
+    to_objects();
+    other.to_objects();
+    std::move(other.items.begin(), other.items.end(), std::back_inserter(items));
+}
+
+Value ToonParser::ListItems::finish(Arena* arena) {
+    if (columnar && rows > 0) {
+        return Value::table(std::move(keys), std::move(columns), arena);
+    }
+    to_objects();
+    return Value(std::move(items), arena);
+}
+
+// Rows so far become row objects of a table, as a tabular array's full
+// rows do when a short one follows
+void ToonParser::ListItems::to_objects() {
+    if (!columnar) {
+        return;
+    }
+    columnar = false;
+    if (rows > 0) {
+        items = Value::table(keys, std::move(columns)).as_array();
+        rows = 0;
+    }
+    columns.clear();
+    items.reserve(expected);
 }
 
 // Parse primitive value from string
-Value ToonParser::parse_primitive(const std::string& str) {
-    std::string s = str;
-    trim(s);
+Value ToonParser::parse_primitive(const Context& ctx, std::string_view str) {
+    std::string_view s = trim(str);
     
     if (s.empty()) {
-        return Value("");
+        return ctx.slice(s);
     }
     
     // Boolean and null literals
@@ -308,106 +578,438 @@ Value ToonParser::parse_primitive(const std::string& str) {
     if (s == "false") return Value(false);
     if (s == "null") return Value();  // null value
     
-    // Quoted string
+    // Quoted string: only escapes force an owned copy
     if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
-        return Value(unescape_string(s.substr(1, s.size() - 2)));
-    }
-    
-    // Try to parse as number
-    if (is_numeric(s)) {
-        if (s.find('.') != std::string::npos || s.find('e') != std::string::npos || s.find('E') != std::string::npos) {
-            // Floating point
-            try {
-                double d = std::stod(s);
-                // Normalize -0 to 0
-                if (d == 0.0 && std::signbit(d)) {
-                    d = 0.0;
-                }
-                return Value(d);
-            } catch (...) {
-                return Value(s);
+        std::string_view inner = s.substr(1, s.size() - 2);
+        if (inner.find('\\') != std::string_view::npos) {
+            return Value(unescape_string(inner));
+        }
+        return ctx.slice(inner);
+    }
+    
+    // Integers stay exact int64; fractions, exponents and larger magnitudes are doubles
+    Value number;
+    if (Value::try_parse_number(s, number)) {
+        return number;
+    }
+    
+    // Unquoted string
+    return ctx.slice(s);
+}
+
+// Parse a complete TOON document into a tape
+Tape ToonParser::parse_tape(std::string content) {
+    Context ctx(std::move(content), nullptr, 1);
+    
+    Tape::Builder out;
+    out.reserve(ctx.buffer.view().size() / 4, ctx.buffer.view().size() / 2);
+    if (ctx.line_count == 0) {
+        out.begin_object();
+        out.end_object();
+        return out.finish();
+    }
+    
+    std::string_view first_content_line = ctx.content(0);
+    if (is_array_header(first_content_line) && first_content_line[0] == '[') {
+        tape_root_array(ctx, out);
+    } else if (ctx.line_count == 1 && first_content_line.find(':') == std::string_view::npos) {
+        tape_primitive(out, first_content_line);
+    } else {
+        tape_object_fields(ctx, out, 0);
+    }
+    return out.finish();
+}
+
+void ToonParser::tape_object_fields(Context& ctx, Tape::Builder& out, int base_depth) {
+    out.begin_object();
+    
+    while (ctx.current_line < ctx.line_count) {
+        int depth = ctx.depth(ctx.current_line);
+        if (depth != base_depth) {
+            break;
+        }
+        
+        std::string_view content = ctx.content(ctx.current_line);
+        if (content.empty() || content[0] == '-') {
+            break;
+        }
+        
+        size_t colon_pos = ctx.find_colon(content);
+        if (colon_pos == std::string_view::npos) {
+            break;
+        }
+        
+        std::string_view key_part = trim(content.substr(0, colon_pos));
+        std::string_view value_part = trim(content.substr(colon_pos + 1));
+        
+        if (is_array_header(content)) {
+            ArrayHeader header = parse_array_header(content);
+            ctx.current_line++;
+            out.key(Key(header.key));
+            
+            if (!value_part.empty()) {
+                tape_inline_array(ctx, out, value_part, header.delimiter);
+            } else if (!header.fields.empty()) {
+                tape_tabular_array(ctx, out, base_depth + 1, header);
+            } else {
+                tape_list_array(ctx, out, base_depth + 1, header.length);
             }
         } else {
-            // Integer
-            try {
-                int i = std::stoi(s);
-                return Value(i);
-            } catch (...) {
-                return Value(s);
+            out.key(ctx.key(key_part));
+            ctx.current_line++;
+            
+            if (value_part.empty()) {
+                tape_object_fields(ctx, out, base_depth + 1);
+            } else {
+                tape_primitive(out, value_part);
             }
         }
     }
     
-    // Unquoted string
-    return Value(s);
+    out.end_object();
+}
+
+void ToonParser::tape_root_array(Context& ctx, Tape::Builder& out) {
+    std::string_view content = ctx.content(0);
+    ArrayHeader header = parse_array_header(content);
+    ctx.current_line = 1;
+    
+    if (!header.key.empty()) {
+        out.begin_object();
+        out.key(Key(header.key));
+    }
+    
+    size_t colon_pos = ctx.find_colon(content);
+    std::string_view after_colon = colon_pos != std::string_view::npos ? trim(content.substr(colon_pos + 1))
+                                                                        : std::string_view();
+    if (!after_colon.empty()) {
+        tape_inline_array(ctx, out, after_colon, header.delimiter);
+    } else if (!header.fields.empty()) {
+        tape_tabular_array(ctx, out, 1, header);
+    } else {
+        tape_list_array(ctx, out, 1, header.length);
+    }
+    
+    if (!header.key.empty()) {
+        out.end_object();
+    }
+}
+
+void ToonParser::tape_inline_array(const Context& ctx, Tape::Builder& out, std::string_view values_str, char delimiter) {
+    std::vector<std::string_view> parts;
+    ctx.split(values_str, delimiter, parts);
+    out.begin_array();
+    for (std::string_view part : parts) {
+        std::string_view trimmed = trim(part);
+        if (!trimmed.empty()) {
+            tape_primitive(out, trimmed);
+        }
+    }
+    out.end_array();
+}
+
+// Rows are written as objects; the array is marked as a table when the tree
+// parser would have stored it column-wise
+void ToonParser::tape_tabular_array(Context& ctx, Tape::Builder& out, int item_depth, const ArrayHeader& header) {
+    size_t width = header.fields.size();
+    std::vector<Key> sorted_keys = header.field_keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    bool columnar = std::adjacent_find(sorted_keys.begin(), sorted_keys.end()) == sorted_keys.end();
+    
+    out.begin_array();
+    size_t rows = 0;
+    std::vector<std::string_view> values;  // reused for every row
+    values.reserve(width);
+    while (ctx.current_line < ctx.line_count && rows < static_cast<size_t>(header.length)) {
+        if (ctx.depth(ctx.current_line) != item_depth) {
+            break;
+        }
+        
+        ctx.split(ctx.content(ctx.current_line), header.delimiter, values);
+        if (values.size() < width) {
+            columnar = false;
+        }
+        
+        out.begin_object();
+        for (size_t i = 0; i < width && i < values.size(); i++) {
+            out.key(header.field_keys[i]);
+            tape_primitive(out, trim(values[i]));
+        }
+        out.end_object();
+        
+        rows++;
+        ctx.current_line++;
+    }
+    out.end_array(columnar && width > 0);
+}
+
+void ToonParser::tape_list_array(Context& ctx, Tape::Builder& out, int item_depth, int expected_length) {
+    out.begin_array();
+    size_t items = 0;
+    
+    while (ctx.current_line < ctx.line_count && items < static_cast<size_t>(expected_length)) {
+        if (ctx.depth(ctx.current_line) != item_depth) {
+            break;
+        }
+        
+        std::string_view content = ctx.content(ctx.current_line);
+        if (content.empty() || content[0] != '-') {
+            break;
+        }
+        ctx.current_line++;
+        items++;
+        
+        std::string_view after_dash = trim(content.substr(1));
+        if (after_dash.empty()) {
+            out.begin_object();
+            out.end_object();
+        } else if (is_array_header(after_dash)) {
+            ArrayHeader header = parse_array_header(after_dash);
+            size_t colon_pos = ctx.find_colon(after_dash);
+            std::string_view after_colon = colon_pos != std::string_view::npos ? trim(after_dash.substr(colon_pos + 1))
+                                                                                : std::string_view();
+            if (!after_colon.empty()) {
+                tape_inline_array(ctx, out, after_colon, header.delimiter);
+            } else if (!header.fields.empty()) {
+                tape_tabular_array(ctx, out, item_depth + 1, header);
+            } else {
+                tape_list_array(ctx, out, item_depth + 1, header.length);
+            }
+        } else if (after_dash.find(':') != std::string_view::npos) {
+            // Object item starting with first field on same line
+            out.begin_object();
+            
+            size_t colon_pos = ctx.find_colon(after_dash);
+            out.key(ctx.key(after_dash.substr(0, colon_pos)));
+            tape_primitive(out, trim(after_dash.substr(colon_pos + 1)));
+            
+            while (ctx.current_line < ctx.line_count) {
+                if (ctx.depth(ctx.current_line) <= item_depth) {
+                    break;
+                }
+                
+                std::string_view field_content = ctx.content(ctx.current_line);
+                if (field_content.empty() || field_content[0] == '-') {
+                    break;
+                }
+                
+                size_t field_colon = ctx.find_colon(field_content);
+                if (field_colon == std::string_view::npos) {
+                    break;
+                }
+                
+                out.key(ctx.key(field_content.substr(0, field_colon)));
+                tape_primitive(out, trim(field_content.substr(field_colon + 1)));
+                ctx.current_line++;
+            }
+            
+            out.end_object();
+        } else {
+            tape_primitive(out, after_dash);
+        }
+    }
+    
+    out.end_array();
+}
+
+void ToonParser::tape_primitive(Tape::Builder& out, std::string_view str) {
+    std::string_view s = trim(str);
+    
+    if (s == "true") return out.boolean(true);
+    if (s == "false") return out.boolean(false);
+    if (s == "null") return out.null();
+    
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
+        std::string_view inner = s.substr(1, s.size() - 2);
+        if (inner.find('\\') != std::string_view::npos) {
+            return out.string(unescape_string(inner));
+        }
+        return out.string(inner);
+    }
+    
+    Value number;
+    if (Value::try_parse_number(s, number)) {
+        if (number.is_integer()) {
+            return out.integer(number.as_integer());
+        }
+        return out.number(number.as_number());
+    }
+    
+    out.string(s);
 }
 
 // Utility functions
 
-std::vector<std::string> ToonParser::split_lines(const std::string& content) {
-    std::vector<std::string> lines;
-    std::string line;
-    std::istringstream stream(content);
+std::vector<ToonParser::Line> ToonParser::index_lines(std::string_view content, std::vector<uint64_t>& structural) {
+    const char* data = content.data();
+    size_t size = content.size();
+    size_t blocks = (size + 63) / 64;
+    std::vector<Line> lines;
+    lines.reserve(size / 16 + 2);  // typical lines are longer; reserving touches no memory
+    structural.resize(blocks);
     
-    while (std::getline(stream, line)) {
-        // Remove \r if present (Windows line endings)
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
+    size_t start = 0;
+    auto add_line = [&](size_t end) {
+        size_t indent = start;
+        while (indent < end && data[indent] == ' ') {
+            indent++;
         }
-        lines.push_back(line);
+        lines.push_back({start, indent - start});
+        start = end + 1;
+    };
+    
+    ScanBlock scanned[64];
+    for (size_t first = 0; first < blocks; first += 64) {
+        size_t count = std::min<size_t>(64, blocks - first);
+        StructuralScanner::scan(content, first, count, scanned);
+        for (size_t b = 0; b < count; ++b) {
+            const ScanBlock& block = scanned[b];
+            structural[first + b] = block.colon | block.quote | block.escape | block.delimiter;
+            for (uint64_t newlines = block.newline; newlines; newlines &= newlines - 1) {
+                add_line((first + b) * 64 + std::countr_zero(newlines));
+            }
+        }
+    }
+    if (start < size) {
+        add_line(size);
     }
+    // The last line ends where a newline after it would be
+    lines.push_back({size + 1, 0});
     
     return lines;
 }
 
-int ToonParser::get_line_depth(const std::string& line, int indent_size) {
-    int spaces = 0;
-    for (char c : line) {
-        if (c == ' ') {
-            spaces++;
-        } else {
-            break;
+namespace {
+    // Calls visit(position) for the quotes, backslashes, colons and
+    // delimiters in [begin, end), in order, until visit returns false
+    template <typename Visit>
+    void for_each_structural(const std::vector<uint64_t>& structural, size_t begin, size_t end, Visit visit) {
+        if (begin >= end) {
+            return;
+        }
+        size_t block = begin / 64;
+        uint64_t bits = structural[block] & (~uint64_t{0} << (begin % 64));
+        while (true) {
+            for (; bits; bits &= bits - 1) {
+                size_t position = block * 64 + std::countr_zero(bits);
+                if (position >= end || !visit(position)) {
+                    return;
+                }
+            }
+            if (++block * 64 >= end) {
+                return;
+            }
+            bits = structural[block];
         }
     }
-    return spaces / indent_size;
 }
 
-std::string ToonParser::get_line_content(const std::string& line) {
-    size_t start = 0;
-    while (start < line.size() && line[start] == ' ') {
-        start++;
+// Same quote and escape rules as a byte-by-byte scan, visiting only the
+// bytes that can change the answer. A backslash escapes the next byte
+// inside quotes; that byte is skipped whatever it is.
+size_t ToonParser::Context::find_colon(std::string_view s) const {
+    const char* data = buffer.view().data();
+    size_t begin = static_cast<size_t>(s.data() - data);
+    size_t found = std::string_view::npos;
+    bool in_quotes = false;
+    size_t escaped = std::string_view::npos;
+    for_each_structural(index->structural, begin, begin + s.size(), [&](size_t position) {
+        char c = data[position];
+        if (position == escaped) {
+            return true;
+        }
+        if (c == '\\' && in_quotes) {
+            escaped = position + 1;
+        } else if (c == '"') {
+            in_quotes = !in_quotes;
+        } else if (c == ':' && !in_quotes) {
+            found = position - begin;
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
+void ToonParser::Context::split(std::string_view s, char delimiter, std::vector<std::string_view>& out) const {
+    out.clear();
+    const char* data = buffer.view().data();
+    size_t begin = static_cast<size_t>(s.data() - data);
+    size_t start = begin;
+    bool in_quotes = false;
+    size_t escaped = std::string_view::npos;
+    for_each_structural(index->structural, begin, begin + s.size(), [&](size_t position) {
+        char c = data[position];
+        if (position == escaped) {
+            return true;
+        }
+        if (c == '\\' && in_quotes) {
+            escaped = position + 1;
+        } else if (c == '"') {
+            in_quotes = !in_quotes;
+        } else if (c == delimiter && !in_quotes) {
+            out.emplace_back(data + start, position - start);
+            start = position + 1;
+        }
+        return true;
+    });
+    
+    size_t end = begin + s.size();
+    if (start < end || !out.empty()) {
+        out.emplace_back(data + start, end - start);
     }
-    return line.substr(start);
 }
 
-void ToonParser::trim(std::string& s) {
-    // Trim left
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) {
-        return !std::isspace(ch);
-    }));
-    // Trim right
-    s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) {
-        return !std::isspace(ch);
-    }).base(), s.end());
+ToonParser::Context::Context(std::string content, Arena* arena, unsigned threads)
+    : buffer(std::move(content)), current_line(0), indent_size(2), arena(arena), threads(threads) {
+    auto built = std::make_shared<Index>();
+    built->lines = index_lines(buffer.view(), built->structural);
+    lines = built->lines.data();
+    line_count = built->lines.size() - 1;
+    index = std::move(built);
+}
+
+ToonParser::Context::Context(const Context& parent, Arena* arena)
+    : buffer(parent.buffer), index(parent.index), lines(parent.lines), line_count(parent.line_count),
+      current_line(parent.current_line), indent_size(parent.indent_size), arena(arena), threads(1) {}
+
+Key ToonParser::Context::key(std::string_view text) {
+    if (text.empty()) {
+        return parse_key(text);  // an empty slot would match it
+    }
+    // Keys differing in one character, like roles[1] and roles[2], must
+    // not share a slot, so the hash takes in the first and last 8 bytes
+    size_t n = std::min<size_t>(text.size(), 8);
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    std::memcpy(&head, text.data(), n);
+    std::memcpy(&tail, text.data() + text.size() - n, n);
+    uint64_t hash = (head * 0x9E3779B97F4A7C15ull) ^ (tail * 0xC2B2AE3D27D4EB4Full) ^ text.size();
+    KeySlot& slot = keys[(hash ^ hash >> 29) % 64];
+    if (slot.text != text) {
+        slot.text = text;
+        slot.key = parse_key(text);
+    }
+    return slot.key;
 }
 
-bool ToonParser::is_array_header(const std::string& content) {
+bool ToonParser::is_array_header(std::string_view content) {
     // Look for pattern: [number] or key[number]
     size_t bracket_pos = content.find('[');
-    if (bracket_pos == std::string::npos) {
+    if (bracket_pos == std::string_view::npos) {
         return false;
     }
     
     size_t close_bracket = content.find(']', bracket_pos);
-    if (close_bracket == std::string::npos) {
+    if (close_bracket == std::string_view::npos) {
         return false;
     }
     
     // Must have colon after bracket section
-    return content.find(':', close_bracket) != std::string::npos;
+    return content.find(':', close_bracket) != std::string_view::npos;
 }
 
-ToonParser::ArrayHeader ToonParser::parse_array_header(const std::string& content) {
+ToonParser::ArrayHeader ToonParser::parse_array_header(std::string_view content) {
     ArrayHeader header;
     header.delimiter = ',';  // Default
     
@@ -416,92 +1018,81 @@ ToonParser::ArrayHeader ToonParser::parse_array_header(const std::string& conten
     
     // Extract key if present
     if (bracket_start > 0) {
-        std::string key_part = content.substr(0, bracket_start);
-        trim(key_part);
-        header.key = parse_key(key_part);
+        header.key = parse_key(content.substr(0, bracket_start));
     }
     
     // Extract length from [N]
-    std::string bracket_content = content.substr(bracket_start + 1, bracket_end - bracket_start - 1);
+    std::string_view bracket_content = content.substr(bracket_start + 1, bracket_end - bracket_start - 1);
     
     // Check for delimiter suffix
     if (!bracket_content.empty()) {
         char last = bracket_content.back();
         if (last == '\t') {
             header.delimiter = '\t';
-            bracket_content.pop_back();
+            bracket_content.remove_suffix(1);
         } else if (last == '|') {
             header.delimiter = '|';
-            bracket_content.pop_back();
+            bracket_content.remove_suffix(1);
         }
     }
     
-    trim(bracket_content);
-    header.length = std::stoi(bracket_content);
+    std::string_view length = trim(bracket_content);
+    if (!length.empty() && length.front() == '+') {
+        length.remove_prefix(1);
+    }
+    auto [end, ec] = std::from_chars(length.data(), length.data() + length.size(), header.length);
+    if (ec == std::errc::result_out_of_range) {
+        throw std::out_of_range("Array length out of range: " + std::string(length));
+    }
+    if (ec != std::errc() || length.empty()) {
+        throw std::invalid_argument("Invalid array length: " + std::string(length));
+    }
     
     // Check for field names {field1,field2}
     size_t brace_start = content.find('{', bracket_end);
     size_t brace_end = content.find('}', brace_start);
     
-    if (brace_start != std::string::npos && brace_end != std::string::npos) {
-        std::string fields_content = content.substr(brace_start + 1, brace_end - brace_start - 1);
-        header.fields = split_delimited(fields_content, header.delimiter);
+    if (brace_start != std::string_view::npos && brace_end != std::string_view::npos) {
+        std::string_view fields_content = content.substr(brace_start + 1, brace_end - brace_start - 1);
         
         // Trim and unquote field names
-        for (auto& field : header.fields) {
-            trim(field);
+        for (std::string_view field : split_delimited(fields_content, header.delimiter)) {
+            field = trim(field);
             if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
                 field = field.substr(1, field.size() - 2);
             }
+            header.fields.emplace_back(field);
+            header.field_keys.push_back(Key(field));
         }
     }
     
     return header;
 }
 
-std::string ToonParser::parse_key(const std::string& key_str) {
-    std::string k = key_str;
-    trim(k);
+Key ToonParser::parse_key(std::string_view key_str) {
+    std::string_view k = trim(key_str);
     
     // Remove quotes if present
     if (k.size() >= 2 && k.front() == '"' && k.back() == '"') {
-        return unescape_string(k.substr(1, k.size() - 2));
+        std::string_view inner = k.substr(1, k.size() - 2);
+        if (inner.find('\\') != std::string_view::npos) {
+            return Key(unescape_string(inner));
+        }
+        return Key(inner);
     }
     
-    return k;
+    return Key(k);
 }
 
-size_t ToonParser::find_unquoted_colon(const std::string& str) {
-    bool in_quotes = false;
-    bool escaped = false;
-    
-    for (size_t i = 0; i < str.size(); i++) {
-        if (escaped) {
-            escaped = false;
-            continue;
-        }
-        
-        if (str[i] == '\\' && in_quotes) {
-            escaped = true;
-            continue;
-        }
-        
-        if (str[i] == '"') {
-            in_quotes = !in_quotes;
-            continue;
-        }
-        
-        if (str[i] == ':' && !in_quotes) {
-            return i;
-        }
-    }
-    
-    return std::string::npos;
+std::vector<std::string_view> ToonParser::split_delimited(std::string_view str, char delimiter) {
+    std::vector<std::string_view> result;
+    split_delimited(str, delimiter, result);
+    return result;
 }
 
-std::vector<std::string> ToonParser::split_delimited(const std::string& str, char delimiter) {
-    std::vector<std::string> result;
-    std::string current;
+void ToonParser::split_delimited(std::string_view str, char delimiter, std::vector<std::string_view>& result) {
+    result.clear();
+    size_t start = 0;
     bool in_quotes = false;
     bool escaped = false;
     
@@ -509,78 +1100,34 @@ std::vector<std::string> ToonParser::split_delimited(const std::string& str, cha
         char c = str[i];
         
         if (escaped) {
-            current += c;
             escaped = false;
             continue;
         }
         
         if (c == '\\' && in_quotes) {
-            current += c;
             escaped = true;
             continue;
         }
         
         if (c == '"') {
             in_quotes = !in_quotes;
-            current += c;
             continue;
         }
         
         if (c == delimiter && !in_quotes) {
-            result.push_back(current);
-            current.clear();
-            continue;
+            result.push_back(str.substr(start, i - start));
+            start = i + 1;
         }
-        
-        current += c;
     }
     
-    if (!current.empty() || !result.empty()) {
-        result.push_back(current);
+    if (start < str.size() || !result.empty()) {
+        result.push_back(str.substr(start));
     }
-    
-    return result;
-}
-
-bool ToonParser::is_numeric(const std::string& str) {
-    if (str.empty()) return false;
-    
-    size_t start = 0;
-    if (str[0] == '-' || str[0] == '+') {
-        start = 1;
-    }
-    
-    if (start >= str.size()) return false;
-    
-    bool has_digit = false;
-    bool has_dot = false;
-    bool has_e = false;
-    
-    for (size_t i = start; i < str.size(); i++) {
-        char c = str[i];
-        
-        if (c >= '0' && c <= '9') {
-            has_digit = true;
-        } else if (c == '.') {
-            if (has_dot || has_e) return false;
-            has_dot = true;
-        } else if (c == 'e' || c == 'E') {
-            if (has_e || !has_digit) return false;
-            has_e = true;
-            has_digit = false;  // Need digit after e
-            if (i + 1 < str.size() && (str[i + 1] == '+' || str[i + 1] == '-')) {
-                i++;  // Skip sign after e
-            }
-        } else {
-            return false;
-        }
-    }
-    
-    return has_digit;
 }
 
-std::string ToonParser::unescape_string(const std::string& str) {
+std::string ToonParser::unescape_string(std::string_view str) {
     std::string result;
+    result.reserve(str.size());
     bool escaped = false;
     
     for (char c : str) {
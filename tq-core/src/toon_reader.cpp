@@ -0,0 +1,458 @@
+#include "tq/toon_reader.hpp"
+#include "tq/toon_parser.hpp"
+#include <cerrno>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace tq {
+
+namespace {
+    // First ':' outside quotes, with the parser's quote and escape rules
+    size_t find_colon(std::string_view s) {
+        bool in_quotes = false;
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] == '\\' && in_quotes) {
+                ++i;
+            } else if (s[i] == '"') {
+                in_quotes = !in_quotes;
+            } else if (s[i] == ':' && !in_quotes) {
+                return i;
+            }
+        }
+        return std::string_view::npos;
+    }
+}
+
+ToonReader::ToonReader(std::istream& in, size_t chunk_size) : in_(&in), chunk_size_(std::max<size_t>(chunk_size, 1)) {}
+
+ToonReader::ToonReader(int fd, size_t chunk_size) : fd_(fd), chunk_size_(std::max<size_t>(chunk_size, 1)) {}
+
+ToonReader::Event ToonReader::next() {
+    while (queued_ == queue_.size()) {
+        queue_.clear();
+        queued_ = 0;
+        if (done_) {
+            current_ = {Event::End, {}, 0, false};
+            return current_.event;
+        }
+        step();
+    }
+    current_ = queue_[queued_++];
+    return current_.event;
+}
+
+std::string_view ToonReader::key() const {
+    if (!current_.raw_key) {
+        return current_.text;
+    }
+    // As ToonParser::parse_key, without interning: keys of a stream need
+    // not repeat
+    std::string_view k = ToonParser::trim(current_.text);
+    if (k.size() >= 2 && k.front() == '"' && k.back() == '"') {
+        std::string_view inner = k.substr(1, k.size() - 2);
+        if (inner.find('\\') != std::string_view::npos) {
+            key_storage_ = ToonParser::unescape_string(inner);
+            return key_storage_;
+        }
+        return inner;
+    }
+    return k;
+}
+
+Value ToonReader::value() const {
+    if (current_.event != Event::Scalar) {
+        throw std::runtime_error("Reader is not at a scalar");
+    }
+    // As ToonParser::parse_primitive, with strings copied out of the buffer
+    std::string_view s = current_.text;
+    if (s == "true") return Value(true);
+    if (s == "false") return Value(false);
+    if (s == "null") return Value();
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
+        std::string_view inner = s.substr(1, s.size() - 2);
+        if (inner.find('\\') != std::string_view::npos) {
+            return Value(ToonParser::unescape_string(inner));
+        }
+        return Value(std::string(inner));
+    }
+    Value number;
+    if (Value::try_parse_number(s, number)) {
+        return number;
+    }
+    return Value(std::string(s));
+}
+
+Value ToonReader::read_value() {
+    switch (current_.event) {
+        case Event::Scalar:
+            return value();
+        case Event::BeginArray: {
+            std::vector<Value> items;
+            if (current_.length > 0) {
+                items.reserve(std::min<size_t>(static_cast<size_t>(current_.length), 1024));
+            }
+            while (next() != Event::EndArray) {
+                items.push_back(read_value());
+            }
+            return Value(std::move(items));
+        }
+        case Event::BeginObject: {
+            if (const Shape* row = current_.shape) {
+                std::vector<Value> values;
+                values.reserve(row->size());
+                while (next() == Event::Key) {
+                    next();
+                    values.push_back(value());
+                }
+                return Value(Object(row, std::move(values)));
+            }
+            // Values are gathered and the object made at its final shape in
+            // one go, unless a key repeats or the keys outgrow a shape
+            const Shape* shape = Shape::empty();
+            std::vector<Value> values;
+            Object obj;
+            bool shaped = true;
+            while (next() == Event::Key) {
+                Key key(this->key());
+                next();
+                Value value = read_value();
+                if (shaped) {
+                    const Shape* wider = shape->slot(key) < 0 ? shape->with(key) : nullptr;
+                    if (wider) {
+                        shape = wider;
+                        values.push_back(std::move(value));
+                        continue;
+                    }
+                    obj = Object(shape, std::move(values));
+                    shaped = false;
+                }
+                obj.insert_or_assign(key, std::move(value));  // a repeated key keeps its last value
+            }
+            return Value(shaped ? Object(shape, std::move(values)) : std::move(obj));
+        }
+        default:
+            throw std::runtime_error("Reader is not at the start of a value");
+    }
+}
+
+void ToonReader::skip_value() {
+    if (current_.event == Event::Scalar) {
+        return;
+    }
+    if (current_.event != Event::BeginArray && current_.event != Event::BeginObject) {
+        throw std::runtime_error("Reader is not at the start of a value");
+    }
+    int open = 1;
+    while (open > 0) {
+        switch (next()) {
+            case Event::BeginArray:
+            case Event::BeginObject: open++; break;
+            case Event::EndArray:
+            case Event::EndObject: open--; break;
+            case Event::End: return;
+            default: break;
+        }
+    }
+}
+
+// Input
+
+// Drops the lines before the current one and appends up to one chunk.
+// Views into dropped lines, and into the buffer if it grows, go stale.
+bool ToonReader::fill() {
+    buffer_.erase(0, std::min(line_start_, buffer_.size()));
+    line_start_ = 0;
+
+    size_t old_size = buffer_.size();
+    buffer_.resize(old_size + chunk_size_);
+    size_t got = 0;
+    if (in_) {
+        in_->read(buffer_.data() + old_size, static_cast<std::streamsize>(chunk_size_));
+        got = static_cast<size_t>(in_->gcount());
+        if (in_->bad()) {
+            throw std::runtime_error("Failed to read TOON input");
+        }
+    } else {
+        while (true) {
+#ifdef _WIN32
+            int n = ::_read(fd_, buffer_.data() + old_size, static_cast<unsigned>(chunk_size_));
+#else
+            ssize_t n = ::read(fd_, buffer_.data() + old_size, chunk_size_);
+#endif
+            if (n >= 0) {
+                got = static_cast<size_t>(n);
+                break;
+            }
+            if (errno != EINTR) {
+                throw std::runtime_error(std::string("Failed to read TOON input: ") + std::strerror(errno));
+            }
+        }
+    }
+    buffer_.resize(old_size + got);
+    eof_ = got == 0;
+    return got > 0;
+}
+
+// Buffers the whole current line; end is where it stops (its '\n', or the
+// end of input)
+bool ToonReader::has_line(size_t& end) {
+    size_t searched = 0;  // bytes of the current line known to hold no '\n'
+    while (true) {
+        size_t newline = buffer_.find('\n', line_start_ + searched);
+        if (newline != std::string::npos) {
+            end = newline;
+            return true;
+        }
+        searched = buffer_.size() > line_start_ ? buffer_.size() - line_start_ : 0;
+        if (eof_ || !fill()) {
+            break;
+        }
+    }
+    if (line_start_ < buffer_.size()) {
+        end = buffer_.size();
+        return true;
+    }
+    return false;
+}
+
+bool ToonReader::read_line(Line& line) {
+    if (!has_line(line_end_)) {
+        return false;
+    }
+    const char* data = buffer_.data();
+    size_t first = line_start_;
+    while (first < line_end_ && data[first] == ' ') {
+        first++;
+    }
+    size_t last = line_end_;
+    if (last > first && data[last - 1] == '\r') {
+        last--;
+    }
+    line.depth = static_cast<int>(first - line_start_) / 2;
+    line.content = std::string_view(data + first, last - first);
+    return true;
+}
+
+// Whether the line read_line last returned is the last one; may move the
+// buffer, so views of that line must be taken again
+bool ToonReader::last_line() {
+    size_t start = line_start_;
+    while (buffer_.size() <= line_end_ + 1 && !eof_) {
+        fill();
+        line_end_ -= start - line_start_;
+        start = line_start_;
+    }
+    return buffer_.size() <= line_end_ + 1;
+}
+
+// Parsing: each step reads at most one line and queues its events
+
+void ToonReader::step() {
+    if (!started_) {
+        start();
+        return;
+    }
+    Frame& frame = frames_.back();
+    switch (frame.kind) {
+        case Kind::Object: step_object(frame); break;
+        case Kind::List: step_list(frame); break;
+        case Kind::ItemFields: step_item_fields(frame); break;
+        case Kind::Table: step_table(frame); break;
+    }
+}
+
+void ToonReader::start() {
+    started_ = true;
+    Line line;
+    if (!read_line(line)) {
+        // Empty input is an empty object
+        emit(Event::BeginObject);
+        emit(Event::EndObject);
+        emit(Event::End);
+        done_ = true;
+        return;
+    }
+
+    if (ToonParser::is_array_header(line.content) && line.content[0] == '[') {
+        ToonParser::ArrayHeader header = ToonParser::parse_array_header(line.content);
+        size_t colon = find_colon(line.content);
+        std::string_view values;
+        if (colon != std::string_view::npos) {
+            values = ToonParser::trim(line.content.substr(colon + 1));
+        }
+        advance();
+        open_array(std::move(header), values, 1);
+        if (frames_.empty()) {
+            emit(Event::End);
+            done_ = true;
+        }
+        return;
+    }
+
+    // A single line without a colon is a primitive document
+    if (line.content.find(':') == std::string_view::npos && last_line()) {
+        read_line(line);
+        emit(Event::Scalar, ToonParser::trim(line.content));
+        emit(Event::End);
+        done_ = true;
+        return;
+    }
+
+    frames_.push_back({Kind::Object, 0});
+    emit(Event::BeginObject);
+}
+
+// Inline values, or a frame for the rows or items on the lines below
+void ToonReader::open_array(ToonParser::ArrayHeader header, std::string_view values, int item_depth) {
+    emit(Event::BeginArray, {}, header.length);
+    if (!values.empty()) {
+        ToonParser::split_delimited(values, header.delimiter, parts_);
+        for (std::string_view part : parts_) {
+            std::string_view trimmed = ToonParser::trim(part);
+            if (!trimmed.empty()) {
+                emit(Event::Scalar, trimmed);
+            }
+        }
+        emit(Event::EndArray);
+        return;
+    }
+    Kind kind = header.fields.empty() ? Kind::List : Kind::Table;
+    frames_.push_back({kind, item_depth, header.length, header.delimiter, std::move(header.fields)});
+    if (kind == Kind::Table) {
+        // Interned once here so read_value() can build rows without lookups
+        std::vector<Key> keys(frames_.back().fields.begin(), frames_.back().fields.end());
+        frames_.back().shape = Shape::of(keys);
+    }
+}
+
+// Ends the innermost container, and the document with the last one
+void ToonReader::close() {
+    Kind kind = frames_.back().kind;
+    emit(kind == Kind::List || kind == Kind::Table ? Event::EndArray : Event::EndObject);
+    frames_.pop_back();
+    if (frames_.empty()) {
+        emit(Event::End);
+        done_ = true;
+    }
+}
+
+// "key: value", "key:" and a nested object, or "key[n]...:" and an array
+void ToonReader::step_object(Frame& frame) {
+    Line line;
+    if (!read_line(line) || line.depth != frame.depth || line.content.empty() || line.content[0] == '-') {
+        close();
+        return;
+    }
+    std::string_view content = line.content;
+    size_t colon = find_colon(content);
+    if (colon == std::string_view::npos) {
+        close();
+        return;
+    }
+    int depth = frame.depth;
+    std::string_view value_part = ToonParser::trim(content.substr(colon + 1));
+    advance();
+
+    if (ToonParser::is_array_header(content)) {
+        ToonParser::ArrayHeader header = ToonParser::parse_array_header(content);
+        header_key_ = header.key;
+        emit(Event::Key, header_key_);
+        open_array(std::move(header), value_part, depth + 1);
+        return;
+    }
+
+    emit(Event::Key, content.substr(0, colon), 0, true);
+    if (value_part.empty()) {
+        frames_.push_back({Kind::Object, depth + 1});
+        emit(Event::BeginObject);
+    } else {
+        emit(Event::Scalar, value_part);
+    }
+}
+
+// "- " items: an empty object, an array, an object whose first field shares
+// the dash line, or a primitive
+void ToonReader::step_list(Frame& frame) {
+    Line line;
+    if (frame.remaining == 0 || !read_line(line) || line.depth != frame.depth ||
+        line.content.empty() || line.content[0] != '-') {
+        close();
+        return;
+    }
+    if (frame.remaining > 0) {
+        frame.remaining--;
+    }
+    int depth = frame.depth;
+    std::string_view after_dash = ToonParser::trim(line.content.substr(1));
+    advance();
+
+    if (after_dash.empty()) {
+        emit(Event::BeginObject);
+        emit(Event::EndObject);
+    } else if (ToonParser::is_array_header(after_dash)) {
+        ToonParser::ArrayHeader header = ToonParser::parse_array_header(after_dash);
+        size_t colon = find_colon(after_dash);
+        std::string_view values;
+        if (colon != std::string_view::npos) {
+            values = ToonParser::trim(after_dash.substr(colon + 1));
+        }
+        open_array(std::move(header), values, depth + 1);
+    } else if (after_dash.find(':') != std::string_view::npos) {
+        size_t colon = find_colon(after_dash);
+        emit(Event::BeginObject);
+        emit(Event::Key, after_dash.substr(0, colon), 0, true);
+        emit(Event::Scalar, ToonParser::trim(after_dash.substr(colon + 1)));
+        frames_.push_back({Kind::ItemFields, depth});
+    } else {
+        emit(Event::Scalar, after_dash);
+    }
+}
+
+// Further "key: value" fields of a list item, on deeper lines
+void ToonReader::step_item_fields(Frame& frame) {
+    Line line;
+    if (!read_line(line) || line.depth <= frame.depth || line.content.empty() || line.content[0] == '-') {
+        close();
+        return;
+    }
+    size_t colon = find_colon(line.content);
+    if (colon == std::string_view::npos) {
+        close();
+        return;
+    }
+    emit(Event::Key, line.content.substr(0, colon), 0, true);
+    emit(Event::Scalar, ToonParser::trim(line.content.substr(colon + 1)));
+    advance();
+}
+
+// One delimited row per line, as an object of the header's fields
+void ToonReader::step_table(Frame& frame) {
+    Line line;
+    if (frame.remaining == 0 || !read_line(line) || line.depth != frame.depth) {
+        close();
+        return;
+    }
+    if (frame.remaining > 0) {
+        frame.remaining--;
+    }
+    ToonParser::split_delimited(line.content, frame.delimiter, parts_);
+    emit(Event::BeginObject);
+    if (parts_.size() >= frame.fields.size()) {
+        queue_.back().shape = frame.shape;
+    }
+    for (size_t i = 0; i < frame.fields.size() && i < parts_.size(); ++i) {
+        emit(Event::Key, frame.fields[i]);
+        emit(Event::Scalar, ToonParser::trim(parts_[i]));
+    }
+    emit(Event::EndObject);
+    advance();
+}
+
+} // namespace tq
@@ -1,11 +1,83 @@
 #include "tq/tq.hpp"
+#include <istream>
+#include <stdexcept>
 
 namespace tq {
 
-std::vector<std::string> query(const std::string& expression, const std::string& data) {
-    // Parse the data
-    Value data_value = ToonParser::parse(data);
-    
+namespace {
+    void flatten_pipe(const ExprPtr& expr, std::vector<ExprPtr>& stages) {
+        if (expr->type == ExprType::Pipe) {
+            flatten_pipe(expr->left, stages);
+            flatten_pipe(expr->right, stages);
+        } else {
+            stages.push_back(expr);
+        }
+    }
+
+    // The query as `.path[] | rest`: false unless it starts with plain field
+    // accesses and an iterator. rest is null when nothing follows.
+    bool split_stream_query(const ExprPtr& root, std::vector<Key>& path, ExprPtr& rest) {
+        std::vector<ExprPtr> stages;
+        flatten_pipe(root, stages);
+        size_t i = 0;
+        for (; i < stages.size(); ++i) {
+            if (stages[i]->type == ExprType::Field && !stages[i]->optional) {
+                path.push_back(stages[i]->field_key);
+            } else if (stages[i]->type != ExprType::Identity) {
+                break;
+            }
+        }
+        if (i == stages.size() || stages[i]->type != ExprType::Iterator || stages[i]->optional) {
+            return false;
+        }
+        for (++i; i < stages.size(); ++i) {
+            if (!rest) {
+                rest = stages[i];
+            } else {
+                auto pipe_expr = std::make_shared<Expr>(ExprType::Pipe);
+                pipe_expr->left = rest;
+                pipe_expr->right = stages[i];
+                rest = pipe_expr;
+            }
+        }
+        return true;
+    }
+
+    // value nested under path[0, depth) in otherwise empty objects
+    Value wrap(Value value, const std::vector<Key>& path, size_t depth) {
+        while (depth > 0) {
+            Object obj;
+            obj.insert_or_assign(path[--depth], std::move(value));
+            value = Value(std::move(obj));
+        }
+        return value;
+    }
+
+    // Reads to the end of the depth objects .path runs through, innermost
+    // first. The tree keeps the last value of a repeated key, so a key of
+    // .path that comes again replaces what was read under it: returns the
+    // outermost level where that happens, with its last value in last, or
+    // path.size() if no key of .path repeats.
+    size_t finish_path(ToonReader& reader, const std::vector<Key>& path, size_t depth, Value& last) {
+        size_t repeated = path.size();
+        while (depth > 0) {
+            --depth;
+            while (reader.next() == ToonReader::Event::Key) {
+                bool again = path[depth] == reader.key();
+                reader.next();
+                if (again) {
+                    last = reader.read_value();
+                    repeated = depth;
+                } else {
+                    reader.skip_value();
+                }
+            }
+        }
+        return repeated;
+    }
+}
+
+std::vector<std::string> query(const std::string& expression, const std::string& data, Arena* arena) {
     // Tokenize and parse the expression
     Lexer lexer(expression);
     auto tokens = lexer.tokenize();
@@ -13,18 +85,48 @@ std::vector<std::string> query(const std::string& expression, const std::string&
     Parser parser(std::move(tokens));
     auto query_obj = parser.parse();
     
-    // Evaluate
+    // Parse the data, skipping whatever the query cannot read
+    auto projection = Projection::of(query_obj);
+    Value data_value = ToonParser::parse(data, arena, 1, projection.get());
+    
+    // Evaluate; navigation results are serialized straight from the document
     Evaluator evaluator;
-    auto results = evaluator.eval(query_obj.root, data_value);
+    auto results = evaluator.eval_refs(query_obj.root, data_value);
     
     // Convert results to TOON strings
     std::vector<std::string> toon_results;
     toon_results.reserve(results.size());
     
     for (const auto& result : results) {
+        toon_results.push_back(result->to_toon());
+    }
+    
+    return toon_results;
+}
+
+std::vector<std::string> query(const std::string& expression, const Tape& data) {
+    Lexer lexer(expression);
+    Parser parser(lexer.tokenize());
+    auto query_obj = parser.parse();
+    
+    Evaluator evaluator;
+    std::vector<std::string> toon_results;
+    for (const auto& result : evaluator.eval(query_obj.root, data)) {
         toon_results.push_back(result.to_toon());
     }
+    return toon_results;
+}
+
+std::vector<std::string> query(const std::string& expression, const LazyDocument& data) {
+    Lexer lexer(expression);
+    Parser parser(lexer.tokenize());
+    auto query_obj = parser.parse();
     
+    Evaluator evaluator;
+    std::vector<std::string> toon_results;
+    for (const auto& result : evaluator.eval(query_obj.root, data)) {
+        toon_results.push_back(result.to_toon());
+    }
     return toon_results;
 }
 
@@ -41,4 +143,90 @@ std::vector<Value> query_values(const std::string& expression, const Value& data
     return evaluator.eval(query_obj.root, data);
 }
 
+std::vector<ValueRef> query_refs(const std::string& expression, const Value& data) {
+    Lexer lexer(expression);
+    Parser parser(lexer.tokenize());
+    auto query_obj = parser.parse();
+    
+    Evaluator evaluator;
+    return evaluator.eval_refs(query_obj.root, data);
+}
+
+bool query_stream(const std::string& expression, std::istream& in, const std::function<void(const Value&)>& emit) {
+    Lexer lexer(expression);
+    Parser parser(lexer.tokenize());
+    auto query_obj = parser.parse();
+
+    std::vector<Key> path;
+    ExprPtr rest;
+    if (!split_stream_query(query_obj.root, path, rest)) {
+        return false;
+    }
+
+    Evaluator evaluator;
+    ToonReader reader(in);
+    reader.next();
+
+    // Descend to .path, skipping every sibling on the way. Keys are
+    // compared as text, so the siblings' names are never interned.
+    size_t depth = 0;
+    while (depth < path.size() && reader.event() == ToonReader::Event::BeginObject) {
+        bool found = false;
+        while (reader.next() == ToonReader::Event::Key) {
+            bool match = path[depth] == reader.key();
+            reader.next();
+            if (match) {
+                found = true;
+                break;
+            }
+            reader.skip_value();
+        }
+        if (!found) {
+            break;
+        }
+        ++depth;
+    }
+
+    Value last;
+    if (depth == path.size() && reader.event() == ToonReader::Event::BeginArray) {
+        bool emitted = false;
+        while (reader.next() != ToonReader::Event::EndArray) {
+            Value item = reader.read_value();
+            if (!rest) {
+                emit(item);
+                emitted = true;
+                continue;
+            }
+            for (const auto& result : evaluator.eval(rest, item)) {
+                emit(result);
+                emitted = true;
+            }
+        }
+        size_t repeated = finish_path(reader, path, depth, last);
+        if (repeated == path.size()) {
+            return true;
+        }
+        if (emitted) {
+            // What went out cannot be taken back
+            throw std::runtime_error("Key '" + path[repeated].str() + "' repeats on the streamed path; "
+                                     "results so far came from its first value");
+        }
+        for (const auto& result : evaluator.eval(query_obj.root, wrap(std::move(last), path, repeated + 1))) {
+            emit(result);
+        }
+        return true;
+    }
+
+    // .path is missing or not an array: rebuild just enough of the document
+    // for the query to behave (or fail) as query() would
+    bool missing = depth < path.size() && reader.event() == ToonReader::Event::EndObject;
+    Value found = missing ? Value(Object()) : reader.read_value();
+    size_t repeated = finish_path(reader, path, depth, last);
+    Value data = repeated == path.size() ? wrap(std::move(found), path, depth) : wrap(std::move(last), path, repeated + 1);
+    for (const auto& result : evaluator.eval(query_obj.root, data)) {
+        emit(result);
+    }
+    return true;
+}
+
 } // namespace tq
@@ -1,141 +1,1344 @@
 #include "tq/value.hpp"
+#include <atomic>
 #include <sstream>
 #include <iomanip>
 #include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <unordered_map>
 
 namespace tq {
 
+namespace detail {
+
+// Heap storage shared between Value copies. A node is treated as immutable
+// while more than one Value refers to it; writers clone it first.
+struct Node {
+    std::atomic<uint32_t> refs{1};
+    bool in_arena = false;  // memory belongs to an Arena; only the destructor runs
+};
+
+struct StringNode : Node {
+    std::string str;
+    explicit StringNode(std::string s) : str(std::move(s)) {}
+};
+
+struct ArrayNode : Node {
+    std::vector<Value> items;
+    std::atomic<uint32_t> views{0};  // references held by SnapshotNodes
+    std::atomic<size_t> hash{0};
+    explicit ArrayNode(std::vector<Value> v) : items(std::move(v)) {}
+};
+
+struct ObjectNode : Node {
+    Object fields;
+    std::atomic<size_t> hash{0};
+    explicit ObjectNode(Object o) : fields(std::move(o)) {}
+};
+
+// Element vector of a virtual array, built at most once, on first demand,
+// and published with a compare-and-swap so concurrent readers of a shared
+// node agree on a single copy.
+template <typename Make>
+const std::vector<Value>& materialize(std::atomic<ArrayNode*>& slot, size_t n, Make make) {
+    ArrayNode* node = slot.load(std::memory_order_acquire);
+    if (node) {
+        return node->items;
+    }
+    
+    std::vector<Value> items;
+    items.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        items.push_back(make(i));
+    }
+    auto* built = new ArrayNode(std::move(items));
+    if (!slot.compare_exchange_strong(node, built, std::memory_order_acq_rel)) {
+        delete built;  // another thread won; node now holds its copy
+        return node->items;
+    }
+    return built->items;
+}
+
+// Column-wise table. The row objects are materialized like any virtual
+// array's elements; a single row asked for on its own is built alone and
+// kept in its slot of row_slots.
+struct TableNode : Node {
+    std::vector<Key> keys;
+    std::vector<Column> columns;
+    size_t rows;
+    const Shape* shape;  // shared by every row; nullptr if keys has no shape
+    std::atomic<ArrayNode*> materialized{nullptr};
+    std::atomic<std::atomic<Value*>*> row_slots{nullptr};
+    std::atomic<size_t> hash{0};
+    
+    TableNode(std::vector<Key> k, std::vector<Column> c)
+        : keys(std::move(k)), columns(std::move(c)), rows(columns.front().size()), shape(Shape::of(keys)) {}
+    ~TableNode() {
+        delete materialized.load(std::memory_order_acquire);
+        if (auto* slots = row_slots.load(std::memory_order_acquire)) {
+            for (size_t r = 0; r < rows; ++r) {
+                delete slots[r].load(std::memory_order_relaxed);
+            }
+            delete[] slots;
+        }
+    }
+    
+    long column_index(Key key) const {
+        if (shape) {
+            return shape->slot(key);
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) return static_cast<long>(i);
+        }
+        return -1;
+    }
+    
+    Object row_object(size_t row) const {
+        if (shape) {
+            std::vector<Value> values;
+            values.reserve(columns.size());
+            for (const auto& column : columns) {
+                values.push_back(column[row]);
+            }
+            return Object(shape, std::move(values));
+        }
+        Object obj;
+        obj.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            obj.insert_or_assign(keys[i], columns[i][row]);
+        }
+        return obj;
+    }
+    
+    const std::vector<Value>& row_objects() {
+        return materialize(materialized, rows, [this](size_t r) { return Value(row_object(r)); });
+    }
+    
+    // Row r as an object that lives as long as the table, without building
+    // the other rows
+    const Value& row_value(size_t r) {
+        if (ArrayNode* all = materialized.load(std::memory_order_acquire)) {
+            return all->items[r];
+        }
+        auto* slots = row_slots.load(std::memory_order_acquire);
+        if (!slots) {
+            auto* fresh = new std::atomic<Value*>[rows]();
+            if (row_slots.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel)) {
+                slots = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        Value* row = slots[r].load(std::memory_order_acquire);
+        if (!row) {
+            auto* built = new Value(row_object(r));
+            if (slots[r].compare_exchange_strong(row, built, std::memory_order_acq_rel)) {
+                row = built;
+            } else {
+                delete built;
+            }
+        }
+        return *row;
+    }
+};
+
+// Array computed from the index: from + i * step, or item for every i
+struct SequenceNode : Node {
+    int64_t from = 0;
+    int64_t step = 0;
+    Value item;
+    bool repeat;
+    size_t count;
+    std::atomic<ArrayNode*> materialized{nullptr};
+    std::atomic<size_t> hash{0};
+    
+    SequenceNode(int64_t f, int64_t s, size_t n) : from(f), step(s), repeat(false), count(n) {}
+    SequenceNode(Value v, size_t n) : item(std::move(v)), repeat(true), count(n) {}
+    ~SequenceNode() { delete materialized.load(std::memory_order_acquire); }
+    
+    Value at(size_t i) const {
+        return repeat ? item : Value(from + static_cast<int64_t>(i) * step);
+    }
+    
+    const std::vector<Value>& items() {
+        return materialize(materialized, count, [this](size_t i) { return at(i); });
+    }
+};
+
+// First count elements of a plain array node that may still grow. The node
+// is only ever appended to while views are on it (see Value::append), so the
+// prefix never changes.
+struct SnapshotNode : Node {
+    Value owner;  // keeps base alive
+    ArrayNode* base;
+    size_t count;
+    std::atomic<ArrayNode*> materialized{nullptr};
+    std::atomic<size_t> hash{0};
+    
+    SnapshotNode(Value o, ArrayNode* b) : owner(std::move(o)), base(b), count(b->items.size()) {
+        base->views.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~SnapshotNode() {
+        base->views.fetch_sub(1, std::memory_order_release);
+        delete materialized.load(std::memory_order_acquire);
+    }
+    
+    const std::vector<Value>& items() {
+        return materialize(materialized, count, [this](size_t i) { return base->items[i]; });
+    }
+};
+
+} // namespace detail
+
+namespace {
+    template <typename T, typename... Args>
+    T* make_node(Arena* arena, Args&&... args) {
+        if (!arena) {
+            return new T(std::forward<Args>(args)...);
+        }
+        T* node = new (arena->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        node->in_arena = true;
+        return node;
+    }
+    
+    template <typename T>
+    void destroy_node(T* node) {
+        if (node->in_arena) {
+            node->~T();
+        } else {
+            delete node;
+        }
+    }
+    
+
+    detail::StringNode* string_node(detail::Node* n) { return static_cast<detail::StringNode*>(n); }
+    detail::ArrayNode* array_node(detail::Node* n) { return static_cast<detail::ArrayNode*>(n); }
+    detail::ObjectNode* object_node(detail::Node* n) { return static_cast<detail::ObjectNode*>(n); }
+    detail::TableNode* table_node(detail::Node* n) { return static_cast<detail::TableNode*>(n); }
+    detail::SequenceNode* sequence_node(detail::Node* n) { return static_cast<detail::SequenceNode*>(n); }
+    detail::SnapshotNode* snapshot_node(detail::Node* n) { return static_cast<detail::SnapshotNode*>(n); }
+}
+
 // Constructors
-Value::Value() : type_(Type::Null), data_(std::monostate{}) {}
 
-Value::Value(bool b) : type_(Type::Boolean), data_(b) {}
+Value::Value(const std::string& s) : type_(Type::String) { payload_.node = new detail::StringNode(s); }
 
-Value::Value(double d) : type_(Type::Number), data_(d) {}
+Value::Value(std::string&& s) : type_(Type::String) { payload_.node = new detail::StringNode(std::move(s)); }
 
-Value::Value(int i) : type_(Type::Number), data_(static_cast<double>(i)) {}
+Value::Value(const char* s) : type_(Type::String) { payload_.node = new detail::StringNode(s); }
 
-Value::Value(const std::string& s) : type_(Type::String), data_(s) {}
+Value::Value(std::vector<Value>&& arr, Arena* arena) : type_(Type::Array) {
+    payload_.node = make_node<detail::ArrayNode>(arena, std::move(arr));
+}
+
+Value::Value(const std::vector<Value>& arr) : type_(Type::Array) {
+    payload_.node = new detail::ArrayNode(arr);
+}
 
-Value::Value(std::string&& s) : type_(Type::String), data_(std::move(s)) {}
+Value::Value(Object&& obj, Arena* arena) : type_(Type::Object) {
+    payload_.node = make_node<detail::ObjectNode>(arena, std::move(obj));
+}
 
-Value::Value(const char* s) : type_(Type::String), data_(std::string(s)) {}
+Value::Value(const Object& obj) : type_(Type::Object) {
+    payload_.node = new detail::ObjectNode(obj);
+}
 
-Value::Value(std::vector<Value>&& arr) : type_(Type::Array), data_(std::move(arr)) {}
+Value::Value(const std::map<std::string, Value>& obj) : type_(Type::Object) {
+    Object fields;
+    fields.reserve(obj.size());
+    for (const auto& [key, val] : obj) {
+        fields.insert_or_assign(key, val);
+    }
+    payload_.node = new detail::ObjectNode(std::move(fields));
+}
 
-Value::Value(const std::vector<Value>& arr) : type_(Type::Array), data_(arr) {}
+Value Value::table(std::vector<Key> keys, std::vector<std::vector<Value>> columns, Arena* arena) {
+    if (keys.empty() || keys.size() != columns.size()) {
+        throw std::invalid_argument("Table needs one column per key");
+    }
+    for (const auto& column : columns) {
+        if (column.size() != columns.front().size()) {
+            throw std::invalid_argument("Table columns differ in length");
+        }
+    }
+    
+    std::vector<Column> stored;
+    stored.reserve(columns.size());
+    for (auto& column : columns) {
+        stored.emplace_back(std::move(column));
+    }
+    
+    Value result;
+    result.type_ = Type::Array;
+    result.subtype_ = kTable;
+    result.payload_.node = make_node<detail::TableNode>(arena, std::move(keys), std::move(stored));
+    return result;
+}
 
-Value::Value(std::map<std::string, Value>&& obj) : type_(Type::Object), data_(std::move(obj)) {}
+Value Value::range(int64_t from, int64_t to, int64_t step) {
+    if (step == 0) {
+        throw std::invalid_argument("Range step must not be 0");
+    }
+    // Distances in uint64_t: to - from can exceed INT64_MAX
+    size_t count = 0;
+    if (step > 0 && from < to) {
+        count = static_cast<size_t>((static_cast<uint64_t>(to) - static_cast<uint64_t>(from) - 1) /
+                                    static_cast<uint64_t>(step) + 1);
+    } else if (step < 0 && from > to) {
+        count = static_cast<size_t>((static_cast<uint64_t>(from) - static_cast<uint64_t>(to) - 1) /
+                                    (0 - static_cast<uint64_t>(step)) + 1);
+    }
+    
+    Value result;
+    result.type_ = Type::Array;
+    result.subtype_ = kSequence;
+    result.payload_.node = new detail::SequenceNode(from, step, count);
+    return result;
+}
 
-Value::Value(const std::map<std::string, Value>& obj) : type_(Type::Object), data_(obj) {}
+Value Value::repeat(Value item, size_t count) {
+    Value result;
+    result.type_ = Type::Array;
+    result.subtype_ = kSequence;
+    result.payload_.node = new detail::SequenceNode(std::move(item), count);
+    return result;
+}
 
-// Rule of 5
-Value::Value(const Value& other) : type_(other.type_), data_(other.data_) {}
+Value Value::snapshot() const {
+    if (type_ != Type::Array || subtype_ != kPlain) {
+        return *this;
+    }
+    Value result;
+    result.type_ = Type::Array;
+    result.subtype_ = kSnapshot;
+    result.payload_.node = new detail::SnapshotNode(*this, array_node(payload_.node));
+    return result;
+}
 
-Value::Value(Value&& other) noexcept : type_(other.type_), data_(std::move(other.data_)) {
-    other.type_ = Type::Null;
-    other.data_ = std::monostate{};
+void Value::append(const std::vector<Value>& items) {
+    if (type_ != Type::Array) {
+        throw std::runtime_error("Value is not an array");
+    }
+    // Snapshots only read their prefix, so they are not owners here
+    if (subtype_ == kPlain) {
+        auto* node = array_node(payload_.node);
+        if (node->refs.load(std::memory_order_acquire) - node->views.load(std::memory_order_acquire) == 1) {
+            node->items.insert(node->items.end(), items.begin(), items.end());
+            node->hash.store(0, std::memory_order_relaxed);
+            return;
+        }
+    }
+    auto& own = as_array();
+    own.insert(own.end(), items.begin(), items.end());
+}
+
+// Column
+
+Column::Column(std::vector<Value> values) {
+    if (values.size() < kMinEncodedRows) {
+        values_ = std::move(values);
+        return;
+    }
+    
+    // Collect distinct strings, giving up as soon as the column looks unsuitable
+    std::unordered_map<std::string_view, uint32_t> seen;
+    std::vector<uint32_t> first_row;
+    codes_.reserve(values.size());
+    for (size_t row = 0; row < values.size(); ++row) {
+        if (!values[row].is_string()) {
+            codes_ = {};
+            values_ = std::move(values);
+            return;
+        }
+        auto [it, inserted] = seen.try_emplace(values[row].as_string_view(), static_cast<uint32_t>(first_row.size()));
+        if (inserted) {
+            if (first_row.size() == kMaxDictionary) {
+                codes_ = {};
+                values_ = std::move(values);
+                return;
+            }
+            first_row.push_back(static_cast<uint32_t>(row));
+        }
+        codes_.push_back(static_cast<uint8_t>(it->second));  // first-seen order, remapped below
+    }
+    
+    // Sort the dictionary so codes order like the strings they stand for
+    std::vector<uint32_t> order(first_row.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return values[first_row[a]].as_string_view() < values[first_row[b]].as_string_view();
+    });
+    std::vector<uint8_t> code(order.size());
+    dictionary_.reserve(order.size());
+    for (size_t rank = 0; rank < order.size(); ++rank) {
+        code[order[rank]] = static_cast<uint8_t>(rank);
+        dictionary_.push_back(values[first_row[order[rank]]]);
+    }
+    
+    for (auto& c : codes_) {
+        c = code[c];
+    }
+}
+
+int Column::code_of(std::string_view str) const {
+    auto it = std::lower_bound(dictionary_.begin(), dictionary_.end(), str,
+                               [](const Value& entry, std::string_view s) { return entry.as_string_view() < s; });
+    if (it == dictionary_.end() || it->as_string_view() != str) {
+        return -1;
+    }
+    return static_cast<int>(it - dictionary_.begin());
+}
+
+std::vector<Value> Column::values() const {
+    if (!encoded()) {
+        return values_;
+    }
+    std::vector<Value> result;
+    result.reserve(codes_.size());
+    for (uint8_t code : codes_) {
+        result.push_back(dictionary_[code]);
+    }
+    return result;
+}
+
+// Copies: moves and destruction are inline in the header
+Value::Value(const Value& other) {
+    copy_bits(other);
+    retain();
 }
 
 Value& Value::operator=(const Value& other) {
     if (this != &other) {
-        type_ = other.type_;
-        data_ = other.data_;
+        other.retain();
+        release();
+        copy_bits(other);
     }
     return *this;
 }
 
-Value& Value::operator=(Value&& other) noexcept {
-    if (this != &other) {
-        type_ = other.type_;
-        data_ = std::move(other.data_);
-        other.type_ = Type::Null;
-        other.data_ = std::monostate{};
+void Value::retain() const {
+    if (holds_node()) {
+        payload_.node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Value::release() {
+    if (!holds_node()) return;
+    if (payload_.node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    
+    if (subtype_ == kTable || subtype_ == kRow) {
+        destroy_node(table_node(payload_.node));
+        return;
+    }
+    if (subtype_ == kSequence) {
+        destroy_node(sequence_node(payload_.node));
+        return;
+    }
+    if (subtype_ == kSnapshot) {
+        destroy_node(snapshot_node(payload_.node));
+        return;
+    }
+    switch (type_) {
+        case Type::String: destroy_node(string_node(payload_.node)); break;
+        case Type::Array: destroy_node(array_node(payload_.node)); break;
+        case Type::Object: destroy_node(object_node(payload_.node)); break;
+        default: break;
     }
-    return *this;
 }
 
-Value::~Value() = default;
+// Copy-on-write: clone the container node if another Value still shares it
+void Value::detach() {
+    if (!holds_node()) {
+        return;
+    }
+    
+    // Tables, rows, sequences and snapshots have no element storage of their
+    // own to hand out; convert them to plain containers before mutation
+    if (subtype_ == kTable || subtype_ == kRow || subtype_ == kSequence || subtype_ == kSnapshot) {
+        detail::Node* copy;
+        if (subtype_ == kSequence) {
+            copy = new detail::ArrayNode(sequence_node(payload_.node)->items());
+        } else if (subtype_ == kSnapshot) {
+            copy = new detail::ArrayNode(snapshot_node(payload_.node)->items());
+        } else if (subtype_ == kTable) {
+            copy = new detail::ArrayNode(table_node(payload_.node)->row_objects());
+        } else {
+            copy = new detail::ObjectNode(table_node(payload_.node)->row_object(offset_));
+        }
+        release();
+        payload_.node = copy;
+        subtype_ = kPlain;
+        offset_ = 0;
+        return;
+    }
+    
+    if (payload_.node->refs.load(std::memory_order_acquire) == 1) {
+        return;
+    }
+    
+    detail::Node* copy = nullptr;
+    if (type_ == Type::Array) {
+        copy = new detail::ArrayNode(array_node(payload_.node)->items);
+    } else if (type_ == Type::Object) {
+        copy = new detail::ObjectNode(object_node(payload_.node)->fields);
+    } else {
+        return;
+    }
+    release();
+    payload_.node = copy;
+}
 
 // Getters
 bool Value::as_boolean() const {
     if (type_ != Type::Boolean) {
         throw std::runtime_error("Value is not a boolean");
     }
-    return std::get<bool>(data_);
+    return payload_.boolean;
 }
 
 double Value::as_number() const {
     if (type_ != Type::Number) {
         throw std::runtime_error("Value is not a number");
     }
-    return std::get<double>(data_);
+    return subtype_ == kInteger ? static_cast<double>(payload_.integer) : payload_.number;
+}
+
+int64_t Value::as_integer() const {
+    if (!is_integer()) {
+        throw std::runtime_error("Value is not an integer");
+    }
+    return payload_.integer;
+}
+
+bool Value::try_parse_number(std::string_view text, Value& out) noexcept {
+    const char* p = text.data();
+    const char* last = p + text.size();
+    bool negative = false;
+    if (p != last && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    const char* digits = p;  // from_chars rejects a plus sign, and gets no sign
+    
+    // One pass over [-+]digits[.digits][(e|E)[-+]digits], accumulating up
+    // to 19 significant digits; anything longer takes the slow path below
+    uint64_t mantissa = 0;
+    int significant = 0;   // digits in mantissa, leading zeros excluded
+    int dropped = 0;       // digits that did not fit in mantissa
+    int64_t scale = 0;     // mantissa * 10^scale is the value
+    bool any_digit = false;
+    for (; p != last && static_cast<unsigned>(*p - '0') < 10; ++p) {
+        any_digit = true;
+        if (significant < 19) {
+            mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+            significant += mantissa != 0;
+        } else {
+            dropped++;
+        }
+    }
+    bool is_double = false;
+    if (p != last && *p == '.') {
+        is_double = true;
+        for (++p; p != last && static_cast<unsigned>(*p - '0') < 10; ++p) {
+            any_digit = true;
+            if (significant < 19) {
+                mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+                significant += mantissa != 0;
+                scale--;
+            } else {
+                dropped++;
+            }
+        }
+    }
+    if (!any_digit) {
+        return false;
+    }
+    if (p != last && (*p == 'e' || *p == 'E')) {
+        is_double = true;
+        ++p;
+        bool negative_exponent = false;
+        if (p != last && (*p == '-' || *p == '+')) {
+            negative_exponent = *p == '-';
+            ++p;
+        }
+        if (p == last) {
+            return false;
+        }
+        int64_t exponent = 0;
+        for (; p != last && static_cast<unsigned>(*p - '0') < 10; ++p) {
+            exponent = std::min<int64_t>(exponent * 10 + (*p - '0'), 1000000);
+        }
+        scale += negative_exponent ? -exponent : exponent;
+    }
+    if (p != last) {
+        return false;
+    }
+    
+    if (!is_double && dropped == 0) {
+        // 19 digits can still overflow int64; -2^63 is the one value whose
+        // magnitude is not a positive int64
+        constexpr uint64_t limit = static_cast<uint64_t>(INT64_MAX);
+        if (mantissa <= limit) {
+            int64_t value = static_cast<int64_t>(mantissa);
+            out = Value(negative ? -value : value);
+            return true;
+        }
+        if (negative && mantissa == limit + 1) {
+            out = Value(INT64_MIN);
+            return true;
+        }
+        // Too large for int64: keep the magnitude as a double
+    }
+    
+    // Exact when the mantissa and the power of ten are both exact doubles:
+    // one correctly rounded multiply or divide (Clinger's fast path)
+    static constexpr double kPowers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    double d = 0.0;
+    if (dropped == 0 && mantissa <= (uint64_t{1} << 53) && scale >= -22 && scale <= 22) {
+        d = static_cast<double>(mantissa);
+        d = scale < 0 ? d / kPowers[-scale] : d * kPowers[scale];
+    } else {
+        // Long mantissas and large exponents; the grammar is already checked
+        auto [end, ec] = std::from_chars(digits, last, d);
+        if (ec != std::errc() || end != last) {
+            return false;  // out of double range
+        }
+    }
+    // Normalize -0 to 0
+    out = Value(negative && d != 0.0 ? -d : d);
+    return true;
+}
+
+Value Value::parse_number(std::string_view text) {
+    Value number;
+    if (!try_parse_number(text, number)) {
+        throw std::invalid_argument("Invalid number: " + std::string(text));
+    }
+    return number;
+}
+
+std::string Value::as_string() const {
+    return std::string(as_string_view());
 }
 
-const std::string& Value::as_string() const {
+std::string_view Value::as_string_view() const {
     if (type_ != Type::String) {
         throw std::runtime_error("Value is not a string");
     }
-    return std::get<std::string>(data_);
+    std::string_view text = string_node(payload_.node)->str;
+    return subtype_ == kBorrowed ? text.substr(offset_, length_) : text;
+}
+
+Value InputBuffer::slice(std::string_view part) const {
+    std::string_view text = view();
+    size_t offset = static_cast<size_t>(part.data() - text.data());
+    if (part.size() > Value::kMaxBorrowedLength || offset > Value::kMaxBorrowedOffset) {
+        return Value(std::string(part));
+    }
+    
+    Value result = text_;  // shares the buffer node
+    result.subtype_ = Value::kBorrowed;
+    result.offset_ = static_cast<uint32_t>(offset);
+    result.length_ = static_cast<uint16_t>(part.size());
+    return result;
+}
+
+Value InputBuffer::slice(std::string_view part, uint32_t& reserved) const {
+    std::string_view text = view();
+    size_t offset = static_cast<size_t>(part.data() - text.data());
+    if (part.size() > Value::kMaxBorrowedLength || offset > Value::kMaxBorrowedOffset) {
+        return Value(std::string(part));
+    }
+    
+    constexpr uint32_t kBatch = 4096;
+    if (reserved == 0) {
+        text_.payload_.node->refs.fetch_add(kBatch, std::memory_order_relaxed);
+        reserved = kBatch;
+    }
+    reserved--;
+    
+    Value result;  // takes over one reserved reference
+    result.type_ = Value::Type::String;
+    result.payload_.node = text_.payload_.node;
+    result.subtype_ = Value::kBorrowed;
+    result.offset_ = static_cast<uint32_t>(offset);
+    result.length_ = static_cast<uint16_t>(part.size());
+    return result;
+}
+
+void InputBuffer::unreserve(uint32_t& reserved) const {
+    // text_ holds a reference of its own, so this never drops the last one
+    if (reserved > 0) {
+        text_.payload_.node->refs.fetch_sub(reserved, std::memory_order_release);
+        reserved = 0;
+    }
 }
 
 const std::vector<Value>& Value::as_array() const {
     if (type_ != Type::Array) {
         throw std::runtime_error("Value is not an array");
     }
-    return std::get<std::vector<Value>>(data_);
+    if (subtype_ == kTable) {
+        return table_node(payload_.node)->row_objects();
+    }
+    if (subtype_ == kSequence) {
+        return sequence_node(payload_.node)->items();
+    }
+    if (subtype_ == kSnapshot) {
+        return snapshot_node(payload_.node)->items();
+    }
+    return array_node(payload_.node)->items;
 }
 
 std::vector<Value>& Value::as_array() {
     if (type_ != Type::Array) {
         throw std::runtime_error("Value is not an array");
     }
-    return std::get<std::vector<Value>>(data_);
+    detach();
+    hash_slot()->store(0, std::memory_order_relaxed);
+    return array_node(payload_.node)->items;
 }
 
-const std::map<std::string, Value>& Value::as_object() const {
+const Object& Value::as_object() const {
     if (type_ != Type::Object) {
         throw std::runtime_error("Value is not an object");
     }
-    return std::get<std::map<std::string, Value>>(data_);
+    if (subtype_ == kRow) {
+        return table_node(payload_.node)->row_value(offset_).as_object();
+    }
+    return object_node(payload_.node)->fields;
 }
 
-std::map<std::string, Value>& Value::as_object() {
+Object& Value::as_object() {
     if (type_ != Type::Object) {
         throw std::runtime_error("Value is not an object");
     }
-    return std::get<std::map<std::string, Value>>(data_);
+    detach();
+    hash_slot()->store(0, std::memory_order_relaxed);
+    return object_node(payload_.node)->fields;
 }
 
 // Safe access
 const Value* Value::get(const std::string& key) const {
+    Key found = Key::find(key);
+    return found ? get(found) : nullptr;
+}
+
+Value* Value::get(const std::string& key) {
+    Key found = Key::find(key);
+    return found ? get(found) : nullptr;
+}
+
+const Value* Value::get(Key key) const {
     if (type_ != Type::Object) return nullptr;
-    const auto& obj = std::get<std::map<std::string, Value>>(data_);
+    if (subtype_ == kRow) {
+        const auto* table = table_node(payload_.node);
+        long column = table->column_index(key);
+        return column < 0 ? nullptr : &table->columns[column][offset_];
+    }
+    const auto& obj = object_node(payload_.node)->fields;
     auto it = obj.find(key);
     return (it != obj.end()) ? &it->second : nullptr;
 }
 
-Value* Value::get(const std::string& key) {
+const Value* Value::get(Key key, const FieldCache& cache) const {
     if (type_ != Type::Object) return nullptr;
-    auto& obj = std::get<std::map<std::string, Value>>(data_);
+    
+    const Shape* shape;
+    if (subtype_ == kRow) {
+        shape = table_node(payload_.node)->shape;
+    } else {
+        shape = object_node(payload_.node)->fields.shape();
+    }
+    if (!shape) {
+        return get(key);
+    }
+    
+    // A miss is cached too, as slot kNoSlot
+    constexpr uint32_t kNoSlot = UINT32_MAX;
+    uint32_t slot;
+    if (!cache.lookup(shape, slot)) {
+        long found = shape->slot(key);
+        slot = found < 0 ? kNoSlot : static_cast<uint32_t>(found);
+        cache.update(shape, slot);
+    }
+    if (slot == kNoSlot) {
+        return nullptr;
+    }
+    if (subtype_ == kRow) {
+        return &table_node(payload_.node)->columns[slot][offset_];
+    }
+    return &object_node(payload_.node)->fields.value_at(slot);
+}
+
+Value* Value::get(Key key) {
+    if (type_ != Type::Object) return nullptr;
+    detach();
+    hash_slot()->store(0, std::memory_order_relaxed);
+    auto& obj = object_node(payload_.node)->fields;
     auto it = obj.find(key);
     return (it != obj.end()) ? &it->second : nullptr;
 }
 
 const Value* Value::get(size_t index) const {
     if (type_ != Type::Array) return nullptr;
-    const auto& arr = std::get<std::vector<Value>>(data_);
+    if (subtype_ == kTable) {
+        auto* table = table_node(payload_.node);
+        return index < table->rows ? &table->row_value(index) : nullptr;
+    }
+    const auto& arr = as_array();
     return (index < arr.size()) ? &arr[index] : nullptr;
 }
 
 Value* Value::get(size_t index) {
     if (type_ != Type::Array) return nullptr;
-    auto& arr = std::get<std::vector<Value>>(data_);
+    detach();
+    hash_slot()->store(0, std::memory_order_relaxed);
+    auto& arr = array_node(payload_.node)->items;
     return (index < arr.size()) ? &arr[index] : nullptr;
 }
 
+size_t Value::array_size() const {
+    if (type_ != Type::Array) {
+        throw std::runtime_error("Value is not an array");
+    }
+    if (subtype_ == kTable) {
+        return table_node(payload_.node)->rows;
+    }
+    if (subtype_ == kSequence) {
+        return sequence_node(payload_.node)->count;
+    }
+    if (subtype_ == kSnapshot) {
+        return snapshot_node(payload_.node)->count;
+    }
+    return array_node(payload_.node)->items.size();
+}
+
+Value Value::element(size_t index) const {
+    if (index >= array_size()) {
+        throw std::out_of_range("Array index out of range");
+    }
+    if (subtype_ == kSequence) {
+        return sequence_node(payload_.node)->at(index);
+    }
+    if (subtype_ == kSnapshot) {
+        return snapshot_node(payload_.node)->base->items[index];
+    }
+    if (subtype_ != kTable) {
+        return array_node(payload_.node)->items[index];
+    }
+    
+    if (index > UINT32_MAX) {
+        return Value(table_node(payload_.node)->row_object(index));
+    }
+    
+    Value row;
+    row.type_ = Type::Object;
+    row.subtype_ = kRow;
+    row.offset_ = static_cast<uint32_t>(index);
+    row.payload_.node = payload_.node;
+    retain();
+    return row;
+}
+
+const Column* Value::column(Key key) const {
+    if (!is_table()) return nullptr;
+    const auto* table = table_node(payload_.node);
+    long index = table->column_index(key);
+    return index < 0 ? nullptr : &table->columns[index];
+}
+
+// Comparison and hashing
+
+namespace {
+    // Exact ordering of two numbers, including int64 values beyond 2^53.
+    // NaN sorts below every other number and equal to itself.
+    int compare_numbers(const Value& a, const Value& b) {
+        if (a.is_integer() && b.is_integer()) {
+            int64_t x = a.as_integer();
+            int64_t y = b.as_integer();
+            return x < y ? -1 : (x > y ? 1 : 0);
+        }
+        if (a.is_integer() != b.is_integer()) {
+            // Mixed: compare the integer against the double without rounding it
+            bool flip = b.is_integer();
+            int64_t i = flip ? b.as_integer() : a.as_integer();
+            double d = flip ? a.as_number() : b.as_number();
+            int cmp;
+            if (std::isnan(d)) {
+                cmp = 1;
+            } else if (d >= 9223372036854775808.0) {
+                cmp = -1;
+            } else if (d < -9223372036854775808.0) {
+                cmp = 1;
+            } else {
+                int64_t whole = static_cast<int64_t>(d);
+                if (i != whole) {
+                    cmp = i < whole ? -1 : 1;
+                } else {
+                    double frac = d - static_cast<double>(whole);
+                    cmp = frac > 0 ? -1 : (frac < 0 ? 1 : 0);
+                }
+            }
+            return flip ? -cmp : cmp;
+        }
+        double x = a.as_number();
+        double y = b.as_number();
+        if (std::isnan(x) || std::isnan(y)) {
+            return std::isnan(y) - std::isnan(x);
+        }
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    
+    int type_rank(const Value& v) {
+        switch (v.type()) {
+            case Value::Type::Null: return 0;
+            case Value::Type::Boolean: return v.as_boolean() ? 2 : 1;
+            case Value::Type::Number: return 3;
+            case Value::Type::String: return 4;
+            case Value::Type::Array: return 5;
+            case Value::Type::Object: return 6;
+        }
+        return 7;
+    }
+    
+    // splitmix64 finalizer
+    size_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return static_cast<size_t>(x);
+    }
+    
+    size_t hash_number(const Value& v) {
+        if (v.is_integer()) {
+            return mix(static_cast<uint64_t>(v.as_integer()));
+        }
+        // Whole doubles hash like the integer they equal
+        double d = v.as_number();
+        if (std::isnan(d)) {
+            return mix(0x7FF8000000000000ull);
+        }
+        if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == std::trunc(d)) {
+            return mix(static_cast<uint64_t>(static_cast<int64_t>(d)));
+        }
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return mix(bits);
+    }
+    
+    std::vector<Key> sorted_keys(const std::vector<Key>& keys) {
+        std::vector<Key> sorted = keys;
+        std::sort(sorted.begin(), sorted.end(), [](Key a, Key b) { return a.str() < b.str(); });
+        return sorted;
+    }
+}
+
+std::atomic<size_t>* Value::hash_slot() const {
+    if (subtype_ == kTable) return &table_node(payload_.node)->hash;
+    if (subtype_ == kSequence) return &sequence_node(payload_.node)->hash;
+    if (subtype_ == kSnapshot) return &snapshot_node(payload_.node)->hash;
+    if (type_ == Type::Array) return &array_node(payload_.node)->hash;
+    if (type_ == Type::Object && subtype_ != kRow) return &object_node(payload_.node)->hash;
+    return nullptr;
+}
+
+size_t Value::field_count() const {
+    return subtype_ == kRow ? table_node(payload_.node)->keys.size() : object_node(payload_.node)->fields.size();
+}
+
+Key Value::field_key(size_t i) const {
+    return subtype_ == kRow ? table_node(payload_.node)->keys[i] : object_node(payload_.node)->fields.key_at(i);
+}
+
+const Value& Value::field_value(size_t i) const {
+    return subtype_ == kRow ? table_node(payload_.node)->columns[i][offset_]
+                            : object_node(payload_.node)->fields.value_at(i);
+}
+
+size_t Value::hash() const {
+    switch (type_) {
+        case Type::Null: return mix(1);
+        case Type::Boolean: return mix(payload_.boolean ? 3 : 2);
+        case Type::Number: return hash_number(*this);
+        case Type::String: return std::hash<std::string_view>()(as_string_view());
+        default: break;
+    }
+    
+    std::atomic<size_t>* slot = hash_slot();
+    if (slot) {
+        size_t cached = slot->load(std::memory_order_relaxed);
+        if (cached != 0) {
+            return cached;
+        }
+    }
+    
+    size_t h;
+    if (type_ == Type::Array) {
+        // Order matters: fold elements in sequence
+        size_t n = array_size();
+        h = mix(n + 5);
+        for (size_t i = 0; i < n; ++i) {
+            size_t eh = subtype_ != kPlain ? element(i).hash() : array_node(payload_.node)->items[i].hash();
+            h = mix(h ^ eh) + i;
+        }
+    } else {
+        // Key order does not: sum one term per field
+        size_t n = field_count();
+        h = mix(n + 6);
+        for (size_t i = 0; i < n; ++i) {
+            h += mix((static_cast<uint64_t>(field_key(i).hash()) << 32) ^ field_value(i).hash());
+        }
+    }
+    h += (h == 0);  // 0 marks "not computed"
+    if (slot) {
+        slot->store(h, std::memory_order_relaxed);
+    }
+    return h;
+}
+
+bool Value::equals(const Value& other) const {
+    if (type_ != other.type_) {
+        return false;
+    }
+    switch (type_) {
+        case Type::Null: return true;
+        case Type::Boolean: return payload_.boolean == other.payload_.boolean;
+        case Type::Number: return compare_numbers(*this, other) == 0;
+        case Type::String:
+            return (same_node(other) && length_ == other.length_) || as_string_view() == other.as_string_view();
+        default: break;
+    }
+    if (same_node(other)) {
+        return true;
+    }
+    
+    // Differing cached hashes settle it without a walk
+    std::atomic<size_t>* slot = hash_slot();
+    std::atomic<size_t>* other_slot = other.hash_slot();
+    if (slot && other_slot) {
+        size_t h = slot->load(std::memory_order_relaxed);
+        size_t other_h = other_slot->load(std::memory_order_relaxed);
+        if (h != 0 && other_h != 0 && h != other_h) {
+            return false;
+        }
+    }
+    
+    if (type_ == Type::Array) {
+        size_t n = array_size();
+        if (n != other.array_size()) {
+            return false;
+        }
+        if (subtype_ == kPlain && other.subtype_ == kPlain) {
+            const auto& a = array_node(payload_.node)->items;
+            const auto& b = array_node(other.payload_.node)->items;
+            for (size_t i = 0; i < n; ++i) {
+                if (!a[i].equals(b[i])) return false;
+            }
+            return true;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (!element(i).equals(other.element(i))) return false;
+        }
+        return true;
+    }
+    
+    size_t n = field_count();
+    if (n != other.field_count()) {
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const Value* match = other.get(field_key(i));
+        if (!match || !field_value(i).equals(*match)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int Value::compare(const Value& other) const {
+    int a_rank = type_rank(*this);
+    int b_rank = type_rank(other);
+    if (a_rank != b_rank) {
+        return a_rank < b_rank ? -1 : 1;
+    }
+    
+    switch (type_) {
+        case Type::Null:
+        case Type::Boolean:
+            return 0;
+        case Type::Number:
+            return compare_numbers(*this, other);
+        case Type::String: {
+            if (same_node(other) && length_ == other.length_) {
+                return 0;  // e.g. rows of a dictionary-encoded column
+            }
+            int cmp = as_string_view().compare(other.as_string_view());
+            return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+        }
+        default:
+            break;
+    }
+    if (same_node(other)) {
+        return 0;
+    }
+    
+    if (type_ == Type::Array) {
+        size_t n = array_size();
+        size_t m = other.array_size();
+        for (size_t i = 0; i < n && i < m; ++i) {
+            int cmp = element(i).compare(other.element(i));
+            if (cmp != 0) return cmp;
+        }
+        return n < m ? -1 : (n > m ? 1 : 0);
+    }
+    
+    // Objects: sorted key lists first, then values in that key order
+    std::vector<Key> a_keys(field_count());
+    for (size_t i = 0; i < a_keys.size(); ++i) a_keys[i] = field_key(i);
+    std::vector<Key> b_keys(other.field_count());
+    for (size_t i = 0; i < b_keys.size(); ++i) b_keys[i] = other.field_key(i);
+    a_keys = sorted_keys(a_keys);
+    b_keys = sorted_keys(b_keys);
+    for (size_t i = 0; i < a_keys.size() && i < b_keys.size(); ++i) {
+        if (a_keys[i] != b_keys[i]) {
+            return a_keys[i].str() < b_keys[i].str() ? -1 : 1;
+        }
+    }
+    if (a_keys.size() != b_keys.size()) {
+        return a_keys.size() < b_keys.size() ? -1 : 1;
+    }
+    for (Key key : a_keys) {
+        int cmp = get(key)->compare(*other.get(key));
+        if (cmp != 0) return cmp;
+    }
+    return 0;
+}
+
+// Object
+
+Object::Object(std::initializer_list<std::pair<std::string_view, Value>> init) {
+    values_.reserve(init.size());
+    for (const auto& [key, val] : init) {
+        insert_or_assign(key, val);
+    }
+}
+
+Object::Object(const Shape* shape, std::vector<Value> values, Arena* arena)
+    : shape_(shape),
+      values_(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()),
+              arena ? arena : std::pmr::get_default_resource()) {
+    if (!shape_ || shape_->size() != values_.size()) {
+        throw std::invalid_argument("Object values do not match their shape");
+    }
+}
+
+Object::Object(const Object& other)
+    : shape_(other.shape_),
+      values_(other.values_),
+      dict_(other.dict_ ? std::make_unique<Dict>(*other.dict_) : nullptr) {}
+
+Object::Object(Object&& other) noexcept
+    : shape_(std::exchange(other.shape_, Shape::empty())),
+      values_(std::move(other.values_)),
+      dict_(std::move(other.dict_)) {
+    other.values_.clear();
+}
+
+Object& Object::operator=(Object&& other) {
+    if (this != &other) {
+        shape_ = std::exchange(other.shape_, Shape::empty());
+        values_ = std::move(other.values_);
+        dict_ = std::move(other.dict_);
+        other.values_.clear();
+    }
+    return *this;
+}
+
+Object& Object::operator=(const Object& other) {
+    if (this != &other) {
+        Object copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+long Object::find_position(Key key) const {
+    if (shape_) {
+        return shape_->slot(key);
+    }
+    
+    const auto& keys = dict_->keys;
+    if (dict_->index.empty()) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) {
+                return static_cast<long>(i);
+            }
+        }
+        return -1;
+    }
+    
+    size_t mask = dict_->index.size() - 1;
+    size_t slot = key.hash() & mask;
+    while (dict_->index[slot] != 0) {
+        uint32_t position = dict_->index[slot] - 1;
+        if (keys[position] == key) {
+            return static_cast<long>(position);
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+Object::iterator Object::find(Key key) {
+    long position = find_position(key);
+    return position < 0 ? end() : iterator(this, position);
+}
+
+Object::const_iterator Object::find(Key key) const {
+    long position = find_position(key);
+    return position < 0 ? end() : const_iterator(this, position);
+}
+
+Object::iterator Object::find(std::string_view key) {
+    Key found = Key::find(key);
+    return found ? find(found) : end();
+}
+
+Object::const_iterator Object::find(std::string_view key) const {
+    Key found = Key::find(key);
+    return found ? find(found) : end();
+}
+
+const Value& Object::at(std::string_view key) const {
+    auto it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("Object has no key: " + std::string(key));
+    }
+    return values_[it.position()];
+}
+
+Value& Object::at(std::string_view key) {
+    auto it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("Object has no key: " + std::string(key));
+    }
+    return values_[it.position()];
+}
+
+Value& Object::operator[](Key key) {
+    long position = find_position(key);
+    if (position >= 0) {
+        return values_[position];
+    }
+    return append(key, Value());
+}
+
+void Object::insert_or_assign(Key key, Value value) {
+    long position = find_position(key);
+    if (position >= 0) {
+        values_[position] = std::move(value);
+    } else {
+        append(key, std::move(value));
+    }
+}
+
+size_t Object::erase(std::string_view key) {
+    auto it = find(key);
+    if (it == end()) {
+        return 0;
+    }
+    size_t position = it.position();
+    values_.erase(values_.begin() + position);
+    
+    if (shape_) {
+        // Rebuild the shape from the remaining keys, in order
+        std::vector<Key> keys = shape_->keys();
+        keys.erase(keys.begin() + position);
+        shape_ = Shape::of(keys);
+        if (!shape_) {
+            dict_ = std::make_unique<Dict>();
+            dict_->keys = std::move(keys);
+            rebuild_index();
+        }
+    } else {
+        dict_->keys.erase(dict_->keys.begin() + position);
+        rebuild_index();
+    }
+    return 1;
+}
+
+Value& Object::append(Key key, Value value) {
+    if (shape_) {
+        const Shape* next = shape_->with(key);
+        if (next) {
+            shape_ = next;
+            values_.push_back(std::move(value));
+            return values_.back();
+        }
+        to_dictionary();
+    }
+    
+    dict_->keys.push_back(key);
+    values_.push_back(std::move(value));
+    if (values_.size() >= Shape::kIndexThreshold) {
+        // Keep the index at most a quarter full
+        if (dict_->index.size() < values_.size() * 4) {
+            rebuild_index();
+        } else {
+            index_insert(static_cast<uint32_t>(values_.size() - 1));
+        }
+    }
+    return values_.back();
+}
+
+void Object::to_dictionary() {
+    dict_ = std::make_unique<Dict>();
+    dict_->keys = shape_->keys();
+    shape_ = nullptr;
+    rebuild_index();
+}
+
+void Object::index_insert(uint32_t position) {
+    auto& index = dict_->index;
+    size_t mask = index.size() - 1;
+    size_t slot = dict_->keys[position].hash() & mask;
+    while (index[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    index[slot] = position + 1;
+}
+
+void Object::rebuild_index() {
+    auto& index = dict_->index;
+    index.clear();
+    if (dict_->keys.size() < Shape::kIndexThreshold) {
+        return;
+    }
+    
+    size_t capacity = 32;
+    while (capacity < dict_->keys.size() * 8) {
+        capacity <<= 1;
+    }
+    index.assign(capacity, 0);
+    for (size_t i = 0; i < dict_->keys.size(); ++i) {
+        index_insert(static_cast<uint32_t>(i));
+    }
+}
+
 // TOON serialization
 // Helper to escape TOON strings
-static std::string escape_toon_string(const std::string& s) {
+static std::string escape_toon_string(std::string_view s) {
     // Check if string needs quoting
     bool needs_quotes = false;
     
@@ -144,15 +1347,13 @@ static std::string escape_toon_string(const std::string& s) {
     } else if (s == "true" || s == "false" || s == "null") {
         needs_quotes = true;
     } else {
-        // Check if it looks like a number
-        try {
-            size_t pos = 0;
-            std::stod(s, &pos);
-            if (pos == s.length()) {
-                needs_quotes = true;
-            }
-        } catch (...) {
-            // Not a number
+        // Quote anything the parser would read back as a number; it trims
+        // surrounding whitespace first
+        size_t first = s.find_first_not_of(" \t\n\v\f\r");
+        size_t last = s.find_last_not_of(" \t\n\v\f\r");
+        Value number;
+        if (first != std::string_view::npos && Value::try_parse_number(s.substr(first, last - first + 1), number)) {
+            needs_quotes = true;
         }
         
         // Check for special characters
@@ -165,7 +1366,7 @@ static std::string escape_toon_string(const std::string& s) {
     }
     
     if (!needs_quotes) {
-        return s;
+        return std::string(s);
     }
     
     // Quote and escape
@@ -195,26 +1396,33 @@ std::string Value::to_toon(int indent_size, int current_depth) const {
             break;
             
         case Type::Boolean:
-            oss << (std::get<bool>(data_) ? "true" : "false");
+            oss << (payload_.boolean ? "true" : "false");
             break;
             
         case Type::Number: {
-            double val = std::get<double>(data_);
-            // Check for integer values
-            if (val == static_cast<long long>(val)) {
-                oss << static_cast<long long>(val);
+            if (subtype_ == kInteger) {
+                oss << payload_.integer;
+                break;
+            }
+            double val = payload_.number;
+            // Whole doubles inside the int64 range print without a fraction
+            if (std::abs(val) < 9.2e18 && val == std::trunc(val)) {
+                oss << static_cast<int64_t>(val);
             } else {
-                oss << val;
+                // Shortest representation that reads back to the same double
+                char buf[32];
+                auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), val);
+                oss << std::string_view(buf, end - buf);
             }
             break;
         }
             
         case Type::String:
-            oss << escape_toon_string(std::get<std::string>(data_));
+            oss << escape_toon_string(as_string_view());
             break;
             
         case Type::Array: {
-            const auto& arr = std::get<std::vector<Value>>(data_);
+            const auto& arr = as_array();
             
             if (arr.empty()) {
                 oss << "[0]:";
@@ -245,14 +1453,14 @@ std::string Value::to_toon(int indent_size, int current_depth) const {
                             const auto& obj = elem.as_object();
                             if (!obj.empty()) {
                                 auto it = obj.begin();
-                                oss << escape_toon_string(it->first) << ": " 
+                                oss << escape_toon_string(it->first.str()) << ": " 
                                     << it->second.to_toon(indent_size, 0);
                                 ++it;
                                 
                                 // Additional fields on new lines
                                 for (; it != obj.end(); ++it) {
                                     oss << "\n" << std::string((current_depth + 2) * indent_size, ' ')
-                                        << escape_toon_string(it->first) << ": "
+                                        << escape_toon_string(it->first.str()) << ": "
                                         << it->second.to_toon(indent_size, 0);
                                 }
                             }
@@ -273,7 +1481,7 @@ std::string Value::to_toon(int indent_size, int current_depth) const {
         }
             
         case Type::Object: {
-            const auto& obj = std::get<std::map<std::string, Value>>(data_);
+            const auto& obj = as_object();
             
             if (current_depth == 0 && !obj.empty()) {
                 // Root object - no braces
@@ -282,13 +1490,13 @@ std::string Value::to_toon(int indent_size, int current_depth) const {
                     if (!first) oss << "\n";
                     first = false;
                     
-                    oss << escape_toon_string(key) << ": ";
+                    oss << escape_toon_string(key.str()) << ": ";
                     
                     if (val.is_object() && !val.as_object().empty()) {
                         oss << "\n";
                         const auto& child_obj = val.as_object();
                         for (const auto& [child_key, child_val] : child_obj) {
-                            oss << child_indent_str << escape_toon_string(child_key) << ": "
+                            oss << child_indent_str << escape_toon_string(child_key.str()) << ": "
                                 << child_val.to_toon(indent_size, 0) << "\n";
                         }
                         // Remove trailing newline
@@ -2,8 +2,69 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <iomanip>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#ifndef TQ_TEST_DATA_DIR
+#define TQ_TEST_DATA_DIR "tests/data"
+#endif
+
+// Heap accounting: every allocation carries a small header with its size so
+// the benchmark can report live bytes and allocation counts.
+namespace {
+    std::atomic<size_t> g_live_bytes{0};
+    std::atomic<size_t> g_alloc_count{0};
+    constexpr size_t kHeader = alignof(std::max_align_t);
+}
+
+void* operator new(std::size_t size) {
+    void* raw = std::malloc(size + kHeader);
+    if (!raw) throw std::bad_alloc();
+    *static_cast<size_t*>(raw) = size;
+    g_live_bytes += size;
+    ++g_alloc_count;
+    return static_cast<char*>(raw) + kHeader;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    void* raw = static_cast<char*>(ptr) - kHeader;
+    g_live_bytes -= *static_cast<size_t*>(raw);
+    std::free(raw);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms
+void* operator new(std::size_t size, std::align_val_t align) {
+    size_t header = std::max(kHeader, static_cast<size_t>(align));
+    void* raw = std::aligned_alloc(header, (size + 2 * header - 1) / header * header);
+    if (!raw) throw std::bad_alloc();
+    *static_cast<size_t*>(raw) = size;
+    g_live_bytes += size;
+    ++g_alloc_count;
+    return static_cast<char*>(raw) + header;
+}
+
+void operator delete(void* ptr, std::align_val_t align) noexcept {
+    if (!ptr) return;
+    void* raw = static_cast<char*>(ptr) - std::max(kHeader, static_cast<size_t>(align));
+    g_live_bytes -= *static_cast<size_t*>(raw);
+    std::free(raw);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept {
+    operator delete(ptr, align);
+}
 
 struct BenchmarkResult {
     std::string name;
@@ -21,21 +82,45 @@ std::string read_file(const std::string& filename) {
     return content;
 }
 
-BenchmarkResult benchmark_query(const std::string& name, 
+// Build a tabular TOON document: users[N]{id,name,email,age,active,role}:
+std::string generate_tabular(size_t rows) {
+    std::string doc = "users[" + std::to_string(rows) + "]{id,name,email,age,active,role}:\n";
+    doc.reserve(rows * 64);
+    for (size_t i = 0; i < rows; ++i) {
+        doc += "  " + std::to_string(i) + ",User " + std::to_string(i) +
+               ",user" + std::to_string(i) + "@example.com," +
+               std::to_string(20 + i % 50) + "," + (i % 3 ? "true" : "false") + "," +
+               (i % 10 ? "user" : "admin") + "\n";
+    }
+    return doc;
+}
+
+// Build a list-form TOON document of uniform objects: items[N]: - a: .. b: .. c: ..
+std::string generate_list(size_t items) {
+    std::string doc = "items[" + std::to_string(items) + "]:\n";
+    doc.reserve(items * 48);
+    for (size_t i = 0; i < items; ++i) {
+        doc += "  - a: " + std::to_string(i) + "\n    b: item" + std::to_string(i) +
+               "\n    c: " + (i % 2 ? "true" : "false") + "\n";
+    }
+    return doc;
+}
+
+BenchmarkResult benchmark_query(const std::string& name,
                                 const std::string& expr,
                                 const std::string& data,
                                 int iterations = 1000) {
     auto start = std::chrono::high_resolution_clock::now();
-    
+
     size_t total_results = 0;
     for (int i = 0; i < iterations; ++i) {
         auto results = tq::query(expr, data);
         total_results = results.size();
     }
-    
+
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    
+
     return BenchmarkResult{
         name,
         duration.count() / 1000.0 / iterations,
@@ -43,37 +128,186 @@ BenchmarkResult benchmark_query(const std::string& name,
     };
 }
 
-int main() {
+// Evaluate a compiled query against an in-memory value or tape, bypassing
+// TOON parsing
+template <typename Data>
+BenchmarkResult benchmark_eval(const std::string& name,
+                               const std::string& expr,
+                               const Data& data,
+                               int iterations = 200000) {
+    tq::Lexer lexer(expr);
+    tq::Parser parser(lexer.tokenize());
+    auto query = parser.parse();
+    tq::Evaluator evaluator;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    size_t total_results = 0;
+    for (int i = 0; i < iterations; ++i) {
+        total_results = evaluator.eval(query.root, data).size();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+    return BenchmarkResult{
+        name,
+        duration.count() / 1e6 / iterations,
+        total_results
+    };
+}
+
+// A typical record: eight fields, looked up by name
+tq::Value make_record() {
+    return tq::ToonParser::parse(
+        "id: 42\nname: Alice\nemail: alice@example.com\nage: 30\n"
+        "active: true\nrole: admin\ncountry: NL\nscore: 99.5");
+}
+
+void benchmark_memory(size_t rows) {
+    std::string doc = generate_tabular(rows);
+
+    size_t bytes_before = g_live_bytes.load();
+    size_t allocs_before = g_alloc_count.load();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    tq::Value parsed = tq::ToonParser::parse(doc);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    size_t bytes = g_live_bytes.load() - bytes_before;
+    size_t allocs = g_alloc_count.load() - allocs_before;
+    size_t cells = rows * 6;
+
+    std::cout << "Tabular document: " << rows << " rows, " << doc.size() / (1024 * 1024) << " MB of TOON\n";
+    std::cout << "  sizeof(Value)      " << sizeof(tq::Value) << " bytes\n";
+    std::cout << "  Parse time         " << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+    std::cout << "  Heap after parse   " << bytes / (1024 * 1024) << " MB ("
+              << std::setprecision(1) << static_cast<double>(bytes) / cells << " bytes/cell)\n";
+    std::cout << "  Allocations        " << allocs << "\n\n";
+}
+
+// Parse and drop a document with per-node heap allocation, from an arena,
+// and as a flat tape
+void benchmark_arena(const std::string& label, const std::string& doc) {
+    std::cout << label << "         Parse (ms)  Teardown (ms)  Allocations\n";
+    std::cout << "----------------------------------------------------------------\n";
+    for (const char* mode : {"heap", "arena", "tape"}) {
+        bool use_arena = mode == std::string("arena");
+        size_t allocs_before = g_alloc_count.load();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto parsed_at = start;
+        {
+            std::unique_ptr<tq::Arena> arena(use_arena ? new tq::Arena(1 << 20) : nullptr);
+            if (mode == std::string("tape")) {
+                tq::Tape parsed = tq::ToonParser::parse_tape(doc);
+                parsed_at = std::chrono::high_resolution_clock::now();
+            } else {
+                tq::Value parsed = tq::ToonParser::parse(doc, arena.get());
+                parsed_at = std::chrono::high_resolution_clock::now();
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        size_t allocs = g_alloc_count.load() - allocs_before;
+        
+        std::cout << std::left << std::setw(22) << (std::string("  ") + mode)
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::milli>(parsed_at - start).count()
+                  << std::setw(15) << std::chrono::duration<double, std::milli>(end - parsed_at).count()
+                  << std::setw(13) << allocs << "\n";
+    }
+    std::cout << "\n";
+}
+
+int main(int argc, char* argv[]) {
     std::cout << "TQ Query Engine Benchmarks\n";
     std::cout << "===========================\n\n";
-    
+
     try {
         // Load test data
-        std::string data = read_file("tests/data/sample.json");
-        
+        std::string data_path = argc > 1 ? argv[1] : TQ_TEST_DATA_DIR "/sample.toon";
+        std::string data = read_file(data_path);
+
         std::vector<BenchmarkResult> results;
-        
+
         // Benchmark various queries
         results.push_back(benchmark_query("Simple field access", ".metadata", data));
         results.push_back(benchmark_query("Nested field", ".metadata.count", data));
         results.push_back(benchmark_query("Array iteration", ".users[]", data));
         results.push_back(benchmark_query("Array field fanout", ".users[].email", data));
         results.push_back(benchmark_query("Nested array access", ".users[].roles[]", data));
-        
+
         // Print results
         std::cout << "Query                          Time (ms)    Results\n";
         std::cout << "----------------------------------------------------\n";
-        
+
         for (const auto& result : results) {
             std::cout << std::left << std::setw(30) << result.name
-                      << std::right << std::setw(10) << std::fixed 
+                      << std::right << std::setw(10) << std::fixed
                       << std::setprecision(4) << result.time_ms
                       << std::setw(10) << result.result_count << "\n";
         }
+        std::cout << "\n";
+
+        tq::Value record = make_record();
+        std::vector<BenchmarkResult> eval_results;
+        eval_results.push_back(benchmark_eval("eval_field (first)", ".id", record));
+        eval_results.push_back(benchmark_eval("eval_field (last)", ".score", record));
+        eval_results.push_back(benchmark_eval("eval_field (missing)", ".zip", record));
+        eval_results.push_back(benchmark_eval("eval_object_literal",
+                                              "{id: .id, name: .name, email: .email, score: .score}", record));
+        eval_results.push_back(benchmark_eval("[range(1e6)] | length", "[range(1000000)] | length", record));
+        eval_results.push_back(benchmark_eval("[range(1e6)] | add", "[range(1000000)] | add", record, 20));
+        eval_results.push_back(benchmark_eval("limit(5; range(1e6))", "limit(5; range(1000000))", record));
+
+        std::cout << "In-memory evaluation           Time (us)    Results\n";
+        std::cout << "----------------------------------------------------\n";
+        for (const auto& result : eval_results) {
+            std::cout << std::left << std::setw(30) << result.name
+                      << std::right << std::setw(10) << std::fixed
+                      << std::setprecision(4) << result.time_ms * 1000.0
+                      << std::setw(10) << result.result_count << "\n";
+        }
+        std::cout << "\n";
+
+        // Queries over a parsed tabular document
+        tq::Value table = tq::ToonParser::parse(generate_tabular(100000));
+        std::vector<BenchmarkResult> table_results;
+        table_results.push_back(benchmark_eval("Column fanout", ".users[].email", table, 20));
+        table_results.push_back(benchmark_eval("map(.age)", ".users | map(.age)", table, 20));
+        table_results.push_back(benchmark_eval("select(.age > 30)", ".users[] | select(.age > 30)", table, 20));
+        table_results.push_back(benchmark_eval("length", ".users | length", table, 20));
+        table_results.push_back(benchmark_eval("reduce into array", "reduce .users[] as $u ([]; . + [$u.id])", table, 5));
+        table_results.push_back(benchmark_eval("select(.role == \"admin\")", ".users[] | select(.role == \"admin\")", table, 20));
+        table_results.push_back(benchmark_eval("group_by(.role)", ".users | group_by(.role)", table, 5));
+        table_results.push_back(benchmark_eval("group_by(.age)", ".users | group_by(.age)", table, 5));
+        table_results.push_back(benchmark_eval("map(.role) | unique", ".users | map(.role) | unique", table, 5));
         
-        std::cout << "\n Benchmarks completed successfully\n";
-        return 0;
+        tq::Value list = tq::ToonParser::parse(generate_list(100000));
+        table_results.push_back(benchmark_eval("List fields .a, .b, .c", ".items[] | .a, .b, .c", list, 20));
         
+        tq::Tape list_tape = tq::ToonParser::parse_tape(generate_list(100000));
+        table_results.push_back(benchmark_eval("Tape .items[] | .b", ".items[] | .b", list_tape, 20));
+        table_results.push_back(benchmark_eval("Tape .items[-1].a", ".items[-1].a", list_tape, 20));
+        table_results.push_back(benchmark_eval("Values .items[] | .b", ".items[] | .b", list, 20));
+        
+        std::cout << "Tabular queries (100k rows)    Time (ms)    Results\n";
+        std::cout << "----------------------------------------------------\n";
+        for (const auto& result : table_results) {
+            std::cout << std::left << std::setw(30) << result.name
+                      << std::right << std::setw(10) << std::fixed
+                      << std::setprecision(4) << result.time_ms
+                      << std::setw(10) << result.result_count << "\n";
+        }
+        std::cout << "\n";
+        
+        benchmark_memory(1000000);
+        benchmark_arena("List document (500k)", generate_list(500000));
+        benchmark_arena("Tabular doc (500k)  ", generate_tabular(500000));
+
+        std::cout << " Benchmarks completed successfully\n";
+        return 0;
+
     } catch (const std::exception& e) {
         std::cerr << "Benchmark failed: " << e.what() << "\n";
         return 1;
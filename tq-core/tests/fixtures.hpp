@@ -0,0 +1,77 @@
+#pragma once
+
+#include "tq/tq.hpp"
+#include <string>
+#include <vector>
+
+// Documents and queries shared by the suites that check another way of
+// reading TOON (tape, scanner backends, streaming reader, lazy document,
+// projection) against the tree ToonParser::parse builds
+namespace tq::fixtures {
+
+// A header table with a quoted, escaped cell and a negative number, a list
+// of objects, an inline array with an empty string, and nested objects
+// with an integer past 2^53 and an exponent
+inline const std::string kMixed =
+    "users[4]{id,name,age,role}:\n"
+    "  1,Alice,30,admin\n"
+    "  2,Bob,25,user\n"
+    "  3,\"Carol \\\"C\\\"\",41,user\n"
+    "  4,Dan,-7,guest\n"
+    "items[3]:\n"
+    "  - k: a\n"
+    "    n: 1.5\n"
+    "  - k: b\n"
+    "    n: null\n"
+    "  - k: c\n"
+    "    n: true\n"
+    "tags[3]: x, \"\", z\n"
+    "meta:\n"
+    "  owner: ops\n"
+    "  limits:\n"
+    "    max: 9007199254740993\n"
+    "    min: 1e-3";
+
+inline const std::vector<std::string> kDocs = {
+    "",
+    "42",
+    "hello world",
+    "\"quoted: yes\"",
+    "[3]: 1, 2, 3",
+    "[2]{a,b}:\n  1,2\n  3,4",
+    "[0]:",
+    "- [2]: p, q",
+    kMixed,
+    "rows[3]{a,b}:\n  1,2\n  3\n  5,6",                    // short row
+    "pairs[2]{k,k}:\n  1,2\n  3,4",                        // repeated header key
+    "list[4]:\n  - [2]:\n    - 1\n    - 2\n  -\n  - [2]{x|y}:\n    1|2\n    3|4\n  - x",
+    "\"a\\\"b\": 1\nc: \"x\\ty\"\nd:\ne:\n  f:\n    g: [not an array\n",
+    "crlf:\r\n  a: 1\r\n  b[2]: x, y\r\n",
+    "a: 1\nb: 2\na: 3",                                     // repeated key
+    "empty:\nnext:\n  deep:\n    deeper: 1\nlast: 2",
+};
+
+// Queries over kDocs: navigation, the builtins that take it apart, and
+// misses of every kind
+inline const std::vector<std::string> kQueries = {
+    ".", ".users", ".users[1].name", ".users[].id", ".users[] | select(.age > 30) | .name",
+    "[.users[] | {name: .name}]", ".users | map(.id)", ".users[0] | keys", ".users[1:3] | .[] | .role",
+    "first(.users[] | .name)", "limit(2; .users[] | .role)", ".users.name", "[.users[] | .age] | add",
+    ".items[] | .k", ".items[] | .n // \"none\"", ".items[] | select(.n != null) | .k",
+    ".meta.owner, .meta.limits.min", ".meta.limits", ".meta.limits[]", ".meta.limits.max", ".meta | keys",
+    ".meta | length", ".meta.owner?", "if .meta.owner == \"ops\" then .tags[0] else .users[0].id end",
+    "try .meta.limits.max catch .a", ".tags[1]", ".rows[] | .b", ".rows[1]", ".pairs[0]", ".pairs[0].k",
+    ".list[2][1].y", ".list[] | 1", ".crlf.b[0]", ".e.f.g", ".[]", ".[1]", ".[] | .a", "..", ".a",
+    ".next", ".next.deep", ".next.deep.deeper", ".last", ".missing", ".missing.deeper",
+};
+
+// Each result of expression on data, as TOON text
+inline std::vector<std::string> run(const std::string& expression, const Value& data) {
+    std::vector<std::string> out;
+    for (const auto& v : query_values(expression, data)) {
+        out.push_back(v.to_toon());
+    }
+    return out;
+}
+
+} // namespace tq::fixtures
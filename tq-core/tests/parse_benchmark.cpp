@@ -0,0 +1,118 @@
+#include "tq/tq.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef TQ_TEST_DATA_DIR
+#define TQ_TEST_DATA_DIR "tests/data"
+#endif
+
+// Parse throughput on the bundled sample scaled up to a target size:
+//
+//   parse_benchmark [megabytes] [file] [threads]
+//
+// The first array of the file is repeated until the document reaches the
+// requested size (default 64 MB; 1024 reproduces the 1 GB measurement on a
+// machine with memory for the parsed tree, about 3.5 GB at its peak). The tree parse is measured on
+// 1, 2, 4, ... threads up to the given count (default: one per core).
+namespace {
+    std::string read_file(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + filename);
+        }
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    // "key[n]:" header, indented items, rest of the document
+    std::string scale(const std::string& sample, size_t target_bytes) {
+        size_t header_end = sample.find('\n') + 1;
+        size_t items_end = header_end;
+        while (items_end < sample.size() && sample[items_end] == ' ') {
+            items_end = sample.find('\n', items_end);
+            items_end = items_end == std::string::npos ? sample.size() : items_end + 1;
+        }
+        std::string header = sample.substr(0, header_end);
+        std::string items = sample.substr(header_end, items_end - header_end);
+        size_t open = header.find('[');
+        size_t close = header.find(']');
+        if (items.empty() || open == std::string::npos || close == std::string::npos) {
+            throw std::runtime_error("Sample must start with an array header and its items");
+        }
+        size_t per_copy = std::stoul(header.substr(open + 1, close - open - 1));
+        size_t copies = target_bytes / items.size() + 1;
+
+        std::string doc = header.substr(0, open + 1) + std::to_string(per_copy * copies) + header.substr(close);
+        doc.reserve(doc.size() + copies * items.size() + sample.size());
+        for (size_t i = 0; i < copies; ++i) {
+            doc += items;
+        }
+        doc += sample.substr(items_end);
+        return doc;
+    }
+
+    template <typename Parse>
+    void measure(const char* name, const std::string& doc, Parse parse) {
+        std::string input = doc;  // the parsers take ownership of their input
+        auto start = std::chrono::steady_clock::now();
+        [[maybe_unused]] auto parsed = parse(std::move(input));  // freed after the clock stops
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::left << std::setw(24) << name
+                  << std::right << std::setw(10) << std::fixed << std::setprecision(1) << seconds * 1000.0
+                  << std::setw(12) << doc.size() / seconds / (1 << 20) << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 64;
+        std::string path = argc > 2 ? argv[2] : TQ_TEST_DATA_DIR "/sample.toon";
+        std::string doc = scale(read_file(path), megabytes << 20);
+
+        std::cout << "Parsing " << path << " scaled to " << doc.size() / (1 << 20) << " MB\n\n";
+        std::cout << "Parser                  Time (ms)      MB/s\n";
+        std::cout << "-------------------------------------------\n";
+        unsigned max_threads = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> thread_counts;
+        for (unsigned threads = 1; threads < max_threads; threads *= 2) {
+            thread_counts.push_back(threads);
+        }
+        thread_counts.push_back(max_threads);
+        for (unsigned threads : thread_counts) {
+            std::string name = "ToonParser::parse/" + std::to_string(threads);
+            measure(name.c_str(), doc, [=](std::string s) { return tq::ToonParser::parse(std::move(s), nullptr, threads); });
+        }
+        measure("ToonParser::parse_tape", doc, [](std::string s) { return tq::ToonParser::parse_tape(std::move(s)); });
+
+        // The structural pre-pass on its own, for each scan backend this CPU has
+        std::vector<tq::ScanBlock> blocks(64);
+        for (tq::ScanBackend backend : {tq::ScanBackend::Scalar, tq::ScanBackend::SSE42, tq::ScanBackend::AVX2, tq::ScanBackend::AVX512}) {
+            if (!tq::StructuralScanner::supported(backend)) {
+                continue;
+            }
+            tq::StructuralScanner::force(backend);
+            std::string name = std::string("scan (") + tq::StructuralScanner::name(backend) + ")";
+            measure(name.c_str(), doc, [&](std::string s) {
+                uint64_t lines = 0;
+                for (size_t first = 0; first * 64 < s.size(); first += blocks.size()) {
+                    tq::StructuralScanner::scan(s, first, blocks.size(), blocks.data());
+                    for (const tq::ScanBlock& block : blocks) {
+                        lines += std::popcount(block.newline);
+                    }
+                }
+                return lines;
+            });
+        }
+        tq::StructuralScanner::reset();
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,125 @@
+#include "tq/tq.hpp"
+#include <iostream>
+#include <cassert>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tq;
+
+namespace {
+    std::string make_doc(int rows) {
+        const char* roles[] = {"admin", "user", "guest"};
+        std::string doc = "users[" + std::to_string(rows) + "]{id,name,age,role}:\n";
+        for (int i = 0; i < rows; ++i) {
+            doc += "  " + std::to_string(i) + ",user" + std::to_string(i) + "," +
+                   std::to_string(20 + i % 50) + "," + roles[i % 3] + "\n";
+        }
+        doc += "items[3]:\n  - a: 1\n    b: x\n  - a: 2\n    b: y\n  - a: 3\n    b: x\n";
+        doc += "meta:\n  version: 2\n  owner: ops";
+        return doc;
+    }
+    
+    std::string render(const std::vector<Value>& results) {
+        std::string out;
+        for (const auto& value : results) {
+            out += value.to_toon() + "\n";
+        }
+        return out;
+    }
+}
+
+void test_document_basics() {
+    Document doc("name: Alice\nage: 30");
+    assert(doc.query(".name")[0].as_string() == "Alice");
+    
+    // Results keep their own references and outlive the document
+    std::vector<Value> kept;
+    {
+        Document scoped(make_doc(10));
+        kept = scoped.query(".users");
+    }
+    assert(kept[0].array_size() == 10);
+    
+    // Changes made through the caller's Value never reach the document
+    Value root = ToonParser::parse("n: 1");
+    Document wrapped(root);
+    root.as_object()["n"] = Value(2);
+    assert(wrapped.query(".n")[0].as_integer() == 1);
+    std::cout << " test_document_basics passed\n";
+}
+
+void test_concurrent_queries() {
+    // Every query first touches lazily built state: table rows, hashes,
+    // field caches of a shared compiled query
+    const std::vector<std::string> expressions = {
+        ".users[] | select(.age > 60) | .id",
+        ".users | sort_by(.age) | .[0].name",
+        ".users | group_by(.role) | map(length)",
+        ".users | map(.age) | unique | length",
+        ".users[] | select(.role == \"admin\") | .name",
+        ".items | map(.a) | add",
+        ".items | group_by(.b) | length",
+        ".meta.version",
+        ".meta | to_entries | from_entries | .owner",
+        ".users | reverse | .[0].id",
+        ".users | .[5:8] | map(.name)",
+    };
+    
+    Document doc(make_doc(2000));
+    std::vector<Query> compiled;
+    for (const auto& expression : expressions) {
+        compiled.push_back(Document::compile(expression));
+    }
+    
+    // Reference answers from a separate document
+    Document reference(make_doc(2000));
+    std::vector<std::string> expected;
+    for (const auto& expression : expressions) {
+        expected.push_back(render(reference.query(expression)));
+    }
+    
+    constexpr int kThreads = 8;
+    constexpr int kRounds = 20;
+    std::atomic<int> mismatches{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (int round = 0; round < kRounds; ++round) {
+                for (size_t i = 0; i < expressions.size(); ++i) {
+                    size_t q = (i + t) % expressions.size();
+                    auto results = (round + t) % 2 ? doc.query(compiled[q]) : doc.query(expressions[q]);
+                    if (render(results) != expected[q]) {
+                        mismatches.fetch_add(1);
+                    }
+                }
+            }
+        });
+    }
+    go.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    assert(mismatches.load() == 0);
+    assert(doc.query(".meta.owner")[0].as_string() == "ops");
+    std::cout << " test_concurrent_queries passed\n";
+}
+
+int main() {
+    try {
+        test_document_basics();
+        test_concurrent_queries();
+        
+        std::cout << "\nAll Document tests passed!\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << "\n";
+        return 1;
+    }
+}
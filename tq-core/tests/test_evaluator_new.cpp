@@ -1,10 +1,13 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <chrono>
 #include "tq/lexer.hpp"
 #include "tq/parser.hpp"
 #include "tq/evaluator.hpp"
 #include "tq/value.hpp"
+#include "tq/toon_parser.hpp"
+#include "tq/tq.hpp"
 
 using namespace tq;
 
@@ -84,6 +87,341 @@ void test_arithmetic() {
     std::cout << " Arithmetic operations work" << std::endl;
 }
 
+void test_integer_arithmetic() {
+    std::cout << "Testing 64-bit integer arithmetic..." << std::endl;
+    Value big(int64_t{9007199254740993});  // 2^53 + 1, not representable as a double
+    
+    auto inc = parse_and_eval(". + 1", big);
+    assert(inc.is_integer() && inc.as_integer() == 9007199254740994);
+    
+    auto eq = parse_and_eval(". == 9007199254740992", big);
+    assert(eq.is_boolean() && eq.as_boolean() == false);
+    
+    auto mod = parse_and_eval(". % 10", big);
+    assert(mod.is_integer() && mod.as_integer() == 3);
+    
+    // Division and overflow promote to double
+    auto div = parse_and_eval(". / 2", Value(int64_t{7}));
+    assert(!div.is_integer() && div.as_number() == 3.5);
+    auto overflow = parse_and_eval(". * 2", Value(INT64_MAX));
+    assert(!overflow.is_integer() && overflow.as_number() == 2.0 * static_cast<double>(INT64_MAX));
+    
+    // Mixed comparisons are exact
+    auto gt = parse_and_eval(". > 9007199254740992.0", big);
+    assert(gt.is_boolean() && gt.as_boolean() == true);
+    
+    std::vector<Value> arr = {Value(INT64_MAX - 1), Value(int64_t{1})};
+    auto sum = parse_and_eval("add", Value(arr));
+    assert(sum.is_integer() && sum.as_integer() == INT64_MAX);
+    
+    std::cout << " Integer arithmetic works" << std::endl;
+}
+
+void test_tabular_queries() {
+    std::cout << "Testing queries on columnar tables..." << std::endl;
+    Value data = ToonParser::parse("users[3]{id,name,age}:\n  1,Ann,31\n  2,Bob,25\n  3,Cy,40");
+    assert(data.get("users")->is_table());
+    
+    Lexer lexer(".users[].name");
+    Parser parser(lexer.tokenize());
+    auto q = parser.parse();
+    Evaluator evaluator;
+    auto names = evaluator.eval(q.root, data);
+    assert(names.size() == 3 && names[2].as_string() == "Cy");
+    
+    auto ages = parse_and_eval(".users | map(.age)", data);
+    assert(ages.is_array() && ages.as_array().size() == 3 && ages.as_array()[1].as_integer() == 25);
+    
+    auto older = parse_and_eval(".users | map(select(.age > 30) | .id)", data);
+    assert(older.as_array().size() == 2 && older.as_array()[1].as_integer() == 3);
+    
+    auto count = parse_and_eval(".users | length", data);
+    assert(count.as_integer() == 3);
+    
+    auto second = parse_and_eval(".users[1].name", data);
+    assert(second.as_string() == "Bob");
+    std::cout << " Tabular queries work" << std::endl;
+}
+
+void test_dictionary_columns() {
+    std::cout << "Testing dictionary-encoded columns..." << std::endl;
+    const char* roles[] = {"user", "admin", "guest", "user"};
+    std::string doc = "users[40]{id,role}:\n";
+    for (int i = 0; i < 40; ++i) {
+        doc += "  " + std::to_string(i) + "," + roles[i % 4] + "\n";
+    }
+    Value data = ToonParser::parse(doc);
+    assert(data.get("users")->column(Key("role"))->encoded());
+    assert(!data.get("users")->column(Key("id"))->encoded());
+    
+    // Fast paths must agree with the same rows stored as plain objects
+    Object plain_fields;
+    plain_fields["users"] = Value(data.get("users")->as_array());
+    Value plain(std::move(plain_fields));
+    const char* queries[] = {
+        ".users[] | select(.role == \"admin\") | .id",
+        ".users[] | select(\"guest\" == .role) | .id",
+        ".users[] | select(.role != \"user\") | .id",
+        ".users[] | select(.role == \"nobody\")",
+        ".users | group_by(.role)",
+        ".users | map(.role) | unique",
+    };
+    for (const char* query : queries) {
+        Lexer lexer(query);
+        Parser parser(lexer.tokenize());
+        auto q = parser.parse();
+        Evaluator evaluator;
+        auto fast = evaluator.eval(q.root, data);
+        auto slow = evaluator.eval(q.root, plain);
+        assert(fast.size() == slow.size());
+        for (size_t i = 0; i < fast.size(); ++i) {
+            assert(fast[i].to_toon() == slow[i].to_toon());
+        }
+    }
+    
+    auto admins = parse_and_eval(".users | map(select(.role == \"admin\")) | length", data);
+    assert(admins.as_integer() == 10);
+    std::cout << " Dictionary-encoded columns work" << std::endl;
+}
+
+void test_container_comparison() {
+    std::cout << "Testing container comparison..." << std::endl;
+    auto arr = [](std::vector<Value> items) { return Value(std::move(items)); };
+    Object data_fields;
+    data_fields["p"] = arr({Value(1), Value(2)});
+    data_fields["q"] = arr({Value(1), Value(2)});
+    data_fields["r"] = arr({Value(2), Value(1)});
+    data_fields["o1"] = Value(Object{{"a", Value(1)}, {"b", Value(2)}});
+    data_fields["o2"] = Value(Object{{"b", Value(2)}, {"a", Value(1)}});
+    data_fields["nested"] = arr({arr({Value(2)}), arr({Value(1), Value(5)}), arr({Value(1)})});
+    data_fields["objs"] = arr({Value(Object{{"a", Value(1)}}), Value(Object{{"a", Value(2)}}),
+                               Value(Object{{"a", Value(1)}})});
+    data_fields["ks"] = arr({Value(Object{{"k", Value(10)}}), Value(Object{{"k", Value(9)}}),
+                             Value(Object{{"k", Value(10)}})});
+    Value data(std::move(data_fields));
+    
+    assert(parse_and_eval(".p == .q", data).as_boolean());
+    assert(!parse_and_eval(".p == .r", data).as_boolean());
+    assert(parse_and_eval(".o1 == .o2", data).as_boolean());
+    assert(parse_and_eval(".p < .r", data).as_boolean());
+    
+    auto sorted = parse_and_eval(".nested | sort", data);
+    assert(sorted.as_array()[0].as_array().size() == 1);
+    assert(sorted.as_array()[1].as_array().size() == 2);
+    assert(sorted.as_array()[2].as_array()[0].as_integer() == 2);
+    assert(parse_and_eval(".objs | unique | length", data).as_integer() == 2);
+    
+    // Groups are ordered by key value, not by key text
+    auto groups = parse_and_eval(".ks | group_by(.k) | map(length)", data);
+    assert(groups.as_array().size() == 2);
+    assert(groups.as_array()[0].as_integer() == 1);
+    assert(groups.as_array()[1].as_integer() == 2);
+    std::cout << " Container comparison works" << std::endl;
+}
+
+void test_reduce_foreach() {
+    std::cout << "Testing reduce and foreach..." << std::endl;
+    Value data = ToonParser::parse("xs[4]: 1, 2, 3, 4\nbase:\n  a: 0");
+    
+    assert(parse_and_eval("reduce .xs[] as $x (0; . + $x)", data).as_integer() == 10);
+    auto built = parse_and_eval("reduce .xs[] as $x ([]; . + [$x * 2])", data);
+    assert(built.array_size() == 4 && built.as_array()[3].as_integer() == 8);
+    auto merged = parse_and_eval("reduce .xs[] as $x ({}; . + {last: $x})", data);
+    assert(merged.get("last")->as_integer() == 4);
+    
+    // Updating an accumulator that starts as part of the input leaves the input alone
+    auto updated = parse_and_eval("reduce .xs[] as $x (.base; . + {a: $x})", data);
+    assert(updated.get("a")->as_integer() == 4);
+    assert(data.get("base")->get("a")->as_integer() == 0);
+    
+    // foreach emits every intermediate state, each one unchanged by later steps
+    Lexer lexer("foreach .xs[] as $x ([]; . + [$x])");
+    Parser parser(lexer.tokenize());
+    auto q = parser.parse();
+    Evaluator evaluator;
+    auto states = evaluator.eval(q.root, data);
+    assert(states.size() == 4);
+    for (size_t i = 0; i < states.size(); ++i) {
+        assert(states[i].array_size() == i + 1);
+        assert(states[i].element(i).as_integer() == static_cast<int64_t>(i + 1));
+    }
+    states[1].as_array()[0] = Value(9);
+    assert(states[2].element(0).as_integer() == 1);
+    assert(parse_and_eval("foreach .xs[] as $x (0; . + $x; . * 10)", data).as_integer() == 10);
+    assert(parse_and_eval("last(foreach range(0; 50000) as $x ([]; . + [$x]))", data).array_size() == 50000);
+    assert(parse_and_eval("reduce .xs[] as $x (.base; .a += $x) | .a", data).as_integer() == 10);
+    
+    // setpath, delpaths and del update the accumulator in place too
+    assert(parse_and_eval("reduce .xs[] as $x (.base; setpath([\"b\", $x | tostring]; $x)) | .b[\"4\"]", data)
+               .as_integer() == 4);
+    assert(parse_and_eval("reduce .xs[] as $x (.xs; delpaths([[0]])) | length", data).as_integer() == 0);
+    assert(parse_and_eval("reduce .xs[] as $x (.xs; del(.[-1])) | length", data).as_integer() == 0);
+    assert(parse_and_eval("reduce .xs[] as $x ({}; setpath([\"a\"], [\"b\"]; $x)) | keys", data) ==
+           Value(std::vector<Value>{Value("b")}));
+    assert(data.get("base")->field_count() == 1 && data.get("xs")->array_size() == 4);
+    
+    // Building an object key by key takes time linear in its size
+    auto build = [&](int n) {
+        std::string query = "reduce range(0; " + std::to_string(n) + ") as $i ({}; setpath([$i | tostring]; $i))";
+        auto start = std::chrono::steady_clock::now();
+        assert(parse_and_eval(query + " | length", data).as_integer() == n);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    double small = build(25000);
+    double large = build(100000);
+    assert(large < 10 * small);  // 16x if each step copied the object
+    assert(parse_and_eval("reduce range(0; 100000) as $i ([]; setpath([$i]; $i)) | .[99999]", data)
+               .as_integer() == 99999);
+    std::cout << " reduce and foreach work" << std::endl;
+}
+
+void test_assignment() {
+    std::cout << "Testing assignment..." << std::endl;
+    Value data = ToonParser::parse("a: 1\nb:\n  c: 2\nxs[3]: 1, 2, 3\nusers[2]{id,name}:\n  1,Ada\n  2,Bob");
+    
+    assert(parse_and_eval(".a = 5 | .a", data).as_integer() == 5);
+    assert(parse_and_eval(".b.c |= . + 1 | .b.c", data).as_integer() == 3);
+    assert(parse_and_eval(".xs[] |= . * 10 | .xs[2]", data).as_integer() == 30);
+    assert(parse_and_eval(".users[].id += 100 | .users[1].id", data).as_integer() == 102);
+    assert(parse_and_eval(".new.deep[1] = true | .new.deep", data).array_size() == 2);
+    assert(parse_and_eval(".missing //= \"d\" | .missing", data).as_string() == "d");
+    assert(parse_and_eval(".xs[-1] = 0 | .xs[2]", data).as_integer() == 0);
+    assert(parse_and_eval("(.a, .b.c) = 7 | .b.c", data).as_integer() == 7);
+    // No output from the update deletes the path
+    assert(parse_and_eval(".xs[1] |= empty | .xs", data).array_size() == 2);
+    assert(parse_and_eval(".users[] |= select(.id == 2) | .users[0].name", data).as_string() == "Bob");
+    // The input itself is never changed
+    assert(data.get("a")->as_integer() == 1);
+    assert(data.get("xs")->as_array()[2].as_integer() == 3);
+    
+    assert(parse_and_eval("path(.b.c)", data).as_array()[1].as_string() == "c");
+    assert(parse_and_eval("getpath([\"users\", 1, \"name\"])", data).as_string() == "Bob");
+    assert(parse_and_eval("setpath([\"b\", \"c\"]; 9) | .b.c", data).as_integer() == 9);
+    assert(!parse_and_eval("delpaths([[\"a\"], [\"b\", \"c\"]])", data).get("a"));
+    assert(parse_and_eval("del(.xs[0], .xs[2]) | .xs", data).as_array()[0].as_integer() == 2);
+    
+    // Computed indices read, assign and delete like literal ones
+    Value keyed = ToonParser::parse("a[3]: 10, 20, 30\ni: 1\nk: a\n\"b c\": 5");
+    assert(parse_and_eval(".a[.i]", keyed).as_integer() == 20);
+    assert(parse_and_eval(".[.k][-1]", keyed).as_integer() == 30);
+    assert(parse_and_eval(".[\"b c\"]", keyed).as_integer() == 5);
+    assert(query_values(".a[1, 0]", keyed) == (std::vector<Value>{Value(20), Value(10)}));
+    assert(query_values(".[\"missing\" | ascii_upcase]", keyed).empty());
+    assert(parse_and_eval(".a[.i] = 99 | .a[1]", keyed).as_integer() == 99);
+    assert(parse_and_eval(".[.k] |= length | .a", keyed).as_integer() == 3);
+    assert(!parse_and_eval("del(.[.k])", keyed).get("a"));
+    assert(parse_and_eval("path(.a[.i])", keyed) == Value(std::vector<Value>{Value("a"), Value(1)}));
+    assert(parse_and_eval("reduce (\"x\", \"y\") as $k ({}; .[$k] = 1) | length", keyed).as_integer() == 2);
+    bool threw = false;
+    try {
+        parse_and_eval(".[[1]]", keyed);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    threw = false;
+    try {
+        parse_and_eval(".a.b = 1", data);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(parse_and_eval(".a.b? = 1 | .a", data).as_integer() == 1);
+    std::cout << " Assignment works" << std::endl;
+}
+
+void test_lazy_ranges() {
+    std::cout << "Testing ranges and generator consumers..." << std::endl;
+    Value data(std::vector<Value>{Value(7), Value(8), Value(9)});
+    
+    // [range(...)] is virtual: length and indexing never build its elements
+    assert(parse_and_eval("[range(0; 1000000000000)] | length", data).as_integer() == 1000000000000);
+    assert(parse_and_eval("[range(10; 0; -3)] | .[2]", data).as_integer() == 4);
+    assert(parse_and_eval("[range(1000000000) | \"x\"] | .[999999999]", data).as_string() == "x");
+    assert(parse_and_eval("[range(5)] | add", data).as_integer() == 10);
+    assert(parse_and_eval("[range(3)]", data) == Value(std::vector<Value>{Value(0), Value(1), Value(2)}));
+    assert(parse_and_eval("[range(0; 1; 0.25)] | length", data).as_integer() == 4);
+    assert(parse_and_eval("[range(5; 0)] | length", data).as_integer() == 0);
+
+    // Positions past 2^32 index, slice and count exactly
+    Value big = parse_and_eval("[range(0; 5000000000)]", data);
+    assert(parse_and_eval(".[-1]", big).as_integer() == 4999999999);
+    assert(parse_and_eval(".[4294967296]", big).as_integer() == 4294967296);
+    assert(parse_and_eval("[range(0; 4294967298)] | .[-1]", data).as_integer() == 4294967297);
+    assert(query_refs(".[-1]", big)[0]->as_integer() == 4999999999);
+    assert(parse_and_eval(".[-2:]", big) == Value(std::vector<Value>{Value(int64_t{4999999998}), Value(int64_t{4999999999})}));
+    assert(parse_and_eval(".[4294967296:4294967297] | .[0]", big).as_integer() == 4294967296);
+    assert(parse_and_eval(".[1e30]", big).is_null());
+    assert(parse_and_eval(".[-1e30:2] | length", big).as_integer() == 2);
+    assert(parse_and_eval("nth(4999999999)", big).as_integer() == 4999999999);
+    assert(parse_and_eval("nth(-5000000000)", big).as_integer() == 0);
+    assert(query_values("nth(5000000000)", big).empty());
+    assert(query_values("nth(1e300)", big).empty());
+    assert(parse_and_eval("has(4999999999)", big).as_boolean());
+    assert(parse_and_eval("[range(-9223372036854775808; 9223372036854775807)] | length", data).as_number() > 1.8e19);
+
+    // Array literals collect every output of their elements
+    assert(parse_and_eval("[.[], 1]", data).array_size() == 4);
+    assert(parse_and_eval("[.[] | . * 2] | last", data).as_integer() == 18);
+    
+    // first, last and limit take only the outputs they need
+    assert(parse_and_eval("first(range(5; 1000000000000))", data).as_integer() == 5);
+    assert(parse_and_eval("last(range(1000000000000))", data).as_integer() == 999999999999);
+    assert(parse_and_eval("first(.[])", data).as_integer() == 7);
+    assert(parse_and_eval("[limit(3; range(1000000000000))]", data) ==
+           Value(std::vector<Value>{Value(0), Value(1), Value(2)}));
+    assert(parse_and_eval("[limit(2; .[])] | last", data).as_integer() == 8);
+    assert(parse_and_eval("reduce range(1000000) as $i (0; . + $i)", data).as_integer() == 499999500000);
+    
+    Lexer lexer("range(2; 5)");
+    Parser parser(lexer.tokenize());
+    auto q = parser.parse();
+    Evaluator evaluator;
+    assert(evaluator.eval(q.root, data).size() == 3);
+    std::cout << " ranges and generator consumers work" << std::endl;
+}
+
+void test_borrowed_results() {
+    std::cout << "Testing borrowed navigation results..." << std::endl;
+    Value data = ToonParser::parse(
+        "users[3]{id,name}:\n  1,a\n  2,b\n  3,c\n"
+        "items[2]:\n  - k: x\n    n: 1\n  - k: y\n    n: 2\n"
+        "tags[3]: p, q, r\n"
+        "meta:\n  owner: ops");
+    
+    // Same answers as eval(), whatever mix of borrowed and owned refs
+    const char* queries[] = {
+        ".", ".meta.owner", ".items[1].k", ".items[] | .n", ".tags[]", ".users[]", ".users[] | .name",
+        ".users[1]", ".users[-1] | .", "..", ".items[0], .meta", ".users | length",
+        ".items[] | {k: .k}", ".users[] | .missing", ".users[5]",
+    };
+    for (const char* query : queries) {
+        Lexer lexer(query);
+        Parser parser(lexer.tokenize());
+        auto q = parser.parse();
+        Evaluator evaluator;
+        auto copies = evaluator.eval(q.root, data);
+        auto refs = evaluator.eval_refs(q.root, data);
+        assert(copies.size() == refs.size());
+        for (size_t i = 0; i < copies.size(); ++i) {
+            assert(copies[i] == *refs[i]);
+        }
+    }
+    
+    // Pure navigation points into the document itself
+    Lexer lexer(".meta.owner");
+    Parser parser(lexer.tokenize());
+    auto q = parser.parse();
+    Evaluator evaluator;
+    auto refs = evaluator.eval_refs(q.root, data);
+    assert(refs[0].borrowed() && &*refs[0] == data.get("meta")->get("owner"));
+    auto names = query_refs(".users[] | .name", data);
+    assert(names.size() == 3 && names[2].borrowed() && names[2]->as_string() == "c");
+    assert(!query_refs(".users | length", data)[0].borrowed());
+    std::cout << " Borrowed navigation results work" << std::endl;
+}
+
 void test_comparison() {
     std::cout << "Testing comparison operators..." << std::endl;
     
@@ -595,9 +933,13 @@ void test_io_sql_functions() {
     assert(result.is_object());
     std::cout << " INDEX function works" << std::endl;
     
-    // Test IN - create membership lookup set
+    // Test IN - membership among the outputs of its argument
     result = parse_and_eval(". | IN(.)", arr);
-    assert(result.is_object());
+    assert(result.is_boolean() && result.as_boolean());
+    assert(parse_and_eval(".[1] | IN(1, 2)", arr).as_boolean());
+    assert(!parse_and_eval(".[1] | IN(5, 6)", arr).as_boolean());
+    assert(parse_and_eval("IN(.[]; 7, 3.0)", arr).as_boolean());
+    assert(!parse_and_eval("IN(.[]; \"1\", [1])", arr).as_boolean());
     std::cout << " IN function works" << std::endl;
     
     // Test limit - limit with array using proper syntax [1,2,3] | limit(2)
@@ -614,7 +956,15 @@ int main() {
         test_array_index();
         test_pipe_operator();
         test_arithmetic();
+        test_integer_arithmetic();
+        test_tabular_queries();
+        test_dictionary_columns();
         test_comparison();
+        test_container_comparison();
+        test_reduce_foreach();
+        test_assignment();
+        test_lazy_ranges();
+        test_borrowed_results();
         test_type_builtin();
         test_length_builtin();
         test_math_functions();
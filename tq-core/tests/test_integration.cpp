@@ -1,6 +1,9 @@
 #include "tq/tq.hpp"
 #include <iostream>
 #include <cassert>
+#include <sstream>
+#include <streambuf>
+#include <string>
 
 using namespace tq;
 
@@ -41,15 +44,239 @@ void test_empty_result() {
     
     assert(results.size() == 0);
     
+    // `//` falls back when its left side yields nothing
+    assert(query(".nonexistent // \"none\"", toon) == std::vector<std::string>{"none"});
+    
     std::cout << " test_empty_result passed\n";
 }
 
+void test_line_endings() {
+    // CRLF, blank lines and a missing final newline read like plain LF input
+    std::string lf = "a: 1\nb:\n  c: x y\nitems[2]:\n  - k: 1\n    v: p\n  - k: 2\n    v: q\n";
+    std::string crlf = "a: 1\r\nb:\r\n  c: x y\r\nitems[2]:\r\n  - k: 1\r\n    v: p\r\n  - k: 2\r\n    v: q";
+    assert(ToonParser::parse(crlf) == ToonParser::parse(lf));
+    assert(query(".b.c", crlf)[0] == "x y");
+    assert(query(".items[1].v", crlf)[0] == "q");
+    assert(query(".a", "a: 1\n\n").size() == 1);
+    
+    // Quoted keys keep their own identity next to look-alike unquoted ones
+    std::string keys = "rows[3]:\n  - ab: 1\n    \"a\\\"b\": 2\n    \"ab\": 3\n  - ab: 4\n  - \"a:b\": 5";
+    assert(query(".rows[0].ab", keys)[0] == "3");
+    assert(query(".rows[0] | keys | length", keys)[0] == "2");
+    assert(query(".rows[1].ab", keys)[0] == "4");
+    assert(query(".rows[2] | keys | .[0]", keys)[0] == "\"a:b\"");
+    
+    bool threw = false;
+    try {
+        ToonParser::parse("xs[two]: 1, 2");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << " test_line_endings passed\n";
+}
+
+void test_parallel_parse() {
+    // Large arrays decoded on several threads match the one-thread parse,
+    // short rows, repeated fields and a list cut short included
+    std::string table = "rows[40000]{id,name,score}:\n";
+    std::string repeated = "pairs[20000]{k,k}:\n";
+    std::string list = "items[30000]:\n";
+    for (int i = 0; i < 40000; ++i) {
+        table += i == 25000 ? "  25000,short\n" : "  " + std::to_string(i) + ",\"n, " + std::to_string(i) + "\"," + std::to_string(i * 0.5) + "\n";
+    }
+    for (int i = 0; i < 20000; ++i) {
+        repeated += "  a" + std::to_string(i) + ",b\n";
+    }
+    for (int i = 0; i < 30000; ++i) {
+        switch (i % 3) {
+            case 0: list += "  - id: " + std::to_string(i) + "\n    tags[2]: x, y\n"; break;
+            case 1: list += "  - [2]{a,b}:\n    1,2\n    3,4\n"; break;
+            default: list += "  - v" + std::to_string(i) + "\n"; break;
+        }
+    }
+    std::string broken = list;
+    broken.insert(broken.find("  - id: 21000\n"), "    stray line\n");
+    
+    for (const std::string& doc : {table + repeated + list, list + "after: 1\n", broken}) {
+        Value sequential = ToonParser::parse(doc, nullptr, 1);
+        for (unsigned threads : {2u, 4u, 7u}) {
+            Value parallel = ToonParser::parse(doc, nullptr, threads);
+            assert(parallel == sequential);
+            assert(parallel.to_toon() == sequential.to_toon());
+            
+            Arena arena;
+            assert(ToonParser::parse(doc, &arena, threads) == sequential);
+        }
+    }
+    Value parsed = ToonParser::parse(table + repeated + list, nullptr, 4);
+    assert(parsed.get("rows")->as_array().size() == 40000);
+    assert(!parsed.get("rows")->is_table());
+    assert(parsed.get("rows")->as_array()[39999].get("name")->as_string() == "n, 39999");
+    assert(parsed.get("items")->as_array()[29999].as_string() == "v29999");
+    assert(ToonParser::parse(broken, nullptr, 4).get("items")->as_array().size() == 21000);
+    assert(ToonParser::parse(table, nullptr, 4).get("rows")->as_array().size() == 40000);
+    std::cout << " test_parallel_parse passed\n";
+}
+
+void test_list_items() {
+    // Objects with the same keys are kept as the rows of a table
+    Value uniform = ToonParser::parse("items[3]:\n  - a: 1\n    b: x\n  - a: 2\n    b: y\n  - a: 3\n    b: z\n");
+    assert(uniform.get("items")->is_table());
+    assert(uniform == ToonParser::parse("items[3]{a,b}:\n  1,x\n  2,y\n  3,z\n"));
+
+    // Until one item differs; the rows before it stay as they were
+    Value mixed = ToonParser::parse("items[4]:\n  - a: 1\n    b: x\n  - a: 2\n    b: y\n  - a: 3\n    c: z\n  - a: 4\n    b: w\n");
+    assert(!mixed.get("items")->is_table());
+    assert(mixed.get("items")->as_array()[1].get("b")->as_string() == "y");
+    assert(mixed.get("items")->as_array()[2].get("c")->as_string() == "z");
+    assert(!mixed.get("items")->as_array()[2].get("b"));
+    assert(mixed.get("items")->as_array()[3].get("b")->as_string() == "w");
+
+    // Items alternating between key sets share their shapes, keys in order
+    std::string alternating = "items[6000]:\n";
+    for (int i = 0; i < 6000; ++i) {
+        alternating += i % 2 ? "  - id: " + std::to_string(i) + "\n    b: 1\n" : "  - id: " + std::to_string(i) + "\n    c: 2\n    a: 3\n";
+    }
+    Value parsed = ToonParser::parse(alternating);
+    const auto& items = parsed.get("items")->as_array();
+    assert(items[4].as_object().shape() == items[0].as_object().shape());
+    assert(items[5].as_object().shape() == items[1].as_object().shape());
+    assert(query_values(".items[4] | keys_unsorted", parsed) == query_values("[\"id\", \"c\", \"a\"]", Value()));
+    assert(items[5999].get("b")->as_integer() == 1);
+
+    // Rows read in ranges on several threads join into one table
+    std::string rows = "items[30000]:\n";
+    for (int i = 0; i < 30000; ++i) {
+        rows += "  - id: " + std::to_string(i) + "\n    tag: t\n";
+    }
+    Value sequential = ToonParser::parse(rows, nullptr, 1);
+    assert(sequential.get("items")->is_table());
+    assert(ToonParser::parse(rows, nullptr, 4) == sequential);
+    assert(ToonParser::parse(rows, nullptr, 4).get("items")->is_table());
+    std::cout << " test_list_items passed\n";
+}
+
+namespace {
+    // "events[n]{id,kind}:" followed by rows made up as they are read
+    class EventSource : public std::streambuf {
+    public:
+        explicit EventSource(int rows) : rows_(rows) {
+            line_ = "events[" + std::to_string(rows) + "]{id,kind}:\n";
+            setg(line_.data(), line_.data(), line_.data() + line_.size());
+        }
+        int produced = 0;
+
+    protected:
+        int_type underflow() override {
+            if (produced == rows_) {
+                return traits_type::eof();
+            }
+            line_ = "  " + std::to_string(produced) + "," + (produced % 2 ? "click" : "view") + "\n";
+            ++produced;
+            setg(line_.data(), line_.data(), line_.data() + line_.size());
+            return traits_type::to_int_type(line_[0]);
+        }
+
+    private:
+        int rows_;
+        std::string line_;
+    };
+}
+
+void test_query_stream() {
+    // Streamed results match the whole-document query
+    std::string doc =
+        "meta:\n  source: test\n  tags[2]: a,b\n"
+        "events[3]{id,kind}:\n  1,view\n  2,click\n  3,view\n"
+        "nested:\n  list[3]:\n    - x: 1\n      y: 2\n    - 5\n    - [2]: p,q\n  scalar: 7\n"
+        "after: 1\n";
+    for (const char* expr : {".events[]", ".events[] | select(.kind == \"view\") | {id}", ".events[].id",
+                             ".nested.list[]", ".nested.list[] | type", ".meta.tags[]", ".meta[]", ".nested.scalar[]?",
+                             ".missing[]", ".nested.missing[]", ".meta.source.x[]", ". | .events[] | .id * 2"}) {
+        std::vector<std::string> expected;
+        bool expected_error = false;
+        try {
+            expected = query(expr, doc);
+        } catch (const std::exception&) {
+            expected_error = true;
+        }
+        std::istringstream in(doc);
+        std::vector<std::string> streamed;
+        bool streamable = true;
+        bool error = false;
+        try {
+            streamable = query_stream(expr, in, [&](const Value& v) { streamed.push_back(v.to_toon()); });
+        } catch (const std::exception&) {
+            error = true;
+        }
+        if (!streamable) {
+            assert(std::string(expr) == ".nested.scalar[]?");
+            assert(in.tellg() == 0);
+            continue;
+        }
+        assert(error == expected_error);
+        assert(streamed == expected);
+    }
+    
+    // Other shapes are left to query()
+    for (const char* expr : {".", ".events", "[.events[]]", ".events | length", ".events[0]"}) {
+        std::istringstream in(doc);
+        assert(!query_stream(expr, in, [](const Value&) { assert(false); }));
+    }
+    
+    // The first result is out long before the input ends
+    EventSource source(100000);
+    std::istream in(&source);
+    int first_at = -1;
+    int count = 0;
+    assert(query_stream(".events[] | select(.kind == \"click\") | .id", in, [&](const Value& v) {
+        if (first_at < 0) {
+            first_at = source.produced;
+        }
+        assert(v.as_number() == 2 * count + 1);
+        ++count;
+    }));
+    assert(count == 50000);
+    assert(first_at >= 0 && first_at < 20000);  // within the first chunk read
+
+    // A key of .path repeated later takes its last value, as in query(),
+    // as long as nothing from the first has gone out
+    std::string repeated = "users[3]: Ada,Bob,Cy\nusers[1]: Zed\nouter:\n  list[1]: x\nouter:\n  list[1]: y\n"
+                           "scalar: 1\nscalar[1]: s\n";
+    for (const char* expr : {".users[] | select(. == \"Zed\")", ".outer.list[] | select(. == \"y\")", ".scalar[]",
+                             ".outer.missing[]"}) {
+        std::istringstream in(repeated);
+        std::vector<std::string> streamed;
+        assert(query_stream(expr, in, [&](const Value& v) { streamed.push_back(v.to_toon()); }));
+        assert(streamed == query(expr, repeated));
+        assert(!streamed.empty() || std::string(expr) == ".outer.missing[]");
+    }
+    for (const char* expr : {".users[]", ".outer.list[]"}) {
+        std::istringstream in(repeated);
+        std::vector<std::string> streamed;
+        bool threw = false;
+        try {
+            query_stream(expr, in, [&](const Value& v) { streamed.push_back(v.to_toon()); });
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw && !streamed.empty());
+    }
+
+    std::cout << " test_query_stream passed\n";
+}
+
 int main() {
     try {
         test_simple_query();
         test_array_query();
         test_nested_query();
         test_empty_result();
+        test_line_endings();
+        test_parallel_parse();
+        test_list_items();
+        test_query_stream();
         
         std::cout << "\nAll Integration tests passed!\n";
         return 0;
@@ -0,0 +1,129 @@
+#include "tq/tq.hpp"
+#include "fixtures.hpp"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tq;
+
+using fixtures::kDocs;
+using fixtures::kQueries;
+using fixtures::run;
+
+void test_lazy_matches_parser() {
+    for (const auto& doc : kDocs) {
+        Value expected = ToonParser::parse(doc);
+        assert(LazyDocument(doc).to_value() == expected);
+        assert(LazyDocument(doc).to_value().to_toon() == expected.to_toon());
+
+        // The same document answers every query as the tree does, lookups
+        // decoding it piece by piece
+        LazyDocument lazy(doc, nullptr, 1);
+        for (const auto& expression : kQueries) {
+            std::vector<std::string> want;
+            bool want_error = false;
+            try {
+                want = run(expression, expected);
+            } catch (const std::exception&) {
+                want_error = true;
+            }
+            bool error = false;
+            std::vector<std::string> got;
+            try {
+                got = query(expression, lazy);
+            } catch (const std::exception&) {
+                error = true;
+            }
+            assert(error == want_error);
+            assert(got == want);
+        }
+        assert(lazy.to_value() == expected);
+    }
+    std::cout << " test_lazy_matches_parser passed\n";
+}
+
+void test_lazy_skips_unvisited() {
+    std::string doc = "users[20000]{id,name}:\n";
+    for (int i = 0; i < 20000; ++i) {
+        doc += "  " + std::to_string(i) + ",user" + std::to_string(i) + "\n";
+    }
+    doc += "log[3000]:\n";
+    for (int i = 0; i < 3000; ++i) {
+        doc += "  - at: " + std::to_string(i) + "\n    msg: m\n";
+    }
+    doc += "metadata:\n  count: 20000\n  source:\n    name: test\n";
+
+    LazyDocument lazy(doc);
+    assert(lazy.lines_decoded() == 0);
+    assert(query(".metadata.count", lazy) == std::vector<std::string>{"20000"});
+    assert(lazy.lines_decoded() < 10);  // the top-level keys and metadata's fields
+    assert(query(".metadata | length", lazy) == std::vector<std::string>{"2"});
+    assert(lazy.lines_decoded() < 10);
+
+    assert(query(".users[19999].name", lazy) == std::vector<std::string>{"user19999"});
+    assert(lazy.lines_decoded() >= 20000);
+    size_t after_users = lazy.lines_decoded();
+    assert(query(".users | length", lazy) == std::vector<std::string>{"20000"});
+    assert(lazy.lines_decoded() == after_users);  // decoded once
+
+    // Decoding a whole object reuses the fields lookups have resolved
+    std::string nested = "a:\n  b:\n    c:\n      d: 1\n  e: 2\nf: 3\n";
+    for (const char* expression : {".", "..", ".a.b.c.d, .", ".a.e, .a, ."}) {
+        LazyDocument small(nested, nullptr, 1);
+        assert(query(expression, small) == run(expression, ToonParser::parse(nested)));
+        assert(small.lines_decoded() <= 6);
+    }
+    std::cout << " test_lazy_skips_unvisited passed\n";
+}
+
+void test_lazy_malformed() {
+    // The tree parser ends the object at the stray row; skipping by
+    // indentation carries on to the next field
+    std::string doc = "rows[2]{a}:\n  1\n  2\n  3\nnext: x";
+    assert(!ToonParser::parse(doc).as_object().contains("next"));
+    LazyDocument lazy(doc);
+    assert(query(".next", lazy) == std::vector<std::string>{"x"});
+    assert(query(".rows | length", lazy) == std::vector<std::string>{"2"});
+    std::cout << " test_lazy_malformed passed\n";
+}
+
+void test_lazy_concurrent() {
+    std::string doc;
+    for (int i = 0; i < 64; ++i) {
+        doc += "k" + std::to_string(i) + ":\n  rows[3]{a,b}:\n    1,2\n    3,4\n    5," + std::to_string(i) + "\n  name: n" + std::to_string(i) + "\n";
+    }
+    LazyDocument lazy(doc, nullptr, 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&lazy, t] {
+            for (int j = 0; j < 64; ++j) {
+                int i = (j * 7 + t * 13) % 64;
+                std::string k = ".k" + std::to_string(i);
+                assert(query(k + ".rows[2].b", lazy) == std::vector<std::string>{std::to_string(i)});
+                assert(query(k + ".name", lazy) == std::vector<std::string>{"n" + std::to_string(i)});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    assert(lazy.to_value() == ToonParser::parse(doc));
+    std::cout << " test_lazy_concurrent passed\n";
+}
+
+int main() {
+    try {
+        test_lazy_matches_parser();
+        test_lazy_skips_unvisited();
+        test_lazy_malformed();
+        test_lazy_concurrent();
+
+        std::cout << "\nAll LazyDocument tests passed!\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,114 @@
+#include "tq/tq.hpp"
+#include "fixtures.hpp"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <vector>
+
+using namespace tq;
+
+using fixtures::kDocs;
+using fixtures::kQueries;
+using fixtures::run;
+
+namespace {
+    // Results or, if the query fails, a marker
+    std::vector<std::string> outcome(const std::string& expression, const Value& data) {
+        try {
+            return run(expression, data);
+        } catch (const std::exception&) {
+            return {"<error>"};
+        }
+    }
+}
+
+void test_projection_whole() {
+    // Whole-value operations read everything there is
+    for (const char* expression : {".", "..", "keys", "length", ". | tostring", "to_entries"}) {
+        assert(Projection::of(Document::compile(expression)) == nullptr);
+    }
+    assert(Projection::of(Document::compile(".a")) != nullptr);
+    assert(Projection::of(Document::compile(".a | keys")) != nullptr);
+    std::cout << " test_projection_whole passed\n";
+}
+
+void test_projection_matches_full_parse() {
+    for (const auto& doc : kDocs) {
+        Value full = ToonParser::parse(doc);
+        for (const auto& expression : kQueries) {
+            auto projection = Projection::of(Document::compile(expression));
+            std::vector<std::string> want = outcome(expression, full);
+            assert(outcome(expression, ToonParser::parse(doc, nullptr, 1, projection.get())) == want);
+
+            LazyDocument lazy(doc, nullptr, 1, projection);
+            std::vector<std::string> got;
+            try {
+                got = query(expression, lazy);
+            } catch (const std::exception&) {
+                got = {"<error>"};
+            }
+            assert(got == want);
+        }
+    }
+    std::cout << " test_projection_matches_full_parse passed\n";
+}
+
+void test_projection_skips_fields() {
+    std::string doc = "users[2]{id,name,age}:\n  1,Alice,30\n  2,Bob,25\n"
+                      "log[2]:\n  - at: 1\n    msg: m\n  - at: 2\n    msg: n\n"
+                      "meta:\n  owner: ops\n";
+
+    auto projection = Projection::of(Document::compile(".users[] | {name: .name}"));
+    Value data = ToonParser::parse(doc, nullptr, 1, projection.get());
+    assert(data.as_object().contains("users"));
+    assert(!data.as_object().contains("log"));
+    assert(!data.as_object().contains("meta"));
+    Value user = data.as_object().at("users").element(1).as_object().at("name");
+    assert(user.as_string() == "Bob");
+    assert(data.as_object().at("users").element(1).field_count() == 1);
+
+    // Elements nobody reads stay, as empty objects, so lengths are kept
+    projection = Projection::of(Document::compile(".log[] | 1"));
+    data = ToonParser::parse(doc, nullptr, 1, projection.get());
+    assert(data.as_object().at("log").array_size() == 2);
+    assert(data.as_object().at("log").element(0).field_count() == 0);
+
+    projection = Projection::of(Document::compile(".log[].msg"));
+    data = ToonParser::parse(doc, nullptr, 1, projection.get());
+    assert(data.as_object().at("log").element(1).field_count() == 1);
+    assert(run(".log[].msg", data) == (std::vector<std::string>{"m", "n"}));
+    std::cout << " test_projection_skips_fields passed\n";
+}
+
+void test_projection_parallel() {
+    // Large enough for the arrays to be decoded in ranges on several threads
+    std::string doc = "rows[40000]{a,b,c}:\n";
+    for (int i = 0; i < 40000; ++i) {
+        doc += "  " + std::to_string(i) + ",x" + std::to_string(i) + "," + std::to_string(i % 7) + "\n";
+    }
+    doc += "items[20000]:\n";
+    for (int i = 0; i < 20000; ++i) {
+        doc += "  - id: " + std::to_string(i) + "\n    tag: t\n";
+    }
+    Value full = ToonParser::parse(doc, nullptr, 1);
+    for (const char* expression : {".rows[] | select(.c == 3) | .b", ".items[] | .id", "[.rows[].a] | add"}) {
+        auto projection = Projection::of(Document::compile(expression));
+        assert(run(expression, ToonParser::parse(doc, nullptr, 4, projection.get())) == run(expression, full));
+    }
+    std::cout << " test_projection_parallel passed\n";
+}
+
+int main() {
+    try {
+        test_projection_whole();
+        test_projection_matches_full_parse();
+        test_projection_skips_fields();
+        test_projection_parallel();
+
+        std::cout << "\nAll Projection tests passed!\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << "\n";
+        return 1;
+    }
+}
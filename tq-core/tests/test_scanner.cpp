@@ -0,0 +1,160 @@
+#include "tq/tq.hpp"
+#include "fixtures.hpp"
+#include <iostream>
+#include <cassert>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace tq;
+
+namespace {
+    const ScanBackend kBackends[] = {ScanBackend::Scalar, ScanBackend::SSE42, ScanBackend::AVX2, ScanBackend::AVX512};
+
+    std::vector<ScanBlock> scan_all(std::string_view text, size_t extra_blocks = 0) {
+        std::vector<ScanBlock> blocks((text.size() + 63) / 64 + extra_blocks);
+        StructuralScanner::scan(text, 0, blocks.size(), blocks.data());
+        return blocks;
+    }
+
+    bool same(const std::vector<ScanBlock>& a, const std::vector<ScanBlock>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].newline != b[i].newline || a[i].colon != b[i].colon || a[i].quote != b[i].quote ||
+                a[i].escape != b[i].escape || a[i].delimiter != b[i].delimiter) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Structural bytes mixed with filler, so every bit position sees them
+    std::string random_text(std::mt19937& rng, size_t size) {
+        const char alphabet[] = "\n:\"\\,|\t ab1-\r\x80\xff";
+        std::string text(size, ' ');
+        for (char& c : text) {
+            c = alphabet[rng() % (sizeof(alphabet) - 1)];
+        }
+        return text;
+    }
+
+    // Quoting, escapes and delimiters the scanner has to classify, on top of
+    // the shared corpus
+    const std::vector<std::string> kScannerDocs = {
+        "users[3]{id,name,role}:\n  1,Alice,admin\n  2,\"Bob, Jr.\",user\n  3,\"Carol \\\"C\\\"\",guest\n",
+        "items[2]:\n  - k: \"a:b\"\n    n: 1\n  - k: \"c\\\\\"\n    n: \"x,y|z\"\n",
+        "pipes[2|]{a|b}:\n  1|\"2|3\"\n  x,y|z\n",
+        "tabs[3\t]: a\tb, c\t\"d\te\"\n",
+        "\"quoted: key\": value\nplain: \"with \\\"escaped: quote\\\"\"\n",
+    };
+}
+
+void test_scan_backends_agree() {
+    std::mt19937 rng(17);
+    std::vector<std::string> inputs = {"", "a", std::string(64, ':'), std::string(63, '"') + "\n", std::string(129, ',')};
+    for (size_t size : {1, 15, 16, 31, 32, 63, 64, 65, 127, 200, 1000, 4099}) {
+        inputs.push_back(random_text(rng, size));
+    }
+
+    StructuralScanner::force(ScanBackend::Scalar);
+    std::vector<std::vector<ScanBlock>> expected;
+    for (const auto& input : inputs) {
+        expected.push_back(scan_all(input, 2));
+    }
+    
+    // Bit i of block b is byte 64 * b + i; padding past the end never matches
+    std::vector<ScanBlock> blocks = scan_all("a:\n" + std::string(61, ' ') + "\"|", 1);
+    assert(blocks.size() == 3);
+    assert(blocks[0].colon == 2 && blocks[0].newline == 4 && blocks[0].delimiter == 0);
+    assert(blocks[1].quote == 1 && blocks[1].delimiter == 2);
+    assert(blocks[2].newline == 0 && blocks[2].quote == 0);
+
+    for (ScanBackend backend : kBackends) {
+        if (!StructuralScanner::supported(backend)) {
+            std::cout << " (" << StructuralScanner::name(backend) << " not supported here)\n";
+            continue;
+        }
+        StructuralScanner::force(backend);
+        assert(StructuralScanner::backend() == backend);
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            assert(same(scan_all(inputs[i], 2), expected[i]));
+            
+            // Starting part way through gives the same blocks
+            if (expected[i].size() > 3) {
+                std::vector<ScanBlock> tail(expected[i].size() - 3);
+                StructuralScanner::scan(inputs[i], 3, tail.size(), tail.data());
+                assert(same(tail, std::vector<ScanBlock>(expected[i].begin() + 3, expected[i].end())));
+            }
+        }
+    }
+    StructuralScanner::reset();
+    std::cout << " test_scan_backends_agree passed\n";
+}
+
+void test_parse_backends_agree() {
+    // Rows longer than a block, so quotes and escapes cross block boundaries
+    std::string wide = "wide[40]{a,b,c}:\n";
+    for (int i = 0; i < 40; ++i) {
+        wide += "  " + std::to_string(i) + ",\"" + std::string(i * 3, 'x') + ",\\\"" + std::string(i, ':') + "\",end|" + std::to_string(i) + "\n";
+    }
+    std::vector<std::string> docs = fixtures::kDocs;
+    docs.insert(docs.end(), kScannerDocs.begin(), kScannerDocs.end());
+    docs.push_back(wide);
+
+    StructuralScanner::force(ScanBackend::Scalar);
+    std::vector<Value> expected;
+    for (const auto& doc : docs) {
+        expected.push_back(ToonParser::parse(doc));
+    }
+    assert(expected[fixtures::kDocs.size() + 1].get("items")->as_array()[0].get("k")->as_string() == "a:b");
+    assert(expected.back().get("wide")->as_array()[39].get("b")->as_string() ==
+           std::string(117, 'x') + ",\"" + std::string(39, ':'));
+
+    for (ScanBackend backend : kBackends) {
+        if (!StructuralScanner::supported(backend)) {
+            continue;
+        }
+        StructuralScanner::force(backend);
+        for (size_t i = 0; i < docs.size(); ++i) {
+            Value tree = ToonParser::parse(docs[i]);
+            assert(tree == expected[i]);
+            assert(tree.to_toon() == expected[i].to_toon());
+            assert(ToonParser::parse_tape(docs[i]).to_value() == expected[i]);
+        }
+    }
+    StructuralScanner::reset();
+    std::cout << " test_parse_backends_agree passed\n";
+}
+
+void test_force_unsupported() {
+    for (ScanBackend backend : kBackends) {
+        if (StructuralScanner::supported(backend)) {
+            continue;
+        }
+        bool threw = false;
+        try {
+            StructuralScanner::force(backend);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    assert(StructuralScanner::supported(ScanBackend::Scalar));
+    std::cout << " test_force_unsupported passed\n";
+}
+
+int main() {
+    try {
+        test_scan_backends_agree();
+        test_parse_backends_agree();
+        test_force_unsupported();
+
+        std::cout << "\nAll scanner tests passed!\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << "\n";
+        return 1;
+    }
+}
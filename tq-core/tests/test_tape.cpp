@@ -0,0 +1,252 @@
+#include "tq/tq.hpp"
+#include "fixtures.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace tq;
+
+namespace {
+    const std::string& kDoc = fixtures::kMixed;
+
+    std::string render(const std::vector<Value>& results) {
+        std::string out;
+        for (const auto& value : results) {
+            out += value.to_toon() + "\n";
+        }
+        return out;
+    }
+}
+
+void test_tape_round_trip() {
+    std::vector<std::string> docs = fixtures::kDocs;
+    docs.insert(docs.end(), {"rows[2]{a,b}:\n  1,2\n  3", "list[2]:\n  - [2]:\n    - 1\n    - 2\n  - x"});
+    for (const auto& doc : docs) {
+        Value tree = ToonParser::parse(doc);
+        Value flat = ToonParser::parse_tape(doc).to_value();
+        assert(flat == tree);
+        assert(flat.to_toon() == tree.to_toon());
+    }
+
+    // Header rows come back as a table, short rows as plain objects
+    Tape tape = ToonParser::parse_tape(kDoc);
+    assert(tape.to_value().get("users")->is_table());
+    assert(!ToonParser::parse_tape("rows[2]{a,b}:\n  1,2\n  3").to_value().get("rows")->is_table());
+    std::cout << " test_tape_round_trip passed\n";
+}
+
+void test_tape_navigation() {
+    Tape tape = ToonParser::parse_tape(kDoc);
+    TapeRef root = tape.root();
+    assert(root.is_object() && root.size() == 4);
+
+    TapeRef users = root.get(Key("users"));
+    assert(users.is_array() && users.size() == 4);
+    assert(users.get(2).get(Key("name")).to_value().as_string() == "Carol \"C\"");
+    assert(users.get(3).get(Key("age")).to_value().as_integer() == -7);
+    assert(!users.get(4));
+    assert(!users.get(Key("name")));
+    assert(!root.get(Key("missing")));
+
+    TapeRef limits = root.get(Key("meta")).get(Key("limits"));
+    assert(limits.get(Key("max")).to_value().as_number() == 9007199254740993.0);
+    assert(limits.get(Key("min")).to_value().as_number() == 1e-3);
+    assert(root.get(Key("tags")).get(1).to_value().as_string().empty());
+
+    std::vector<TapeRef> items;
+    root.get(Key("items")).children(items);
+    assert(items.size() == 3);
+    assert(items[1].get(Key("n")).type() == Value::Type::Null);
+    assert(items[2].get(Key("n")).type() == Value::Type::Boolean);
+
+    // A repeated key keeps its last value
+    Tape repeated = ToonParser::parse_tape("a: 1\nb: 2\na: 3");
+    assert(repeated.root().size() == 2);
+    assert(repeated.root().get(Key("a")).to_value().as_integer() == 3);
+    std::vector<TapeRef> fields;
+    repeated.root().children(fields);
+    assert(fields.size() == 2);
+    std::cout << " test_tape_navigation passed\n";
+}
+
+void test_tape_queries() {
+    // Beyond the shared queries: slices, negative and missing indices,
+    // optional access and builtins over whole arrays
+    std::vector<std::string> expressions = fixtures::kQueries;
+    expressions.insert(expressions.end(), {
+        ".meta.owner",
+        ".users[]",
+        ".users[].name",
+        ".users[1:3]",
+        ".users[-1].age",
+        ".users[9]",
+        ".items[] | .n?",
+        ".tags[], .meta.owner",
+        ".users | length",
+        ".users[] | select(.age > 26) | .name",
+        ".users | map(.role) | unique",
+        ".items | map(.k) | join(\"-\")",
+        "[.users[] | .id] | add",
+    });
+
+    Evaluator evaluator;
+    for (const auto& doc : fixtures::kDocs) {
+        Tape tape = ToonParser::parse_tape(doc);
+        Value tree = ToonParser::parse(doc);
+        for (const auto& expression : expressions) {
+            Query query = Document::compile(expression);
+            std::string want;
+            try {
+                want = render(evaluator.eval(query.root, tree));
+            } catch (const std::exception&) {
+                want = "<error>";
+            }
+            std::string got;
+            try {
+                got = render(evaluator.eval(query.root, tape));
+            } catch (const std::exception&) {
+                got = "<error>";
+            }
+            assert(got == want);
+        }
+    }
+    std::cout << " test_tape_queries passed\n";
+}
+
+void test_tape_snapshot() {
+    std::string path = (std::filesystem::temp_directory_path() / "tq_test_tape.tqb").string();
+    ToonParser::parse_tape(kDoc).save(path);
+    
+    Tape loaded = Tape::load(path);
+    Value tree = ToonParser::parse(kDoc);
+    assert(loaded.to_value() == tree);
+    assert(query(".users[2].name", loaded) == query(".users[2].name", kDoc));
+    assert(query(".items[] | .n", loaded) == query(".items[] | .n", kDoc));
+    assert(!loaded.root().get(Key("never_used_as_a_key")));
+    
+    // Results are owned copies and outlive the mapping
+    std::vector<Value> kept;
+    {
+        Tape scoped = Tape::load(path);
+        Evaluator evaluator;
+        kept = evaluator.eval(Document::compile(".meta.owner").root, scoped);
+    }
+    assert(kept[0].as_string() == "ops");
+    
+    // Truncated files and other files are rejected
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    for (const std::string& contents : {bytes.substr(0, bytes.size() / 2), std::string(kDoc)}) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+        bool threw = false;
+        try {
+            Tape::load(path);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    std::filesystem::remove(path);
+    std::cout << " test_tape_snapshot passed\n";
+}
+
+void test_tape_corrupt_snapshot() {
+    std::string path = (std::filesystem::temp_directory_path() / "tq_test_corrupt.tqb").string();
+    Tape tape = ToonParser::parse_tape(kDoc);
+    tape.save(path);
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    
+    // The words follow a 48-byte header; the tag is a word's top byte
+    const size_t kHeader = 48;
+    uint64_t word_count;
+    std::memcpy(&word_count, bytes.data() + 16, sizeof word_count);
+    auto word = [&](const std::string& b, size_t i) {
+        uint64_t w;
+        std::memcpy(&w, b.data() + kHeader + i * 8, sizeof w);
+        return w;
+    };
+    auto with_word = [&](size_t i, uint64_t w) {
+        std::string b = bytes;
+        std::memcpy(b.data() + kHeader + i * 8, &w, sizeof w);
+        return b;
+    };
+    // Loading reads only the header and key names; damage to the words is
+    // found by whatever reads them
+    auto rejected = [&](const std::string& contents) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+        Tape loaded = Tape::load(path);
+        try {
+            loaded.to_value();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(!rejected(bytes));
+    
+    // Each kind of damage readers would otherwise follow out of bounds
+    size_t string_word = 0, key_word = 0;
+    for (size_t i = 0; i < word_count; ++i) {
+        char tag = static_cast<char>(word(bytes, i) >> 56);
+        if (tag == 's' && !string_word) {
+            string_word = i;
+        } else if (tag == 'k' && !key_word) {
+            key_word = i;
+        }
+        if (tag == 'l' || tag == 'd' || tag == 's') {
+            ++i;
+        }
+    }
+    uint64_t root = word(bytes, 0);
+    assert(rejected(with_word(0, (root & ~uint64_t{UINT32_MAX}) | (word_count + 5))));  // end past the words
+    assert(rejected(with_word(0, (root & ~uint64_t{UINT32_MAX}) | (word_count - 1))));  // end short of the close
+    assert(rejected(with_word(word_count - 1, uint64_t{'n'} << 56)));                  // object never closed
+    assert(rejected(with_word(string_word + 1, uint64_t{1} << 40)));                   // string past the buffer
+    assert(rejected(with_word(string_word, word(bytes, string_word) | 0xFFFFFFFF)));   // offset past the buffer
+    assert(rejected(with_word(key_word, word(bytes, key_word) | 0xFFFF)));             // no such key
+    assert(rejected(with_word(key_word, uint64_t{'?'} << 56)));                        // unknown tag
+    
+    // Whatever single word is damaged, every way of reading it either
+    // throws or stays in bounds
+    for (size_t i = 0; i < word_count; ++i) {
+        for (uint64_t flip : {uint64_t{1}, uint64_t{0xFF} << 56, uint64_t{1} << 32, uint64_t{1} << 55}) {
+            std::ofstream(path, std::ios::binary | std::ios::trunc) << with_word(i, word(bytes, i) ^ flip);
+            Tape loaded = Tape::load(path);
+            for (const char* expr : {".", "..", ".users[2].name", ".items[] | .n", ".meta | keys", ".users | length"}) {
+                try {
+                    query(expr, loaded);
+                } catch (const std::runtime_error&) {
+                }
+            }
+        }
+    }
+    std::filesystem::remove(path);
+    std::cout << " test_tape_corrupt_snapshot passed\n";
+}
+
+int main() {
+    try {
+        test_tape_round_trip();
+        test_tape_navigation();
+        test_tape_queries();
+        test_tape_snapshot();
+        test_tape_corrupt_snapshot();
+
+        std::cout << "\nAll Tape tests passed!\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << "\n";
+        return 1;
+    }
+}
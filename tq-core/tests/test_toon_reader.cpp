@@ -0,0 +1,239 @@
+#include "tq/tq.hpp"
+#include "fixtures.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace tq;
+
+namespace {
+    // The shared corpus and the malformed shapes a streaming reader has to
+    // end the same way the tree parser does
+    std::vector<std::string> reader_docs() {
+        std::vector<std::string> docs = fixtures::kDocs;
+        docs.insert(docs.end(), {
+            "short[5]:\n  - 1\n  - 2\nafter: 1",
+            "rows[2]{a}:\n  1\n  2\n  3\nnext: x",
+            "items[2]:\n  - a: 1\n    stray\n  - b: 2",
+            "trailing: 1\n\n\n",
+            "x[-1]:\n  - 1\n  - 2\n  - 3",
+        });
+        return docs;
+    }
+    const std::vector<std::string> kDocs = reader_docs();
+
+    // Rebuilds the tree ToonParser::parse would give from the events
+    Value build(ToonReader& reader, ToonReader::Event event) {
+        switch (event) {
+            case ToonReader::Event::Scalar:
+                return reader.value();
+            case ToonReader::Event::BeginArray: {
+                std::vector<Value> items;
+                for (auto next = reader.next(); next != ToonReader::Event::EndArray; next = reader.next()) {
+                    items.push_back(build(reader, next));
+                }
+                return Value(std::move(items));
+            }
+            case ToonReader::Event::BeginObject: {
+                Object obj;
+                for (auto next = reader.next(); next != ToonReader::Event::EndObject; next = reader.next()) {
+                    assert(next == ToonReader::Event::Key);
+                    Key key{reader.key()};
+                    obj[key] = build(reader, reader.next());
+                }
+                return Value(std::move(obj));
+            }
+            default:
+                assert(false && "unexpected event");
+                return Value();
+        }
+    }
+
+    Value read_all(ToonReader& reader) {
+        Value root = build(reader, reader.next());
+        assert(reader.next() == ToonReader::Event::End);
+        assert(reader.next() == ToonReader::Event::End);
+        assert(reader.depth() == 0);
+        return root;
+    }
+
+    // Endless rows made up on the fly, so the document never exists in memory
+    class RowSource : public std::streambuf {
+    public:
+        explicit RowSource(size_t rows) : rows_(rows) {
+            line_ = "rows[" + std::to_string(rows) + "]{id,name,score}:\n";
+            setg(line_.data(), line_.data(), line_.data() + line_.size());
+        }
+
+    protected:
+        int_type underflow() override {
+            if (next_ == rows_) {
+                return traits_type::eof();
+            }
+            line_ = "  " + std::to_string(next_) + ",user " + std::to_string(next_ % 97) + "," + std::to_string(next_ * 0.25) + "\n";
+            next_++;
+            setg(line_.data(), line_.data(), line_.data() + line_.size());
+            return traits_type::to_int_type(line_[0]);
+        }
+
+    private:
+        size_t rows_;
+        size_t next_ = 0;
+        std::string line_;
+    };
+}
+
+void test_reader_matches_parser() {
+    for (const auto& doc : kDocs) {
+        Value expected = ToonParser::parse(doc);
+        for (size_t chunk : {1, 2, 3, 7, 64, 65536}) {
+            std::istringstream in(doc);
+            ToonReader reader(in, chunk);
+            Value streamed = read_all(reader);
+            assert(streamed == expected);
+            assert(streamed.to_toon() == expected.to_toon());
+        }
+    }
+    std::cout << " test_reader_matches_parser passed\n";
+}
+
+void test_reader_read_value() {
+    for (const auto& doc : kDocs) {
+        Value expected = ToonParser::parse(doc);
+        std::istringstream in(doc);
+        ToonReader reader(in, 5);
+        reader.next();
+        assert(reader.read_value() == expected);
+        assert(reader.next() == ToonReader::Event::End);
+
+        // Skipping every top-level value lands on the end of the root
+        std::istringstream again(doc);
+        ToonReader skipper(again, 5);
+        if (skipper.next() == ToonReader::Event::BeginObject) {
+            while (skipper.next() == ToonReader::Event::Key) {
+                skipper.next();
+                skipper.skip_value();
+            }
+            assert(skipper.event() == ToonReader::Event::EndObject);
+        } else {
+            skipper.skip_value();
+        }
+        assert(skipper.next() == ToonReader::Event::End);
+        assert(skipper.depth() == 0);
+    }
+    std::cout << " test_reader_read_value passed\n";
+}
+
+void test_reader_events() {
+    std::istringstream in("users[2]{id,name}:\n  1,Ada\n  2,\"B, \\\"b\\\"\"\n\"x y\": [2]\n");
+    ToonReader reader(in, 4);
+    using E = ToonReader::Event;
+    
+    assert(reader.next() == E::BeginObject && reader.depth() == 1);
+    assert(reader.next() == E::Key && reader.key() == "users");
+    assert(reader.next() == E::BeginArray && reader.length() == 2 && reader.depth() == 2);
+    assert(reader.next() == E::BeginObject);
+    assert(reader.next() == E::Key && reader.key() == "id");
+    assert(reader.next() == E::Scalar && reader.text() == "1" && reader.value().as_integer() == 1);
+    assert(reader.next() == E::Key && reader.key() == "name");
+    assert(reader.next() == E::Scalar && reader.value().as_string() == "Ada");
+    assert(reader.next() == E::EndObject);
+    assert(reader.next() == E::BeginObject);
+    reader.next();
+    reader.next();
+    reader.next();
+    assert(reader.next() == E::Scalar && reader.value().as_string() == "B, \"b\"");
+    assert(reader.next() == E::EndObject);
+    assert(reader.next() == E::EndArray && reader.depth() == 1);
+    assert(reader.next() == E::Key && reader.key() == "x y");
+    assert(reader.next() == E::Scalar && reader.value().as_string() == "[2]");
+    assert(reader.next() == E::EndObject && reader.depth() == 0);
+    assert(reader.next() == E::End);
+    
+    bool threw = false;
+    try {
+        reader.value();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << " test_reader_events passed\n";
+}
+
+void test_reader_streams() {
+    // A few hundred thousand rows in 4 KB chunks; nothing keeps the whole
+    // document, and every row arrives in order
+    const size_t rows = 300000;
+    RowSource source(rows);
+    std::istream in(&source);
+    ToonReader reader(in, 4096);
+    
+    size_t seen = 0;
+    double total = 0;
+    for (auto event = reader.next(); event != ToonReader::Event::End; event = reader.next()) {
+        assert(reader.depth() <= 3);
+        if (event == ToonReader::Event::Key && reader.key() == "id") {
+            reader.next();
+            assert(reader.value().as_integer() == static_cast<int64_t>(seen));
+            seen++;
+        } else if (event == ToonReader::Event::Key && reader.key() == "score") {
+            reader.next();
+            total += reader.value().as_number();
+        }
+    }
+    assert(seen == rows);
+    assert(total == 0.25 * (rows - 1) * rows / 2);
+    std::cout << " test_reader_streams passed\n";
+}
+
+void test_reader_fd() {
+#ifndef _WIN32
+    std::string path = (std::filesystem::temp_directory_path() / "tq_test_reader.toon").string();
+    std::ofstream(path, std::ios::binary) << fixtures::kMixed;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    assert(fd >= 0);
+    {
+        ToonReader reader(fd, 16);
+        assert(read_all(reader) == ToonParser::parse(fixtures::kMixed));
+    }
+    ::close(fd);
+    std::filesystem::remove(path);
+    
+    bool threw = false;
+    try {
+        ToonReader reader(-1);
+        reader.next();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+#endif
+    std::cout << " test_reader_fd passed\n";
+}
+
+int main() {
+    try {
+        test_reader_matches_parser();
+        test_reader_read_value();
+        test_reader_events();
+        test_reader_streams();
+        test_reader_fd();
+
+        std::cout << "\nAll ToonReader tests passed!\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -1,6 +1,15 @@
 #include "tq/value.hpp"
+#include "tq/checked.hpp"
+#include "tq/toon_parser.hpp"
+#include "tq/tq.hpp"
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
 
 using namespace tq;
 
@@ -28,6 +37,99 @@ void test_number() {
     std::cout << " test_number passed\n";
 }
 
+void test_integer() {
+    Value big = Value::parse_number("9223372036854775807");
+    assert(big.is_integer());
+    assert(big.as_integer() == INT64_MAX);
+    assert(big.to_toon() == "9223372036854775807");
+    
+    // Out of int64 range, fractions and exponents become doubles
+    assert(!Value::parse_number("9223372036854775808").is_integer());
+    assert(!Value::parse_number("1.5").is_integer());
+    assert(Value::parse_number("-0.0").to_toon() == "0");
+    assert(Value::parse_number("+7").as_integer() == 7);
+    assert(Value(0.1).to_toon() == "0.1");
+    assert(Value(123456789.25).to_toon() == "123456789.25");
+    
+    bool threw = false;
+    try {
+        Value::parse_number("12abc");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << " test_integer passed\n";
+}
+
+void test_checked_arithmetic() {
+    // The portable fallbacks agree with the compiler's builtins on the edges
+    const int64_t edges[] = {0, 1, -1, 2, -2, 3037000499, -3037000500, 4611686018427387904,
+                             INT64_MAX, INT64_MAX - 1, INT64_MIN, INT64_MIN + 1};
+    for (int64_t a : edges) {
+        for (int64_t b : edges) {
+            int64_t want = 0, got = 0;
+            bool overflow = checked::add(a, b, want);
+            assert(checked::portable_add(a, b, got) == overflow && (overflow || got == want));
+            overflow = checked::sub(a, b, want);
+            assert(checked::portable_sub(a, b, got) == overflow && (overflow || got == want));
+            overflow = checked::mul(a, b, want);
+            assert(checked::portable_mul(a, b, got) == overflow && (overflow || got == want));
+        }
+    }
+    std::cout << " test_checked_arithmetic passed\n";
+}
+
+void test_number_parsing() {
+    Value out;
+    assert(Value::try_parse_number("-9223372036854775808", out) && out.as_integer() == INT64_MIN);
+    assert(Value::try_parse_number("-9223372036854775809", out) && !out.is_integer());
+    assert(Value::try_parse_number("00042", out) && out.as_integer() == 42);
+    assert(Value::try_parse_number("1e2", out) && !out.is_integer() && out.as_number() == 100.0);
+    assert(Value::try_parse_number("5.", out) && out.as_number() == 5.0);
+    assert(Value::try_parse_number("-.5", out) && out.as_number() == -0.5);
+    assert(Value::try_parse_number("-0", out) && out.to_toon() == "0");
+    assert(Value::try_parse_number("-0e5", out) && !std::signbit(out.as_number()));
+    
+    // Malformed text and values out of double range leave out untouched
+    out = Value(7);
+    for (const char* text : {"", "-", "+", ".", "e5", "1e", "1e+", "+-5", "1.2.3", "1e5.5", "0x10", "nan", "inf", " 1", "1 ", "1e400"}) {
+        assert(!Value::try_parse_number(text, out));
+    }
+    assert(out.as_integer() == 7);
+    
+    // Every path agrees with from_chars: short decimals take the fast path,
+    // long mantissas and large exponents the exact fallback
+    uint64_t seed = 88172645463325252ull;
+    auto next = [&]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+    for (int i = 0; i < 20000; ++i) {
+        std::string text = std::to_string(next() % 100000000000000000ull >> (next() % 60));
+        text.insert(next() % (text.size() + 1), ".");
+        if (i % 3 == 0) {
+            text += "e" + std::to_string(static_cast<int>(next() % 80) - 40);
+        }
+        if (i % 7 == 0) {
+            text = "12345678901234567890123" + text;
+        }
+        double expected = std::strtod(text.c_str(), nullptr);
+        assert(Value::try_parse_number(text, out) && out.as_number() == expected);
+    }
+    assert(Value::try_parse_number("9007199254740993", out) && out.as_integer() == 9007199254740993);
+    assert(Value::try_parse_number("9007199254740993.0", out) && out.as_number() == 9007199254740992.0);
+    assert(Value::try_parse_number("0.1", out) && out.as_number() == 0.1);
+    
+    // Strings that read back as numbers are quoted, whatever their padding
+    assert(Value("12").to_toon() == "\"12\"");
+    assert(Value(" -1.5e3 ").to_toon() == "\" -1.5e3 \"");
+    assert(Value("0x10").to_toon() == "0x10");
+    assert(Value("v1.2").to_toon() == "v1.2");
+    std::cout << " test_number_parsing passed\n";
+}
+
 void test_string() {
     Value v("hello");
     assert(v.is_string());
@@ -60,14 +162,440 @@ void test_object() {
     std::cout << " test_object passed\n";
 }
 
+void test_copy_on_write() {
+    std::vector<Value> items;
+    items.push_back(Value(1));
+    items.push_back(Value("two"));
+    Value original(std::move(items));
+    
+    // Copies share the same storage
+    Value copy = original;
+    const Value& const_original = original;
+    const Value& const_copy = copy;
+    assert(&const_original.as_array() == &const_copy.as_array());
+    
+    // Mutating the copy leaves the original untouched
+    copy.as_array().push_back(Value(3));
+    assert(const_copy.as_array().size() == 3);
+    assert(const_original.as_array().size() == 2);
+    assert(&const_original.as_array() != &const_copy.as_array());
+    
+    std::map<std::string, Value> fields;
+    fields["name"] = Value("Alice");
+    Value obj(std::move(fields));
+    Value obj_copy = obj;
+    obj_copy.as_object()["name"] = Value("Bob");
+    assert(obj.get("name")->as_string() == "Alice");
+    assert(obj_copy.get("name")->as_string() == "Bob");
+    std::cout << " test_copy_on_write passed\n";
+}
+
+void test_compact_layout() {
+    // Scalars inline, strings and containers behind one pointer
+    static_assert(sizeof(Value) == 16, "Value should stay 16 bytes");
+    
+    Value s("shared string");
+    Value s_copy = s;
+    assert(s.as_string_view().data() == s_copy.as_string_view().data());
+    
+    Value n(2.5);
+    Value b(true);
+    assert(n.as_number() == 2.5);
+    assert(b.as_boolean());
+    std::cout << " test_compact_layout passed\n";
+}
+
+void test_object_layout() {
+    Object obj;
+    obj["zeta"] = Value(1);
+    obj["alpha"] = Value(2);
+    obj["mid"] = Value(3);
+    
+    // Insertion order is preserved
+    auto it = obj.begin();
+    assert(it->first == "zeta");
+    assert((++it)->first == "alpha");
+    assert((++it)->first == "mid");
+    
+    // Grow past the hash-index threshold and look every key up again
+    for (int i = 0; i < 100; ++i) {
+        obj.insert_or_assign("k" + std::to_string(i), Value(i));
+    }
+    assert(obj.size() == 103);
+    for (int i = 0; i < 100; ++i) {
+        assert(obj.at("k" + std::to_string(i)).as_number() == i);
+    }
+    assert(obj.find("missing") == obj.end());
+    
+    // Overwriting keeps the original position; erase keeps the rest in order
+    obj.insert_or_assign("zeta", Value(10));
+    assert(obj.begin()->second.as_number() == 10.0);
+    assert(obj.erase("alpha") == 1);
+    assert(!obj.contains("alpha"));
+    assert((++obj.begin())->first == "mid");
+    assert(obj.at("k99").as_number() == 99.0);
+
+    // Moved-from objects are empty and usable, in either mode
+    Object moved(std::move(obj));
+    assert(moved.size() == 102 && obj.empty());
+    obj.insert_or_assign("x", Value(2));
+    assert(obj.at("x").as_number() == 2.0 && obj.size() == 1);
+    Object small{{"a", Value(1)}};
+    Object target;
+    target = std::move(small);
+    small.insert_or_assign("b", Value(3));
+    assert(small.size() == 1 && !small.contains("a"));
+    target = std::move(moved);
+    moved["y"] = Value(4);
+    assert(target.size() == 102 && moved.size() == 1);
+    std::cout << " test_object_layout passed\n";
+}
+
+void test_key_interning() {
+    // The same name always maps to the same atom
+    Atom a = AtomTable::intern("interned_key");
+    assert(AtomTable::intern("interned_key") == a);
+    assert(AtomTable::lookup("interned_key") == a);
+    assert(AtomTable::name(a) == "interned_key");
+    assert(AtomTable::lookup("never_interned_key") == AtomTable::kNoAtom);
+    
+    Key key("interned_key");
+    assert(key.atom() == a);
+    assert(key == Key(a));
+    assert(key != Key("other_key"));
+    assert(key == "interned_key");
+    
+    // Lookups by name and by key agree, and misses do not intern
+    Value val(Object{{"interned_key", Value(7)}});
+    assert(val.get(key)->as_number() == 7.0);
+    assert(val.get("interned_key")->as_number() == 7.0);
+    size_t atoms = AtomTable::size();
+    assert(val.get("still_not_interned") == nullptr);
+    assert(AtomTable::size() == atoms);
+    std::cout << " test_key_interning passed\n";
+}
+
+void test_borrowed_strings() {
+    Value slice;
+    {
+        InputBuffer buffer(std::string("name: Alice"));
+        slice = buffer.slice(buffer.view().substr(6));
+    }
+    // The slice keeps the buffer alive after the InputBuffer handle is gone
+    assert(slice.is_string() && slice.is_borrowed());
+    assert(slice.as_string_view() == "Alice");
+    Value copy = slice;
+    assert(copy.as_string_view().data() == slice.as_string_view().data());
+    assert(copy.to_toon() == "Alice");
+    
+    // Slices from a reserved count hold real references once it is handed back
+    Value kept;
+    {
+        InputBuffer buffer(std::string("a, b, c"));
+        uint32_t reserved = 0;
+        std::vector<Value> slices;
+        for (size_t i = 0; i < 3; ++i) {
+            slices.push_back(buffer.slice(buffer.view().substr(i * 3, 1), reserved));
+        }
+        assert(reserved > 0);
+        buffer.unreserve(reserved);
+        assert(reserved == 0);
+        kept = slices[2];
+    }
+    assert(kept.is_borrowed() && kept.as_string_view() == "c");
+    
+    // Parsed strings borrow unless they need unescaping
+    Value doc = ToonParser::parse("plain: hello world\nquoted: \"a, b\"\nescaped: \"a\\tb\"");
+    assert(doc.get("plain")->is_borrowed());
+    assert(doc.get("plain")->as_string() == "hello world");
+    assert(doc.get("quoted")->is_borrowed());
+    assert(doc.get("quoted")->as_string() == "a, b");
+    assert(!doc.get("escaped")->is_borrowed());
+    assert(doc.get("escaped")->as_string() == "a\tb");
+    std::cout << " test_borrowed_strings passed\n";
+}
+
+void test_table() {
+    Key id("id");
+    Key name("name");
+    Value table = Value::table({id, name}, {{Value(1), Value(2)}, {Value("a"), Value("b")}});
+    assert(table.is_array() && table.is_table());
+    assert(table.array_size() == 2);
+    assert((*table.column(name))[1].as_string() == "b");
+    assert(table.column(Key("missing")) == nullptr);
+    
+    // Elements are row references that read the columns
+    Value row = table.element(1);
+    assert(row.is_object() && row.is_row());
+    assert(row.get(id)->as_integer() == 2);
+    assert(row.get("name")->as_string() == "b");
+    assert(row.get("missing") == nullptr);
+    
+    // A single row is built on its own and kept for the table's lifetime
+    const Value& const_table = table;
+    const Value first_ref = table.element(1);
+    const Value second_ref = table.element(1);
+    const Object& second = first_ref.as_object();
+    assert(&second == &const_table.get(size_t{1})->as_object());
+    assert(&second == &second_ref.as_object());
+    assert(second.begin()->first == "id");
+    assert(const_table.get(size_t{2}) == nullptr);
+
+    // Whole-row access materializes ordinary objects in header order
+    assert(row.as_object().begin()->first == "id");
+    assert(table.as_array()[0].get("name")->as_string() == "a");
+    
+    // Mutation converts to plain containers and leaves other copies intact
+    Value copy = table;
+    copy.as_array()[0].as_object()["id"] = Value(10);
+    assert(!copy.is_table());
+    assert(table.element(0).get(id)->as_integer() == 1);
+    row.as_object()["name"] = Value("z");
+    assert(!row.is_row());
+    assert(table.element(1).get(name)->as_string() == "b");
+    
+    // The parser keeps complete tables columnar and falls back on short rows
+    Value doc = ToonParser::parse("t[2]{a,b}:\n  1,2\n  3,4\nu[2]{a,b}:\n  1,2\n  3");
+    assert(doc.get("t")->is_table());
+    assert(!doc.get("u")->is_table());
+    assert(doc.get("u")->as_array()[1].as_object().size() == 1);
+    std::cout << " test_table passed\n";
+}
+
+void test_sequences() {
+    Value r = Value::range(2, 11, 3);
+    assert(r.is_array() && r.is_sequence());
+    assert(r.array_size() == 3);
+    assert(r.element(2).as_integer() == 8);
+    assert(Value::range(5, 0, -2).array_size() == 3);
+    assert(Value::range(5, 0).array_size() == 0);
+    assert(Value::range(INT64_MIN, INT64_MAX).array_size() == SIZE_MAX);
+    
+    // Huge sequences cost nothing until their elements are asked for
+    Value big = Value::range(0, 1000000000000);
+    assert(big.element(999999999999).as_integer() == 999999999999);
+    Value same = Value::repeat(Value("x"), 1000000000);
+    assert(same.element(123456789).as_string() == "x");
+    
+    // Sequences equal, hash and print like the arrays they stand for
+    Value plain(std::vector<Value>{Value(2), Value(5), Value(8)});
+    assert(r == plain && plain == r);
+    assert(r.hash() == plain.hash());
+    assert(r.to_toon() == plain.to_toon());
+    assert(Value::repeat(Value(0), 2) == Value(std::vector<Value>{Value(0), Value(0)}));
+    
+    // Mutation converts to a plain array and leaves other copies intact
+    Value copy = r;
+    copy.as_array().push_back(Value(11));
+    assert(!copy.is_sequence() && copy.array_size() == 4);
+    assert(r.is_sequence() && r.array_size() == 3);
+    
+    bool threw = false;
+    try {
+        Value::range(0, 1, 0);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << " test_sequences passed\n";
+}
+
+void test_snapshots() {
+    Value items(std::vector<Value>{Value(1), Value(2)});
+    Value first = items.snapshot();
+    assert(first.is_snapshot() && first.array_size() == 2);
+    
+    // Snapshots do not hold the array back from growing in place
+    const std::vector<Value>* storage = &std::as_const(items).as_array();
+    items.append({Value(3)});
+    Value second = items.snapshot();
+    items.append({Value(4)});
+    assert(&std::as_const(items).as_array() == storage);
+    assert(first.array_size() == 2 && second.array_size() == 3 && items.array_size() == 4);
+    assert(second.element(2).as_integer() == 3);
+    assert(second.as_array().size() == 3);
+    assert(first == Value(std::vector<Value>{Value(1), Value(2)}));
+    
+    // Any other copy still makes the next append clone
+    Value copy = items;
+    items.append({Value(5)});
+    assert(copy.array_size() == 4 && items.array_size() == 5);
+    
+    // Writing to a snapshot gives it storage of its own
+    first.as_array().push_back(Value(9));
+    assert(!first.is_snapshot() && first.array_size() == 3);
+    assert(second.array_size() == 3 && items.element(2).as_integer() == 3);
+    std::cout << " test_snapshots passed\n";
+}
+
+void test_shapes() {
+    // Objects built with the same keys in the same order share one shape
+    Object a{{"x", Value(1)}, {"y", Value(2)}};
+    Object b{{"x", Value(3)}, {"y", Value(4)}};
+    Object c{{"y", Value(5)}, {"x", Value(6)}};
+    assert(a.shape() != nullptr && a.shape() == b.shape());
+    assert(a.shape() != c.shape());
+    assert(Shape::of({Key("x"), Key("y")}) == a.shape());
+    assert(Shape::of({Key("x"), Key("x")}) == nullptr);
+    
+    // A field cache serves every object of the shape it saw, and misses
+    FieldCache cache;
+    Key y("y");
+    Value va(a), vb(b), vc(c);
+    assert(va.get(y, cache)->as_integer() == 2);
+    assert(vb.get(y, cache)->as_integer() == 4);
+    assert(vc.get(y, cache)->as_integer() == 5);
+    FieldCache miss;
+    assert(va.get(Key("z"), miss) == nullptr);
+    assert(vb.get(Key("z"), miss) == nullptr);
+    
+    // Erasing moves to the shape of the remaining keys
+    a.erase("x");
+    assert(a.shape() == Shape::of({y}));
+    assert(a.at("y").as_integer() == 2);
+    
+    // Past kMaxKeys an object keeps its own keys, and lookups still work
+    Object wide;
+    for (uint32_t i = 0; i <= Shape::kMaxKeys; ++i) {
+        wide.insert_or_assign("w" + std::to_string(i), Value(static_cast<int>(i)));
+    }
+    assert(wide.shape() == nullptr);
+    Value vw(wide);
+    assert(vw.get(Key("w64"), cache)->as_integer() == 64);
+    Object wide_copy = wide;
+    assert(wide_copy.at("w0").as_integer() == 0);
+    
+    // Table rows share the shape of their header
+    Value table = Value::table({Key("x"), y}, {{Value(1)}, {Value(2)}});
+    assert(table.element(0).get(y, cache)->as_integer() == 2);
+    assert(table.as_array()[0].as_object().shape() == b.shape());
+    std::cout << " test_shapes passed\n";
+}
+
+void test_arena() {
+    Object copy;
+    {
+        Arena arena;
+        Value doc = ToonParser::parse("items[2]:\n  - a: 1\n    b: x\n  - a: 2\n    b: y\nt[1]{k}:\n  v", &arena);
+        assert(arena.bytes_used() > 0);
+        assert(doc.get("items")->as_array()[1].get("a")->as_integer() == 2);
+        assert(doc.get("t")->is_table());
+        
+        // Copies of object storage land on the heap and outlive the arena
+        copy = doc.get("items")->as_array()[0].as_object();
+        
+        // Mutating a document in place keeps working while the arena lives
+        doc.as_object()["extra"] = Value(1);
+        assert(doc.get("extra")->as_integer() == 1);
+    }
+    assert(copy.at("a").as_integer() == 1);
+    assert(copy.at("b").as_string() == "x");
+    
+    Arena arena;
+    auto results = query(".items[].a", "items[2]:\n  - a: 1\n  - a: 2", &arena);
+    assert(results.size() == 2 && results[1] == "2");
+    std::cout << " test_arena passed\n";
+}
+
+void test_equality() {
+    // Numbers compare across representations and hash alike
+    assert(Value(1) == Value(1.0));
+    assert(Value(1).hash() == Value(1.0).hash());
+    assert(Value(1).compare(Value(1.5)) < 0);
+    assert(Value(std::nan("")).compare(Value(-1e300)) < 0);
+    
+    // Objects ignore key order; arrays do not
+    Object ab{{"a", Value(1)}, {"b", Value("x")}};
+    Object ba{{"b", Value("x")}, {"a", Value(1)}};
+    assert(Value(ab) == Value(ba));
+    assert(Value(ab).hash() == Value(ba).hash());
+    Value xs(std::vector<Value>{Value(1), Value(2)});
+    Value ys(std::vector<Value>{Value(2), Value(1)});
+    assert(xs != ys);
+    assert(xs.compare(ys) < 0);
+    
+    // Table rows equal the objects they stand for
+    Value table = Value::table({Key("a"), Key("b")}, {{Value(1)}, {Value("x")}});
+    assert(table.element(0) == Value(ab));
+    assert(table.element(0).hash() == Value(ab).hash());
+    assert(table == Value(std::vector<Value>{Value(ba)}));
+    
+    // jq ordering: null < false < true < numbers < strings < arrays < objects
+    assert(Value().compare(Value(false)) < 0);
+    assert(Value(false).compare(Value(true)) < 0);
+    assert(Value(true).compare(Value(0)) < 0);
+    assert(Value("z").compare(xs) < 0);
+    assert(xs.compare(Value(ab)) < 0);
+    Object b_only{{"b", Value(0)}};
+    assert(Value(ab).compare(Value(b_only)) < 0);  // ["a","b"] < ["b"]
+    
+    // Cached hashes are dropped on mutation
+    Value obj(ab);
+    size_t before = obj.hash();
+    obj.as_object()["a"] = Value(2);
+    assert(obj.hash() != before);
+    assert(obj != Value(ab));
+    std::cout << " test_equality passed\n";
+}
+
+// Lowers the process-wide cap for good, so it runs last
+void test_atom_overflow() {
+    Key known("known_before_cap");
+    AtomTable::set_capacity(AtomTable::size());
+    size_t atoms = AtomTable::size();
+    
+    // New names still make keys, holding their own text
+    Key spilled("past_the_cap");
+    assert(!spilled.interned());
+    assert(AtomTable::size() == atoms && AtomTable::overflowed());
+    assert(spilled == Key("past_the_cap") && spilled != Key("other_past_the_cap"));
+    assert(spilled != known && spilled.str() == "past_the_cap");
+    assert(Key("known_before_cap") == known);
+    
+    // Objects holding such keys work in dictionary mode
+    Object obj;
+    obj["known_before_cap"] = Value(1);
+    obj["past_the_cap"] = Value(2);
+    assert(obj.shape() == nullptr);
+    assert(obj.at("past_the_cap").as_number() == 2.0);
+    assert(obj.contains("past_the_cap") && !obj.contains("never_seen"));
+    
+    // Parsing and querying documents with new keys keeps working
+    std::string doc = "fresh_a: 1\nrows[2]{fresh_b,fresh_c}:\n  1,2\n  3,4\nnested:\n  fresh_d: x";
+    assert(query(".rows[1].fresh_c", doc) == std::vector<std::string>{"4"});
+    assert(query(".nested.fresh_d", doc) == std::vector<std::string>{"x"});
+    assert(query("keys", doc) == std::vector<std::string>{"[3]: fresh_a, nested, rows"});
+    Tape tape = ToonParser::parse_tape(doc);
+    assert(tape.root().get(Key("fresh_a")).to_value() == Value(1));
+    assert(!tape.root().get(Key("fresh_b")));
+    assert(tape.to_value() == ToonParser::parse(doc));
+    assert(AtomTable::size() == atoms);
+    std::cout << " test_atom_overflow passed\n";
+}
+
 int main() {
     try {
         test_null();
         test_boolean();
         test_number();
+        test_integer();
+        test_checked_arithmetic();
+        test_number_parsing();
         test_string();
         test_array();
         test_object();
+        test_copy_on_write();
+        test_compact_layout();
+        test_object_layout();
+        test_key_interning();
+        test_borrowed_strings();
+        test_table();
+        test_sequences();
+        test_snapshots();
+        test_shapes();
+        test_arena();
+        test_equality();
+        test_atom_overflow();
         
         std::cout << "\nAll Value tests passed!\n";
         return 0;